@@ -0,0 +1,649 @@
+// ==================================================================
+// Fleet tool: discover switches over mDNS and actuate many at once
+// ==================================================================
+// Build (Linux/macOS):
+//   g++ -std=c++11 -O2 -o switch_fleet switch_fleet.cpp
+//
+// Usage:
+//   switch_fleet discover [options]
+//   switch_fleet click <ms> | activate | deactivate | status [options]
+//   switch_fleet mock [--devices N] [--http-port P] [--mdns-port P] [--delay-ms D]
+// Options:
+//   --hosts a:port,b:port   skip discovery and use these devices
+//   --match TEXT            only devices whose instance name or id contains TEXT
+//   --mdns ADDR:PORT        where to send the mDNS query (default 224.0.0.251:5353)
+//   --wait MS               how long to collect mDNS answers (default 1500)
+//   --parallel N            requests in flight at once (default 64)
+//   --timeout MS            per-device request timeout (default 3000)
+//
+// Discovery sends one mDNS query for _http._tcp.local and keeps the
+// instances that carry the switch TXT records (id, fw, relay, caps).
+// Commands go to every device over plain HTTP with non-blocking sockets
+// and one poll() loop, and each device's latency (connect to complete
+// response) is reported.
+//
+// "mock" runs N fake devices in one process: HTTP on consecutive ports
+// and an mDNS responder on 127.0.0.1, e.g.
+//   switch_fleet mock --devices 30 &
+//   switch_fleet click 200 --mdns 127.0.0.1:15353
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#define MDNS_GROUP "224.0.0.251"
+#define MDNS_PORT 5353
+#define SERVICE_NAME "_http._tcp.local"
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_PTR 12
+#define DNS_TYPE_TXT 16
+#define DNS_TYPE_SRV 33
+#define DNS_CLASS_IN 1
+
+typedef std::chrono::steady_clock Clock;
+
+
+// A switch found by discovery or given with --hosts
+struct Device {
+    std::string name;                       // mDNS instance or host:port
+    std::string address;                    // IPv4
+    uint16_t port = 80;
+    std::map<std::string, std::string> txt;
+};
+
+// Outcome of one HTTP request
+struct Result {
+    int status = 0;                         // HTTP status, 0 if none
+    std::string error;
+    double latencyMs = 0;
+};
+
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void set_nonblocking(int sock) {
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+}
+
+bool parse_host_port(const std::string &text, sockaddr_in &address, uint16_t defaultPort) {
+    std::string host = text;
+    uint16_t port = defaultPort;
+    size_t colon = text.rfind(':');
+    if (colon != std::string::npos) {
+        host = text.substr(0, colon);
+        port = atoi(text.c_str() + colon + 1);
+    }
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    return inet_pton(AF_INET, host.c_str(), &address.sin_addr) == 1;
+}
+
+
+/*
+ * =======================================================
+ * DNS Messages
+ * =======================================================
+ */
+
+void dns_put16(std::vector<uint8_t> &out, uint16_t value) {
+    out.push_back(value >> 8);
+    out.push_back(value & 0xff);
+}
+
+void dns_put32(std::vector<uint8_t> &out, uint32_t value) {
+    dns_put16(out, value >> 16);
+    dns_put16(out, value & 0xffff);
+}
+
+void dns_put_name(std::vector<uint8_t> &out, const std::string &name) {
+    size_t start = 0;
+    while (start < name.size()) {
+        size_t dot = name.find('.', start);
+        if (dot == std::string::npos) dot = name.size();
+        out.push_back(dot - start);
+        out.insert(out.end(), name.begin() + start, name.begin() + dot);
+        start = dot + 1;
+    }
+    out.push_back(0);
+}
+
+// Read a possibly compressed name at pos, pos moves past it
+bool dns_read_name(const uint8_t *msg, size_t length, size_t &pos, std::string &name) {
+    name.clear();
+    size_t at = pos;
+    bool jumped = false;
+    for (int hops = 0; hops < 32; hops++) {
+        if (at >= length) return false;
+        uint8_t label = msg[at];
+        if (label == 0) {
+            if (!jumped) pos = at + 1;
+            return true;
+        }
+        if ((label & 0xc0) == 0xc0) {
+            if (at + 1 >= length) return false;
+            if (!jumped) pos = at + 2;
+            at = ((label & 0x3f) << 8) | msg[at + 1];
+            jumped = true;
+            continue;
+        }
+        if (at + 1 + label > length) return false;
+        if (!name.empty()) name += '.';
+        name.append((const char *)msg + at + 1, label);
+        at += 1 + label;
+    }
+    return false;
+}
+
+uint16_t dns_get16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+}
+
+// Records of interest from one mDNS answer
+struct DnsAnswer {
+    std::vector<std::string> instances;                         // PTR targets
+    std::map<std::string, std::pair<std::string, uint16_t> > srv; // instance -> host, port
+    std::map<std::string, std::map<std::string, std::string> > txt;
+    std::map<std::string, std::string> a;                       // host -> IPv4
+};
+
+bool dns_parse(const uint8_t *msg, size_t length, DnsAnswer &answer) {
+    if (length < 12) return false;
+    int questions = dns_get16(msg + 4);
+    int records = dns_get16(msg + 6) + dns_get16(msg + 8) + dns_get16(msg + 10);
+    size_t pos = 12;
+    std::string name;
+    for (int i = 0; i < questions; i++) {
+        if (!dns_read_name(msg, length, pos, name) || pos + 4 > length) return false;
+        pos += 4;
+    }
+    for (int i = 0; i < records; i++) {
+        if (!dns_read_name(msg, length, pos, name) || pos + 10 > length) return false;
+        int type = dns_get16(msg + pos);
+        int rdLength = dns_get16(msg + pos + 8);
+        pos += 10;
+        if (pos + rdLength > length) return false;
+        size_t rd = pos;
+        if (type == DNS_TYPE_PTR && name == SERVICE_NAME) {
+            std::string target;
+            if (dns_read_name(msg, length, rd, target)) answer.instances.push_back(target);
+        } else if (type == DNS_TYPE_SRV && rdLength >= 7) {
+            uint16_t port = dns_get16(msg + rd + 4);
+            rd += 6;
+            std::string host;
+            if (dns_read_name(msg, length, rd, host)) answer.srv[name] = std::make_pair(host, port);
+        } else if (type == DNS_TYPE_TXT) {
+            size_t end = pos + rdLength;
+            while (rd < end) {
+                size_t itemLength = msg[rd++];
+                if (rd + itemLength > end) break;
+                std::string item((const char *)msg + rd, itemLength);
+                size_t equals = item.find('=');
+                if (equals != std::string::npos) answer.txt[name][item.substr(0, equals)] = item.substr(equals + 1);
+                rd += itemLength;
+            }
+        } else if (type == DNS_TYPE_A && rdLength == 4) {
+            char text[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, msg + rd, text, sizeof(text));
+            answer.a[name] = text;
+        }
+        pos += rdLength;
+    }
+    return true;
+}
+
+
+/*
+ * =======================================================
+ * Discovery
+ * =======================================================
+ */
+
+std::vector<Device> discover(const sockaddr_in &target, int waitMs) {
+    std::vector<Device> devices;
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    set_nonblocking(sock);
+
+    // one-shot query from an ephemeral port, responders answer by unicast
+    std::vector<uint8_t> query;
+    dns_put16(query, 0);        // id
+    dns_put16(query, 0);        // flags
+    dns_put16(query, 1);        // questions
+    dns_put16(query, 0);
+    dns_put16(query, 0);
+    dns_put16(query, 0);
+    dns_put_name(query, SERVICE_NAME);
+    dns_put16(query, DNS_TYPE_PTR);
+    dns_put16(query, DNS_CLASS_IN);
+    sendto(sock, query.data(), query.size(), 0, (const sockaddr *)&target, sizeof(target));
+
+    std::map<std::string, Device> found;
+    Clock::time_point start = Clock::now();
+    for (;;) {
+        int left = waitMs - (int)ms_since(start);
+        if (left <= 0) break;
+        pollfd fd = { sock, POLLIN, 0 };
+        if (poll(&fd, 1, left) <= 0) continue;
+        uint8_t msg[9000];
+        sockaddr_in source;
+        socklen_t sourceLength = sizeof(source);
+        ssize_t length = recvfrom(sock, msg, sizeof(msg), 0, (sockaddr *)&source, &sourceLength);
+        DnsAnswer answer;
+        if (length <= 0 || !dns_parse(msg, length, answer)) continue;
+
+        char sourceText[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &source.sin_addr, sourceText, sizeof(sourceText));
+        for (size_t i = 0; i < answer.instances.size(); i++) {
+            const std::string &instance = answer.instances[i];
+            // only switches carry an id
+            if (!answer.txt.count(instance) || !answer.txt[instance].count("id")) continue;
+            Device device;
+            device.name = instance.substr(0, instance.find('.'));
+            device.txt = answer.txt[instance];
+            device.address = sourceText;
+            if (answer.srv.count(instance)) {
+                device.port = answer.srv[instance].second;
+                const std::string &host = answer.srv[instance].first;
+                if (answer.a.count(host)) device.address = answer.a[host];
+            }
+            found[device.txt["id"] + device.name] = device;
+        }
+    }
+    close(sock);
+    for (std::map<std::string, Device>::iterator it = found.begin(); it != found.end(); ++it) {
+        devices.push_back(it->second);
+    }
+    return devices;
+}
+
+
+/*
+ * =======================================================
+ * Concurrent HTTP Fan-out
+ * =======================================================
+ */
+
+struct Job {
+    int sock = -1;
+    size_t device;
+    bool sent = false;
+    std::string response;
+    Clock::time_point start;
+};
+
+// Send "GET path" to every device, at most parallel at a time
+std::vector<Result> fan_out(const std::vector<Device> &devices, const std::string &path, int parallel, int timeoutMs) {
+    std::vector<Result> results(devices.size());
+    std::vector<Job> active;
+    size_t next = 0;
+
+    while (next < devices.size() || !active.empty()) {
+        // fill the window
+        while (next < devices.size() && (int)active.size() < parallel) {
+            Job job;
+            job.device = next++;
+            job.start = Clock::now();
+            sockaddr_in address;
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_port = htons(devices[job.device].port);
+            inet_pton(AF_INET, devices[job.device].address.c_str(), &address.sin_addr);
+            job.sock = socket(AF_INET, SOCK_STREAM, 0);
+            set_nonblocking(job.sock);
+            if (connect(job.sock, (sockaddr *)&address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+                results[job.device].error = strerror(errno);
+                close(job.sock);
+                continue;
+            }
+            active.push_back(job);
+        }
+
+        std::vector<pollfd> fds(active.size());
+        for (size_t i = 0; i < active.size(); i++) {
+            fds[i].fd = active[i].sock;
+            fds[i].events = active[i].sent ? POLLIN : POLLOUT;
+            fds[i].revents = 0;
+        }
+        poll(fds.data(), fds.size(), 50);
+
+        for (size_t i = active.size(); i-- > 0;) {
+            Job &job = active[i];
+            Result &result = results[job.device];
+            bool done = false;
+            if (fds[i].revents & (POLLOUT | POLLERR | POLLHUP) && !job.sent) {
+                int error = 0;
+                socklen_t errorLength = sizeof(error);
+                getsockopt(job.sock, SOL_SOCKET, SO_ERROR, &error, &errorLength);
+                if (error != 0) {
+                    result.error = strerror(error);
+                    done = true;
+                } else {
+                    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + devices[job.device].address +
+                                          "\r\nConnection: close\r\n\r\n";
+                    send(job.sock, request.data(), request.size(), 0);
+                    job.sent = true;
+                }
+            } else if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                char buffer[2048];
+                ssize_t length = recv(job.sock, buffer, sizeof(buffer), 0);
+                if (length > 0) {
+                    job.response.append(buffer, length);
+                } else {
+                    // closed by the server: response complete
+                    result.latencyMs = ms_since(job.start);
+                    if (job.response.compare(0, 5, "HTTP/") == 0 && job.response.size() > 12) {
+                        result.status = atoi(job.response.c_str() + 9);
+                    } else {
+                        result.error = "bad response";
+                    }
+                    done = true;
+                }
+            }
+            if (!done && ms_since(job.start) > timeoutMs) {
+                result.error = "timeout";
+                done = true;
+            }
+            if (done) {
+                close(job.sock);
+                active.erase(active.begin() + i);
+            }
+        }
+    }
+    return results;
+}
+
+
+/*
+ * =======================================================
+ * Mock Devices
+ * =======================================================
+ */
+
+std::vector<uint8_t> mock_mdns_answer(int devices, int httpPort) {
+    std::vector<uint8_t> out;
+    dns_put16(out, 0);
+    dns_put16(out, 0x8400);     // response, authoritative
+    dns_put16(out, 0);
+    dns_put16(out, devices * 4);
+    dns_put16(out, 0);
+    dns_put16(out, 0);
+    for (int i = 0; i < devices; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "mock%02d", i);
+        std::string instance = std::string(name) + "." + SERVICE_NAME;
+        std::string host = std::string(name) + ".local";
+        std::vector<uint8_t> rdata;
+
+        dns_put_name(out, SERVICE_NAME);
+        dns_put16(out, DNS_TYPE_PTR);
+        dns_put16(out, DNS_CLASS_IN);
+        dns_put32(out, 120);
+        rdata.clear();
+        dns_put_name(rdata, instance);
+        dns_put16(out, rdata.size());
+        out.insert(out.end(), rdata.begin(), rdata.end());
+
+        dns_put_name(out, instance);
+        dns_put16(out, DNS_TYPE_SRV);
+        dns_put16(out, DNS_CLASS_IN);
+        dns_put32(out, 120);
+        rdata.clear();
+        dns_put16(rdata, 0);
+        dns_put16(rdata, 0);
+        dns_put16(rdata, httpPort + i);
+        dns_put_name(rdata, host);
+        dns_put16(out, rdata.size());
+        out.insert(out.end(), rdata.begin(), rdata.end());
+
+        dns_put_name(out, instance);
+        dns_put16(out, DNS_TYPE_TXT);
+        dns_put16(out, DNS_CLASS_IN);
+        dns_put32(out, 120);
+        rdata.clear();
+        char id[32];
+        snprintf(id, sizeof(id), "id=0000000000%02x", i);
+        const char *items[] = { id, "fw=mock", "relay=idle", "caps=click,hold" };
+        for (int k = 0; k < 4; k++) {
+            rdata.push_back(strlen(items[k]));
+            rdata.insert(rdata.end(), items[k], items[k] + strlen(items[k]));
+        }
+        dns_put16(out, rdata.size());
+        out.insert(out.end(), rdata.begin(), rdata.end());
+
+        dns_put_name(out, host);
+        dns_put16(out, DNS_TYPE_A);
+        dns_put16(out, DNS_CLASS_IN);
+        dns_put32(out, 120);
+        dns_put16(out, 4);
+        out.push_back(127);
+        out.push_back(0);
+        out.push_back(0);
+        out.push_back(1);
+    }
+    return out;
+}
+
+// Fake devices until killed: /control/* answers 200 after delayMs, anything else 404
+int run_mock(int devices, int httpPort, int mdnsPort, int delayMs) {
+    std::vector<pollfd> fds;
+    int mdns = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in address;
+    parse_host_port("127.0.0.1", address, mdnsPort);
+    if (bind(mdns, (sockaddr *)&address, sizeof(address)) < 0) {
+        perror("mdns bind");
+        return 1;
+    }
+    fds.push_back({ mdns, POLLIN, 0 });
+    for (int i = 0; i < devices; i++) {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        int yes = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        parse_host_port("127.0.0.1", address, httpPort + i);
+        if (bind(listener, (sockaddr *)&address, sizeof(address)) < 0 || listen(listener, 16) < 0) {
+            perror("http bind");
+            return 1;
+        }
+        set_nonblocking(listener);
+        fds.push_back({ listener, POLLIN, 0 });
+    }
+    size_t listeners = fds.size();
+    std::vector<uint8_t> answer = mock_mdns_answer(devices, httpPort);
+    printf("mock: %d devices on 127.0.0.1:%d-%d, mDNS on 127.0.0.1:%d\n",
+           devices, httpPort, httpPort + devices - 1, mdnsPort);
+    fflush(stdout);
+
+    // accepted connections waiting for their delayed answer
+    std::map<int, Clock::time_point> pending;
+    for (;;) {
+        poll(fds.data(), fds.size(), 5);
+        if (fds[0].revents & POLLIN) {
+            uint8_t msg[1500];
+            sockaddr_in source;
+            socklen_t sourceLength = sizeof(source);
+            if (recvfrom(mdns, msg, sizeof(msg), 0, (sockaddr *)&source, &sourceLength) > 0) {
+                sendto(mdns, answer.data(), answer.size(), 0, (sockaddr *)&source, sourceLength);
+            }
+        }
+        for (size_t i = 1; i < listeners; i++) {
+            if (!(fds[i].revents & POLLIN)) continue;
+            int client;
+            while ((client = accept(fds[i].fd, NULL, NULL)) >= 0) {
+                pending[client] = Clock::now();
+            }
+        }
+        for (std::map<int, Clock::time_point>::iterator it = pending.begin(); it != pending.end();) {
+            if (ms_since(it->second) < delayMs) {
+                ++it;
+                continue;
+            }
+            char request[1024];
+            ssize_t length = recv(it->first, request, sizeof(request) - 1, 0);
+            request[length > 0 ? length : 0] = '\0';
+            bool control = strncmp(request, "GET /control/", 13) == 0;
+            const char *reply = control ? "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nOK"
+                                        : "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            send(it->first, reply, strlen(reply), 0);
+            close(it->first);
+            pending.erase(it++);
+        }
+    }
+}
+
+
+/*
+ * =======================================================
+ * Command Line
+ * =======================================================
+ */
+
+void usage(const char *self) {
+    fprintf(stderr, "usage: %s discover|click <ms>|activate|deactivate|status [options]\n"
+                    "       %s mock [--devices N] [--http-port P] [--mdns-port P] [--delay-ms D]\n"
+                    "options: --hosts a:port,... --match TEXT --mdns ADDR:PORT --wait MS --parallel N --timeout MS\n",
+            self, self);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::string command = argv[1];
+    std::string path;
+    int first = 2;
+    if (command == "click" && argc > 2) {
+        path = std::string("/control/click?interval=") + argv[2];
+        first = 3;
+    } else if (command == "activate") {
+        path = "/control/activate";
+    } else if (command == "deactivate") {
+        path = "/control/deactivate";
+    } else if (command == "status") {
+        path = "/metrics";
+    } else if (command != "discover" && command != "mock") {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string hosts, match, mdns = std::string(MDNS_GROUP) + ":" + std::to_string(MDNS_PORT);
+    int wait = 1500, parallel = 64, timeout = 3000;
+    int devicesCount = 30, httpPort = 18080, mdnsPort = 15353, delayMs = 5;
+    for (int i = first; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--hosts") hosts = value;
+        else if (option == "--match") match = value;
+        else if (option == "--mdns") mdns = value;
+        else if (option == "--wait") wait = atoi(value.c_str());
+        else if (option == "--parallel") parallel = std::max(1, atoi(value.c_str()));
+        else if (option == "--timeout") timeout = atoi(value.c_str());
+        else if (option == "--devices") devicesCount = atoi(value.c_str());
+        else if (option == "--http-port") httpPort = atoi(value.c_str());
+        else if (option == "--mdns-port") mdnsPort = atoi(value.c_str());
+        else if (option == "--delay-ms") delayMs = atoi(value.c_str());
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (command == "mock") {
+        return run_mock(devicesCount, httpPort, mdnsPort, delayMs);
+    }
+
+    std::vector<Device> devices;
+    if (!hosts.empty()) {
+        size_t start = 0;
+        while (start <= hosts.size()) {
+            size_t comma = hosts.find(',', start);
+            if (comma == std::string::npos) comma = hosts.size();
+            std::string entry = hosts.substr(start, comma - start);
+            sockaddr_in address;
+            if (!parse_host_port(entry, address, 80)) {
+                fprintf(stderr, "bad host %s (IPv4[:port])\n", entry.c_str());
+                return 2;
+            }
+            Device device;
+            device.name = entry;
+            device.address = entry.substr(0, entry.rfind(':') == std::string::npos ? entry.size() : entry.rfind(':'));
+            device.port = ntohs(address.sin_port);
+            devices.push_back(device);
+            start = comma + 1;
+        }
+    } else {
+        sockaddr_in target;
+        if (!parse_host_port(mdns, target, MDNS_PORT)) {
+            fprintf(stderr, "bad --mdns address %s\n", mdns.c_str());
+            return 2;
+        }
+        devices = discover(target, wait);
+    }
+    if (!match.empty()) {
+        std::vector<Device> kept;
+        for (size_t i = 0; i < devices.size(); i++) {
+            std::map<std::string, std::string>::const_iterator id = devices[i].txt.find("id");
+            if (devices[i].name.find(match) != std::string::npos ||
+                (id != devices[i].txt.end() && id->second.find(match) != std::string::npos)) {
+                kept.push_back(devices[i]);
+            }
+        }
+        devices.swap(kept);
+    }
+
+    if (command == "discover") {
+        printf("%-24s %-21s %-14s %-8s %-9s %s\n", "NAME", "ADDRESS", "ID", "FW", "RELAY", "CAPS");
+        for (size_t i = 0; i < devices.size(); i++) {
+            Device &d = devices[i];
+            std::string address = d.address + ":" + std::to_string(d.port);
+            printf("%-24s %-21s %-14s %-8s %-9s %s\n", d.name.c_str(), address.c_str(), d.txt["id"].c_str(),
+                   d.txt["fw"].c_str(), d.txt["relay"].c_str(), d.txt["caps"].c_str());
+        }
+        printf("%zu device(s)\n", devices.size());
+        return 0;
+    }
+    if (devices.empty()) {
+        fprintf(stderr, "no devices\n");
+        return 1;
+    }
+
+    Clock::time_point start = Clock::now();
+    std::vector<Result> results = fan_out(devices, path, parallel, timeout);
+    double total = ms_since(start);
+
+    std::vector<double> latencies;
+    int failed = 0;
+    printf("%-24s %-21s %-8s %s\n", "NAME", "ADDRESS", "STATUS", "LATENCY");
+    for (size_t i = 0; i < devices.size(); i++) {
+        std::string address = devices[i].address + ":" + std::to_string(devices[i].port);
+        if (results[i].error.empty()) {
+            printf("%-24s %-21s %-8d %.1f ms\n", devices[i].name.c_str(), address.c_str(), results[i].status,
+                   results[i].latencyMs);
+            latencies.push_back(results[i].latencyMs);
+            if (results[i].status != 200) failed++;
+        } else {
+            printf("%-24s %-21s %-8s %s\n", devices[i].name.c_str(), address.c_str(), "-", results[i].error.c_str());
+            failed++;
+        }
+    }
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        printf("%zu answered, %d failed in %.1f ms; latency min %.1f / median %.1f / max %.1f ms\n",
+               latencies.size(), failed, total, latencies.front(), latencies[latencies.size() / 2], latencies.back());
+    }
+    return failed == 0 ? 0 : 1;
+}
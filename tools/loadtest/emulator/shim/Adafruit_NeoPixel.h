@@ -0,0 +1,34 @@
+// ==================================================================
+// Host shim: Adafruit_NeoPixel as a plain frame buffer, show() records it
+// ==================================================================
+
+#pragma once
+
+#include "Arduino.h"
+
+#include <vector>
+
+#define NEO_RGB 0
+#define NEO_KHZ800 0
+
+class Adafruit_NeoPixel {
+public:
+    Adafruit_NeoPixel(uint16_t count, int16_t pin, int type) : buffer(count * 3) {}
+    void begin() {}
+    void show() { host_frame_write(buffer.data(), buffer.size()); }
+    void clear() { fill(0); }
+    void fill(uint32_t color) {
+        for (size_t i = 0; i < buffer.size() / 3; i++) setPixelColor(i, color);
+    }
+    void setPixelColor(uint16_t i, uint32_t color) {
+        buffer[i * 3] = color >> 16;
+        buffer[i * 3 + 1] = color >> 8;
+        buffer[i * 3 + 2] = color;
+    }
+    static uint32_t Color(uint8_t a, uint8_t b, uint8_t c) { return ((uint32_t)a << 16) | ((uint32_t)b << 8) | c; }
+    uint8_t *getPixels() { return buffer.data(); }
+    uint16_t numPixels() const { return buffer.size() / 3; }
+
+private:
+    std::vector<uint8_t> buffer;
+};
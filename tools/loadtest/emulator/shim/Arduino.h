@@ -0,0 +1,335 @@
+// ==================================================================
+// Host shim: the parts of the Arduino core and FreeRTOS the firmware uses
+// ==================================================================
+// Just enough to build the firmware headers on Linux for the device
+// emulator. Tasks are threads, semaphores and critical sections are
+// mutexes, ticks are milliseconds. Built with HOST_VIRTUAL_CLOCK, time
+// and blocking come from the virtual clock in host_kernel.h instead.
+
+#pragma once
+
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef HOST_VIRTUAL_CLOCK
+#include "host_kernel.h"
+#endif
+
+using std::max;
+using std::min;
+
+#define PROGMEM
+#define IRAM_ATTR
+#define memcpy_P memcpy
+
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 1
+
+// Echo Serial output to stderr, off by default so logging does not skew timing
+extern bool hostSerialEcho;
+
+
+/*
+ * =======================================================
+ * Time and GPIO
+ * =======================================================
+ */
+
+inline std::chrono::steady_clock::time_point host_boot_time() {
+    static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+    return boot;
+}
+
+// Wall time since start, also under the virtual clock (CPU cost measurements)
+inline uint64_t host_real_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - host_boot_time()).count();
+}
+
+#ifdef HOST_VIRTUAL_CLOCK
+inline uint64_t host_micros64() { return host_kernel().now; }
+inline void delay(uint32_t ms) { host_block(NULL, host_kernel().now + (uint64_t)ms * 1000); }
+#else
+inline uint64_t host_micros64() { return host_real_nanos() / 1000; }
+inline void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+#endif
+
+inline uint32_t micros() { return (uint32_t)host_micros64(); }
+inline uint32_t millis() { return (uint32_t)(host_micros64() / 1000); }
+
+// Relay edges and LED ring frames, recorded while enabled is set
+struct HostEdge {
+    uint64_t at;            // host_micros64()
+    uint64_t realNanos;     // host_real_nanos()
+    int pin;
+    int level;
+};
+struct HostFrame {
+    uint64_t at;            // host_micros64()
+    std::vector<uint8_t> bytes;
+};
+struct HostRecorder {
+    bool enabled = false;
+    std::vector<HostEdge> edges;
+    std::vector<HostFrame> frames;
+};
+inline HostRecorder &host_recorder() {
+    static HostRecorder recorder;
+    return recorder;
+}
+
+extern int hostPinLevel[40];
+inline void host_pin_write(int pin, int level) {
+    HostRecorder &r = host_recorder();
+    if (r.enabled && hostPinLevel[pin] != level) {
+        HostEdge edge = { host_micros64(), host_real_nanos(), pin, level };
+        r.edges.push_back(edge);
+    }
+    hostPinLevel[pin] = level;
+}
+
+// A frame as it reaches the ring (pixels.show() or the RMT driver)
+inline void host_frame_write(const uint8_t *bytes, size_t length) {
+    HostRecorder &r = host_recorder();
+    if (r.enabled) {
+        HostFrame frame = { host_micros64(), std::vector<uint8_t>(bytes, bytes + length) };
+        r.frames.push_back(frame);
+    }
+}
+
+inline void pinMode(int pin, int mode) {}
+inline void digitalWrite(int pin, int level) { host_pin_write(pin, level); }
+
+
+/*
+ * =======================================================
+ * String, Print, Serial, ESP
+ * =======================================================
+ */
+
+class String {
+public:
+    String() {}
+    String(const char *text) : s(text ? text : "") {}
+    String(const std::string &text) : s(text) {}
+    String(int value) : s(std::to_string(value)) {}
+    String(unsigned value) : s(std::to_string(value)) {}
+
+    const char *c_str() const { return s.c_str(); }
+    unsigned length() const { return s.size(); }
+    char operator[](unsigned index) const { return index < s.size() ? s[index] : 0; }
+    int indexOf(char c, unsigned from = 0) const {
+        size_t at = s.find(c, from);
+        return at == std::string::npos ? -1 : (int)at;
+    }
+    String substring(unsigned from, unsigned to) const {
+        return from >= s.size() ? String() : String(s.substr(from, to - from));
+    }
+    String substring(unsigned from) const { return substring(from, s.size()); }
+    void trim() {
+        size_t first = s.find_first_not_of(" \t\r\n");
+        size_t last = s.find_last_not_of(" \t\r\n");
+        s = (first == std::string::npos) ? "" : s.substr(first, last - first + 1);
+    }
+    long toInt() const { return atol(s.c_str()); }
+    void toLowerCase() { for (size_t i = 0; i < s.size(); i++) s[i] = tolower(s[i]); }
+    bool operator==(const String &other) const { return s == other.s; }
+    bool operator==(const char *other) const { return s == other; }
+    bool operator!=(const char *other) const { return s != other; }
+    String &operator+=(const String &other) { s += other.s; return *this; }
+    String operator+(const String &other) const { return String(s + other.s); }
+    friend String operator+(const char *left, const String &right) { return String(left + right.s); }
+
+private:
+    std::string s;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(const uint8_t *data, size_t length) = 0;
+    size_t print(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+    size_t print(const String &text) { return print(text.c_str()); }
+    size_t println(const char *text = "") { return print(text) + print("\n"); }
+    size_t println(const String &text) { return println(text.c_str()); }
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return write((const uint8_t *)buffer, min((size_t)length, sizeof(buffer) - 1));
+    }
+};
+
+class HostSerial : public Print {
+public:
+    void begin(int baud) {}
+    size_t write(const uint8_t *data, size_t length) {
+        if (hostSerialEcho) fwrite(data, 1, length, stderr);
+        return length;
+    }
+};
+extern HostSerial Serial;
+
+class HostEsp {
+public:
+    // host CPU cycles (the x86 time stamp counter), elsewhere real time at 240 MHz
+    uint32_t getCycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+        return (uint32_t)__rdtsc();
+#else
+        return (uint32_t)(host_real_nanos() * 240 / 1000);
+#endif
+    }
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMinFreeHeap() { return 200000; }
+    void restart() { exit(0); }
+};
+extern HostEsp ESP;
+
+
+/*
+ * =======================================================
+ * FreeRTOS
+ * =======================================================
+ */
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY 0xffffffffUL
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+
+inline TickType_t xTaskGetTickCount() { return millis(); }
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+// Tasks run as detached threads, the stack size and priority are ignored
+inline BaseType_t xTaskCreate(void (*task)(void *), const char *name, uint32_t stack, void *parameter,
+                              int priority, TaskHandle_t *handle) {
+#ifdef HOST_VIRTUAL_CLOCK
+    host_task_start(task, parameter);
+#else
+    std::thread(task, parameter).detach();
+#endif
+    return pdPASS;
+}
+// One core; a task's handle is its thread's address
+#define portNUM_PROCESSORS 1
+inline BaseType_t xPortGetCoreID() { return 0; }
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+    static thread_local char self;
+    return &self;
+}
+inline TaskHandle_t xTaskGetHandle(const char *name) { return NULL; }
+// Only a task deleting itself is supported
+inline void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL) {
+#ifdef HOST_VIRTUAL_CLOCK
+        host_task_exit();
+#endif
+        pthread_exit(NULL);
+    }
+}
+inline BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack, void *parameter,
+                                          int priority, TaskHandle_t *handle, BaseType_t core) {
+    return xTaskCreate(task, name, stack, parameter, priority, handle);
+}
+
+// Counting semaphore, also used for mutexes (no priority inheritance)
+struct HostSemaphore {
+    std::mutex lock;
+    std::condition_variable changed;
+    int count;
+    int limit;
+};
+typedef HostSemaphore *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+    HostSemaphore *semaphore = new HostSemaphore();
+    semaphore->count = 0;
+    semaphore->limit = 1;
+    return semaphore;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t semaphore = xSemaphoreCreateBinary();
+    semaphore->count = 1;
+    return semaphore;
+}
+
+#ifdef HOST_VIRTUAL_CLOCK
+// Only the task holding the turn runs, so the count needs no lock
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) {
+    HostKernel &k = host_kernel();
+    uint64_t until = wait == portMAX_DELAY ? HOST_NEVER : k.now + (uint64_t)wait * 1000;
+    while (semaphore->count == 0) {
+        if (k.now >= until) {
+            return pdFALSE;
+        }
+        host_block(semaphore, until);
+    }
+    semaphore->count--;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if (semaphore->count >= semaphore->limit) {
+        return pdFALSE;
+    }
+    semaphore->count++;
+    host_wake_one(semaphore);
+    return pdTRUE;
+}
+#else
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) {
+    std::unique_lock<std::mutex> guard(semaphore->lock);
+    if (wait == portMAX_DELAY) {
+        semaphore->changed.wait(guard, [semaphore] { return semaphore->count > 0; });
+    } else if (!semaphore->changed.wait_for(guard, std::chrono::milliseconds(wait),
+                                            [semaphore] { return semaphore->count > 0; })) {
+        return pdFALSE;
+    }
+    semaphore->count--;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    if (semaphore->count >= semaphore->limit) {
+        return pdFALSE;
+    }
+    semaphore->count++;
+    semaphore->changed.notify_one();
+    return pdTRUE;
+}
+#endif
+
+// Critical sections nest on the ESP32, so these are recursive
+struct portMUX_TYPE {
+    std::recursive_mutex lock;
+};
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->lock.lock()
+#define portEXIT_CRITICAL(mux) (mux)->lock.unlock()
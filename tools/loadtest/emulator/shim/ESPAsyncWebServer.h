@@ -0,0 +1,163 @@
+// ==================================================================
+// Host shim: the request/response side of ESPAsyncWebServer
+// ==================================================================
+// switch_emulator.cpp parses HTTP itself, fills an AsyncWebServerRequest
+// (streaming the body to the body handler, if any)
+// and hands it to the firmware handler; the response object collects
+// what the handler sends.
+
+#pragma once
+
+#include "Arduino.h"
+
+#include <strings.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#define HTTP_GET 0b00000001
+#define HTTP_POST 0b00000010
+#define HTTP_DELETE 0b00000100
+
+class IPAddress {
+public:
+    IPAddress(uint32_t address = 0) : address(address) {}
+    operator uint32_t() const { return address; }
+
+private:
+    uint32_t address;
+};
+
+class AsyncClient {
+public:
+    IPAddress remoteIP() const { return ip; }
+    uint32_t ip = 0;
+};
+
+// Name/value pair, used for url parameters and headers
+class AsyncWebParameter {
+public:
+    AsyncWebParameter(const String &name, const String &value) : _name(name), _value(value) {}
+    const String &name() const { return _name; }
+    const String &value() const { return _value; }
+
+private:
+    String _name;
+    String _value;
+};
+typedef AsyncWebParameter AsyncWebHeader;
+
+class AsyncWebServerResponse {
+public:
+    void addHeader(const String &name, const String &value) { headers.push_back(std::make_pair(name, value)); }
+
+    int code = 500;
+    String contentType;
+    std::string body;
+    std::vector<std::pair<String, String> > headers;
+};
+
+class AsyncWebServerRequest {
+public:
+    bool hasParam(const String &name, bool post = false) const { return find(params, name, false) != NULL; }
+    AsyncWebParameter *getParam(const String &name, bool post = false) { return find(params, name, false); }
+    bool hasHeader(const String &name) const { return find(headers, name, true) != NULL; }
+    AsyncWebHeader *getHeader(const String &name) { return find(headers, name, true); }
+    const String &url() const { return path; }
+    void addInterestingHeader(const String &name) {}
+    AsyncClient *client() { return &remote; }
+    int method() const { return verb; }
+    size_t contentLength() const { return length; }
+    void onDisconnect(std::function<void()> fn) { disconnected = fn; }
+
+    // HTTP basic authentication only
+    bool authenticate(const char *user, const char *password) {
+        AsyncWebHeader *header = getHeader("Authorization");
+        std::string credentials = std::string(user) + ":" + password;
+        return header != NULL && header->value() == (std::string("Basic ") + base64(credentials)).c_str();
+    }
+    void requestAuthentication() {
+        AsyncWebServerResponse *r = beginResponse(401);
+        r->addHeader("WWW-Authenticate", "Basic realm=\"Login Required\"");
+        send(r);
+    }
+
+    AsyncWebServerResponse *beginResponse(int code, const String &type = String(), const String &content = String()) {
+        AsyncWebServerResponse *r = new AsyncWebServerResponse();
+        r->code = code;
+        r->contentType = type;
+        r->body = content.c_str();
+        return r;
+    }
+    AsyncWebServerResponse *beginResponse_P(int code, const String &type, const uint8_t *data, size_t length) {
+        AsyncWebServerResponse *r = beginResponse(code, type);
+        r->body.assign((const char *)data, length);
+        return r;
+    }
+    AsyncWebServerResponse *beginResponse_P(int code, const String &type, const char *content) {
+        return beginResponse(code, type, content);
+    }
+    void send(AsyncWebServerResponse *r) {
+        delete response;
+        response = r;
+    }
+    void send(int code, const String &type = String(), const String &content = String()) {
+        send(beginResponse(code, type, content));
+    }
+    void send_P(int code, const String &type, const char *content) { send(beginResponse_P(code, type, content)); }
+
+    ~AsyncWebServerRequest() {
+        delete response;
+        free(_tempObject);
+    }
+
+    // filled by the emulator
+    String path;
+    std::vector<AsyncWebParameter> params;
+    std::vector<AsyncWebHeader> headers;
+    AsyncClient remote;
+    AsyncWebServerResponse *response = NULL;
+    int verb = HTTP_GET;
+    size_t length = 0;                      // Content-Length
+    std::function<void()> disconnected;     // set with onDisconnect(), run by the emulator
+    void *_tempObject = NULL;
+
+private:
+    static std::string base64(const std::string &text) {
+        static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        for (size_t i = 0; i < text.size(); i += 3) {
+            uint32_t group = (uint8_t)text[i] << 16;
+            if (i + 1 < text.size()) group |= (uint8_t)text[i + 1] << 8;
+            if (i + 2 < text.size()) group |= (uint8_t)text[i + 2];
+            out += digits[(group >> 18) & 63];
+            out += digits[(group >> 12) & 63];
+            out += i + 1 < text.size() ? digits[(group >> 6) & 63] : '=';
+            out += i + 2 < text.size() ? digits[group & 63] : '=';
+        }
+        return out;
+    }
+
+    // header names are case insensitive, parameter names are not
+    static AsyncWebParameter *find(const std::vector<AsyncWebParameter> &list, const String &name, bool anyCase) {
+        for (size_t i = 0; i < list.size(); i++) {
+            const char *candidate = list[i].name().c_str();
+            if ((anyCase ? strcasecmp(candidate, name.c_str()) : strcmp(candidate, name.c_str())) == 0) {
+                return (AsyncWebParameter *)&list[i];
+            }
+        }
+        return NULL;
+    }
+};
+
+typedef void (*ArRequestHandlerFunction)(AsyncWebServerRequest *request);
+typedef void (*ArBodyHandlerFunction)(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+
+// Handlers added with server.addHandler(), tried after the fixed routes
+class AsyncWebHandler {
+public:
+    virtual ~AsyncWebHandler() {}
+    virtual bool canHandle(AsyncWebServerRequest *request) { return false; }
+    virtual void handleRequest(AsyncWebServerRequest *request) {}
+};
@@ -0,0 +1,38 @@
+// ==================================================================
+// Host shim: Preferences (NVS) kept in memory
+// ==================================================================
+
+#pragma once
+
+#include "Arduino.h"
+
+#include <map>
+#include <vector>
+
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false) {
+        space = name;
+        return true;
+    }
+    void end() {}
+    bool isKey(const char *key) { return store().count(space + "/" + key) != 0; }
+    size_t getBytes(const char *key, void *out, size_t length) {
+        std::map<std::string, std::vector<uint8_t> >::iterator it = store().find(space + "/" + key);
+        if (it == store().end() || it->second.size() > length) return 0;
+        memcpy(out, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+    size_t putBytes(const char *key, const void *data, size_t length) {
+        store()[space + "/" + key].assign((const uint8_t *)data, (const uint8_t *)data + length);
+        return length;
+    }
+    bool remove(const char *key) { return store().erase(space + "/" + key) != 0; }
+
+private:
+    static std::map<std::string, std::vector<uint8_t> > &store() {
+        static std::map<std::string, std::vector<uint8_t> > values;
+        return values;
+    }
+    std::string space;
+};
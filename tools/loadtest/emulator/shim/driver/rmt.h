@@ -0,0 +1,35 @@
+// ==================================================================
+// Host shim: RMT driver, frames are recorded and go out at once
+// ==================================================================
+
+#pragma once
+
+#include "esp_timer.h"
+
+typedef int rmt_channel_t;
+typedef int gpio_num_t;
+#define RMT_CHANNEL_0 0
+
+struct rmt_config_t {
+    int clk_div;
+};
+#define RMT_DEFAULT_CONFIG_TX(gpio, channel) rmt_config_t{ 1 }
+
+typedef struct {
+    uint32_t duration0 : 15;
+    uint32_t level0 : 1;
+    uint32_t duration1 : 15;
+    uint32_t level1 : 1;
+} rmt_item32_t;
+
+typedef void (*sample_to_rmt_t)(const void *src, rmt_item32_t *dest, size_t srcSize, size_t wantedNum,
+                                size_t *translatedSize, size_t *itemNum);
+
+inline esp_err_t rmt_config(const rmt_config_t *config) { return ESP_OK; }
+inline esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rxBuffer, int flags) { return ESP_OK; }
+inline esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t translator) { return ESP_OK; }
+inline esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait) { return ESP_OK; }
+inline esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t size, bool wait) {
+    host_frame_write(src, size);
+    return ESP_OK;
+}
@@ -0,0 +1,128 @@
+// ==================================================================
+// Host shim: OTA partitions backed by files
+// ==================================================================
+// The default Arduino layout, app0 and app1 of 1.25 MB each, with the
+// emulator running from app0. Each partition is the file <label>.bin
+// in hostFlashDir, so an uploaded image can be compared with the file
+// that was sent. Writes erase sector by sector like
+// OTA_WITH_SEQUENTIAL_WRITES; hostFlashEraseMicros stalls every sector
+// erase as the flash does on the device.
+// esp_ota_end() checks the image magic byte only.
+
+#pragma once
+
+#include "esp_timer.h"
+
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_OTA_VALIDATE_FAILED 0x1503
+
+#define OTA_SIZE_UNKNOWN 0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES 0xfffffffe
+
+#define HOST_FLASH_SECTOR 4096
+#define HOST_OTA_PARTITION_SIZE 0x140000
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+struct esp_partition_t {
+    esp_partition_type_t type;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+};
+
+typedef uint32_t esp_ota_handle_t;
+
+extern const char *hostFlashDir;
+extern uint32_t hostFlashEraseMicros;
+
+struct HostOtaState {
+    esp_partition_t partitions[2];
+    int running;
+    int boot;
+    FILE *file;                 // partition being written, NULL if none
+    int target;
+    size_t written;
+    size_t erased;
+    uint8_t magic;              // first byte written
+    esp_ota_handle_t handle;
+};
+
+inline HostOtaState &host_ota() {
+    static HostOtaState state = {
+        { { ESP_PARTITION_TYPE_APP, 0x10000, HOST_OTA_PARTITION_SIZE, "app0" },
+          { ESP_PARTITION_TYPE_APP, 0x150000, HOST_OTA_PARTITION_SIZE, "app1" } },
+        0, 0, NULL, 0, 0, 0, 0, 0,
+    };
+    return state;
+}
+
+inline const esp_partition_t *esp_ota_get_running_partition() { return &host_ota().partitions[host_ota().running]; }
+inline const esp_partition_t *esp_ota_get_boot_partition() { return &host_ota().partitions[host_ota().boot]; }
+inline const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start) {
+    return &host_ota().partitions[1 - host_ota().running];
+}
+
+inline const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                       const char *label) {
+    for (int i = 0; i < 2; i++) {
+        if (label == NULL || strcmp(host_ota().partitions[i].label, label) == 0) return &host_ota().partitions[i];
+    }
+    return NULL;
+}
+
+inline esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t size, esp_ota_handle_t *handle) {
+    HostOtaState &ota = host_ota();
+    if (ota.file != NULL) return ESP_ERR_INVALID_STATE;
+    if (partition == &ota.partitions[ota.running]) return ESP_ERR_INVALID_ARG;
+    std::string path = std::string(hostFlashDir) + "/" + partition->label + ".bin";
+    ota.file = fopen(path.c_str(), "wb");
+    if (ota.file == NULL) return ESP_FAIL;
+    ota.target = partition - ota.partitions;
+    ota.written = 0;
+    ota.erased = 0;
+    *handle = ++ota.handle;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size) {
+    HostOtaState &ota = host_ota();
+    if (ota.file == NULL || handle != ota.handle) return ESP_ERR_INVALID_ARG;
+    if (ota.written + size > ota.partitions[ota.target].size) return ESP_ERR_INVALID_SIZE;
+    while (ota.erased < ota.written + size) {
+        if (hostFlashEraseMicros > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(hostFlashEraseMicros));
+        }
+        ota.erased += HOST_FLASH_SECTOR;
+    }
+    if (ota.written == 0 && size > 0) ota.magic = ((const uint8_t *)data)[0];
+    if (fwrite(data, 1, size, ota.file) != size) return ESP_FAIL;
+    ota.written += size;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    HostOtaState &ota = host_ota();
+    if (ota.file == NULL || handle != ota.handle) return ESP_ERR_NOT_FOUND;
+    fclose(ota.file);
+    ota.file = NULL;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    HostOtaState &ota = host_ota();
+    if (ota.file == NULL || handle != ota.handle) return ESP_ERR_NOT_FOUND;
+    fclose(ota.file);
+    ota.file = NULL;
+    return (ota.written > 0 && ota.magic == 0xE9) ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+inline esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition) {
+    host_ota().boot = partition - host_ota().partitions;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_ota_mark_app_valid_cancel_rollback() { return ESP_OK; }
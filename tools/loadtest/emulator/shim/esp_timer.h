@@ -0,0 +1,173 @@
+// ==================================================================
+// Host shim: esp_timer with one dispatch thread, like ESP_TIMER_TASK
+// ==================================================================
+// Under HOST_VIRTUAL_CLOCK there is no thread: the scheduler in
+// host_kernel.h fires the timers as it moves the clock on.
+
+#pragma once
+
+#include "Arduino.h"
+
+#include <vector>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_STATE 0x103
+
+typedef enum { ESP_TIMER_TASK } esp_timer_dispatch_t;
+
+struct esp_timer_create_args_t {
+    void (*callback)(void *arg);
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+};
+
+struct HostTimer {
+    void (*callback)(void *arg);
+    void *arg;
+    bool active;
+    uint64_t dueAt;         // host_micros64()
+    uint64_t period;        // 0 for one-shot
+};
+typedef HostTimer *esp_timer_handle_t;
+
+// Timer list shared with the dispatch thread
+struct HostTimerService {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<HostTimer *> timers;
+};
+
+#ifdef HOST_VIRTUAL_CLOCK
+inline uint64_t host_timer_next_due();
+inline void host_timer_fire_next();
+#else
+inline void host_timer_dispatch();
+#endif
+
+inline HostTimerService &host_timer_service() {
+    static HostTimerService *service = NULL;
+    static std::once_flag started;
+    std::call_once(started, [] {
+        service = new HostTimerService();
+#ifdef HOST_VIRTUAL_CLOCK
+        host_kernel().nextTimer = host_timer_next_due;
+        host_kernel().fireTimer = host_timer_fire_next;
+#else
+        std::thread(host_timer_dispatch).detach();
+#endif
+    });
+    return *service;
+}
+
+// Earliest active timer, NULL for none; the service lock must be held
+inline HostTimer *host_timer_next_locked(HostTimerService &s) {
+    HostTimer *next = NULL;
+    for (size_t i = 0; i < s.timers.size(); i++) {
+        if (s.timers[i]->active && (next == NULL || s.timers[i]->dueAt < next->dueAt)) next = s.timers[i];
+    }
+    return next;
+}
+
+// Re-arm or disarm a timer that is firing; the service lock must be held
+inline void host_timer_fired_locked(HostTimer *timer) {
+    if (timer->period != 0) {
+        timer->dueAt += timer->period;
+    } else {
+        timer->active = false;
+    }
+}
+
+#ifdef HOST_VIRTUAL_CLOCK
+inline uint64_t host_timer_next_due() {
+    HostTimerService &s = host_timer_service();
+    std::lock_guard<std::mutex> guard(s.lock);
+    HostTimer *next = host_timer_next_locked(s);
+    return next == NULL ? HOST_NEVER : next->dueAt;
+}
+
+// Called with the clock at the next timer's due time
+inline void host_timer_fire_next() {
+    HostTimerService &s = host_timer_service();
+    std::unique_lock<std::mutex> guard(s.lock);
+    HostTimer *next = host_timer_next_locked(s);
+    if (next == NULL || next->dueAt > host_micros64()) {
+        return;
+    }
+    host_timer_fired_locked(next);
+    // callbacks may start and stop timers
+    guard.unlock();
+    next->callback(next->arg);
+}
+#else
+// Body of the dispatch thread
+inline void host_timer_dispatch() {
+    HostTimerService &s = host_timer_service();
+    std::unique_lock<std::mutex> guard(s.lock);
+    for (;;) {
+        HostTimer *next = host_timer_next_locked(s);
+        if (next == NULL) {
+            s.changed.wait(guard);
+            continue;
+        }
+        uint64_t now = host_micros64();
+        if (next->dueAt > now) {
+            s.changed.wait_for(guard, std::chrono::microseconds(next->dueAt - now));
+            continue;
+        }
+        host_timer_fired_locked(next);
+        // callbacks may start and stop timers
+        guard.unlock();
+        next->callback(next->arg);
+        guard.lock();
+    }
+}
+#endif
+
+inline int64_t esp_timer_get_time() { return (int64_t)host_micros64(); }
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+    HostTimerService &s = host_timer_service();
+    HostTimer *timer = new HostTimer();
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->active = false;
+    std::lock_guard<std::mutex> guard(s.lock);
+    s.timers.push_back(timer);
+    *handle = timer;
+    return ESP_OK;
+}
+
+inline esp_err_t host_timer_start(esp_timer_handle_t timer, uint64_t delay, uint64_t period) {
+    HostTimerService &s = host_timer_service();
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = true;
+    timer->dueAt = host_micros64() + delay;
+    timer->period = period;
+    s.changed.notify_one();
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout) {
+    return host_timer_start(timer, timeout, 0);
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    return host_timer_start(timer, period, period);
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    HostTimerService &s = host_timer_service();
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    s.changed.notify_one();
+    return ESP_OK;
+}
@@ -0,0 +1,183 @@
+// ==================================================================
+// Host shim: virtual clock and a one-task-at-a-time scheduler
+// ==================================================================
+// Used instead of real time when built with HOST_VIRTUAL_CLOCK (the
+// benchmark). Tasks are still threads, but only the one holding the
+// turn runs, like a single core without preemption: a task runs until
+// it blocks on a semaphore, a delay or host_clock_advance(). Once every
+// task is blocked the clock jumps to the next esp_timer or wake-up that
+// is due, so a run is repeatable and takes no longer than the CPU work.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define HOST_NEVER UINT64_MAX
+
+struct HostSemaphore;
+
+struct HostTask {
+    std::condition_variable turn;
+    std::unique_lock<std::mutex> hold;  // the kernel lock, held while this task has the turn
+    bool blocked = false;
+    bool exited = false;
+    uint64_t wakeAt = HOST_NEVER;       // virtual time a timed block ends
+    HostSemaphore *waitingOn = NULL;
+};
+
+struct HostKernel {
+    std::mutex lock;
+    uint64_t now = 0;                   // virtual time in us
+    std::vector<HostTask *> tasks;
+    HostTask *current = NULL;           // task holding the turn
+    bool inTimer = false;               // a timer callback is running
+    // set by esp_timer.h: due time of the next timer (HOST_NEVER for none), firing it
+    uint64_t (*nextTimer)() = NULL;
+    void (*fireTimer)() = NULL;
+};
+
+// Never destroyed, blocked tasks still refer to it while the process exits
+inline HostKernel &host_kernel() {
+    static HostKernel *kernel = new HostKernel();
+    return *kernel;
+}
+
+inline HostTask *&host_task_slot() {
+    static thread_local HostTask *self = NULL;
+    return self;
+}
+
+// Task of the calling thread; the first thread to ask (main) becomes a
+// task holding the turn
+inline HostTask *host_task_self() {
+    HostTask *&self = host_task_slot();
+    if (self == NULL) {
+        HostKernel &k = host_kernel();
+        self = new HostTask();
+        self->hold = std::unique_lock<std::mutex>(k.lock);
+        k.tasks.push_back(self);
+        k.current = self;
+    }
+    return self;
+}
+
+// Hand the turn to the next task that can run, moving the clock on while
+// none can; returns once self has the turn again, or at once if it exited
+inline void host_schedule(HostTask *self) {
+    HostKernel &k = host_kernel();
+    for (;;) {
+        size_t at = 0;
+        while (at < k.tasks.size() && k.tasks[at] != self) at++;
+        HostTask *next = NULL;
+        for (size_t i = 1; i <= k.tasks.size(); i++) {
+            HostTask *task = k.tasks[(at + i) % k.tasks.size()];
+            if (!task->blocked && !task->exited) {
+                next = task;
+                break;
+            }
+        }
+        if (next != NULL) {
+            if (next != self) {
+                k.current = next;
+                next->turn.notify_one();
+                if (self->exited) return;
+                self->turn.wait(self->hold, [&k, self] { return k.current == self; });
+            }
+            return;
+        }
+
+        // everyone is blocked: the earliest timer or timed block is next
+        uint64_t timerAt = k.nextTimer != NULL ? k.nextTimer() : HOST_NEVER;
+        uint64_t wakeAt = HOST_NEVER;
+        for (size_t i = 0; i < k.tasks.size(); i++) {
+            if (!k.tasks[i]->exited && k.tasks[i]->wakeAt < wakeAt) wakeAt = k.tasks[i]->wakeAt;
+        }
+        if (timerAt == HOST_NEVER && wakeAt == HOST_NEVER) {
+            fprintf(stderr, "host kernel: every task is blocked for good\n");
+            abort();
+        }
+        if (timerAt <= wakeAt) {
+            if (timerAt > k.now) k.now = timerAt;
+            // runs on this thread as if in the esp_timer task
+            k.inTimer = true;
+            k.fireTimer();
+            k.inTimer = false;
+        } else {
+            if (wakeAt > k.now) k.now = wakeAt;
+            for (size_t i = 0; i < k.tasks.size(); i++) {
+                HostTask *task = k.tasks[i];
+                if (task->blocked && task->wakeAt <= k.now) {
+                    task->blocked = false;
+                    task->waitingOn = NULL;
+                    task->wakeAt = HOST_NEVER;
+                }
+            }
+        }
+    }
+}
+
+// Block the calling task until wakeAt or, with on set, until a give on it
+inline void host_block(HostSemaphore *on, uint64_t wakeAt) {
+    HostKernel &k = host_kernel();
+    HostTask *self = host_task_self();
+    if (k.inTimer) {
+        fprintf(stderr, "host kernel: a timer callback would block\n");
+        abort();
+    }
+    self->blocked = true;
+    self->waitingOn = on;
+    self->wakeAt = wakeAt;
+    host_schedule(self);
+}
+
+// Make the first task blocked on a semaphore runnable, after a give
+inline void host_wake_one(HostSemaphore *on) {
+    HostKernel &k = host_kernel();
+    for (size_t i = 0; i < k.tasks.size(); i++) {
+        HostTask *task = k.tasks[i];
+        if (task->blocked && task->waitingOn == on) {
+            task->blocked = false;
+            task->waitingOn = NULL;
+            task->wakeAt = HOST_NEVER;
+            return;
+        }
+    }
+}
+
+// Start a task, it first runs when the creator blocks
+inline void host_task_start(void (*task)(void *), void *parameter) {
+    HostKernel &k = host_kernel();
+    host_task_self();
+    HostTask *created = new HostTask();
+    k.tasks.push_back(created);
+    std::thread([created, task, parameter] {
+        HostKernel &k = host_kernel();
+        host_task_slot() = created;
+        created->hold = std::unique_lock<std::mutex>(k.lock);
+        created->turn.wait(created->hold, [&k, created] { return k.current == created; });
+        task(parameter);
+        created->exited = true;
+        host_schedule(created);
+        created->hold.unlock();
+    }).detach();
+}
+
+// The calling task ends, the turn goes on; the caller then leaves its thread
+inline void host_task_exit() {
+    HostTask *self = host_task_self();
+    self->exited = true;
+    host_schedule(self);
+    self->hold.unlock();
+}
+
+// Let the other tasks and timers run for us of virtual time
+inline void host_clock_advance(uint64_t us) {
+    host_block(NULL, host_kernel().now + us);
+}
@@ -0,0 +1,23 @@
+// ==================================================================
+// Host shim: GPIO output set/clear registers, written into hostPinLevel
+// ==================================================================
+
+#pragma once
+
+#include "Arduino.h"
+
+// Writing a mask sets (or clears) every pin whose bit is set
+struct HostGpioRegister {
+    int level;
+    void operator=(uint32_t mask) {
+        for (int pin = 0; pin < 32; pin++) {
+            if (mask & (1UL << pin)) host_pin_write(pin, level);
+        }
+    }
+};
+
+struct HostGpio {
+    HostGpioRegister out_w1ts = { HIGH };
+    HostGpioRegister out_w1tc = { LOW };
+};
+extern HostGpio GPIO;
@@ -0,0 +1,439 @@
+// ==================================================================
+// Benchmark: LED frames and relay edges of the firmware on a Linux host
+// ==================================================================
+// Build (from the repository root):
+//   g++ -std=c++11 -O2 -pthread -DHOST_VIRTUAL_CLOCK -Itools/loadtest/emulator/shim -o switch_bench tools/loadtest/emulator/switch_bench.cpp
+//
+// Usage:
+//   switch_bench [--label TEXT] [--record FILE]
+//
+// Compiles the unchanged LED task, pattern interpreter, relay scheduler
+// and /control/* handlers against the shims in shim/, like
+// switch_emulator, but on the virtual clock (host_kernel.h): the LED
+// task and the esp_timer callbacks run one at a time and time only
+// moves when all of them wait, so latencies are exact and the same on
+// every run. The shims record every frame sent to the ring and every
+// relay pin edge with its time. Reports, as one JSON object on stdout:
+//   patterns     per built-in pattern: host CPU time to compute a frame in
+//                playPattern(), including the hand-off to the output, in ns
+//                and in ESP.getCycleCount() cycles (the shim counts host
+//                cycles there)
+//   first_frame  per enabled pattern: virtual time from LED_Message_queue_send()
+//                to its first frame on the ring, from a still ring and
+//                replacing a running pattern
+//   relay        host CPU time from the handler call to the relay edge, and
+//                virtual time from a click to its press and release edges
+//                (a queued click waits for the pulse before it and the gap)
+//   long_pulse   time spent in / and /control/click handlers on an idle
+//                relay and while a RELAY_PULSE_MAX_MS pulse runs
+// CPU times are the host's, compare runs with each other, not with the
+// device. Virtual times follow the firmware's own timing (refresh rate,
+// pulse width, gap) and change only when the code does.
+// --record writes every recorded frame and edge as text.
+
+#include "Arduino.h"
+#include "ESPAsyncWebServer.h"
+#include "soc/gpio_struct.h"
+
+#include <unistd.h>
+
+#include <map>
+#include <vector>
+
+bool hostSerialEcho = false;
+int hostPinLevel[40];
+HostSerial Serial;
+HostEsp ESP;
+HostGpio GPIO;
+
+#include "../../../wireless_transceiver_v2/index_html.h"
+#include "../../../wireless_transceiver_v2/wireless_config.h"
+#include "../../../wireless_transceiver_v2/build_profile.h"
+#include "../../../wireless_transceiver_v2/metrics.h"
+#include "../../../wireless_transceiver_v2/task_topology.h"
+#include "../../../wireless_transceiver_v2/trace.h"
+#include "../../../wireless_transceiver_v2/log.h"
+#include "../../../wireless_transceiver_v2/led_task.h"
+#include "../../../wireless_transceiver_v2/relay_task.h"
+
+// The sequencer needs the hardware timer, nothing to stop here
+void sequence_stop_locked() {}
+
+#include "../../../wireless_transceiver_v2/admission.h"
+#include "../../../wireless_transceiver_v2/control_handlers.h"
+
+// Frames timed per pattern for the compute figure, at least
+#define BENCH_COMPUTE_FRAMES 20000
+// Frames of one play of a pattern that loops forever
+#define BENCH_FOREVER_FRAMES 1000
+// Trials per latency figure, each at a different phase of the refresh timer
+#define BENCH_TRIALS 32
+// Virtual time for a pattern or pulse to finish before the next trial (us)
+#define BENCH_SETTLE_US 10000000
+// Requests during the long pulse, one / and one click per step
+#define BENCH_PULSE_STEPS 19
+#define BENCH_PULSE_STEP_US 300000
+// Client address of the benchmark's requests (network order, 10.0.0.2)
+#define BENCH_CLIENT_IP 0x0200000a
+
+struct BenchPattern {
+    int code;
+    const char *name;
+};
+
+const BenchPattern benchPatterns[] = {
+    { LED_FADEIN, "fadein" },
+    { LED_OFF, "off" },
+    { LED_LOADING, "loading" },
+    { LED_LOADING_LONG, "loading_long" },
+    { LED_LOAD_IN, "load_in" },
+    { LED_LOAD_OUT, "load_out" },
+    { LED_BREATHE, "breathe" },
+    { LED_CIRCLE_IN, "circle_in" },
+    { LED_FLASH, "flash" },
+    { LED_FLASH_FAST, "flash_fast" },
+    { LED_PERSIST_STATUS_1, "persist_status_1" },
+    { LED_PERSIST_STATUS_2, "persist_status_2" },
+};
+
+
+/*
+ * =======================================================
+ * Statistics
+ * =======================================================
+ */
+
+double percentile(std::vector<double> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[index];
+}
+
+std::string stats_json(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    char text[160];
+    snprintf(text, sizeof(text), "{\"min\": %.0f, \"p50\": %.0f, \"p99\": %.0f, \"max\": %.0f}",
+             values.empty() ? 0 : values.front(), percentile(values, 0.5), percentile(values, 0.99),
+             values.empty() ? 0 : values.back());
+    return text;
+}
+
+
+/*
+ * =======================================================
+ * LED patterns
+ * =======================================================
+ */
+
+// Host CPU time per frame of playPattern() over whole plays, before the LED
+// task starts (the output only copies the frame then), in ns and in
+// ESP.getCycleCount() cycles as the firmware's LED_PROFILE_FRAMES counts them
+// return false if the pattern is off
+bool bench_frame_compute(int code, int &framesPerPlay, double &ns, double &cycles) {
+    static LEDAnimation anim;
+    anim.pattern = code;
+    anim.programLength = led_program_load(code, anim.program);
+    anim.colors[0] = 0;
+    anim.colors[1] = 40;
+    anim.colors[2] = 40;
+    framesPerPlay = 0;
+    if (anim.programLength == 0) return false;
+
+    while (framesPerPlay < BENCH_FOREVER_FRAMES && playPattern(anim, framesPerPlay) != LED_PATTERN_DONE) {
+        framesPerPlay++;
+    }
+    if (framesPerPlay == 0) return false;
+
+    // best of several batches, the others carry scheduler noise
+    for (int batch = 0; batch < 5; batch++) {
+        long frames = 0;
+        uint64_t start = host_real_nanos();
+        uint32_t startCycles = ESP.getCycleCount();
+        while (frames < BENCH_COMPUTE_FRAMES / 5) {
+            for (int frame = 0; frame < framesPerPlay; frame++) {
+                playPattern(anim, frame);
+            }
+            frames += framesPerPlay;
+        }
+        double batchCycles = (double)(uint32_t)(ESP.getCycleCount() - startCycles) / frames;
+        double batchNs = (double)(host_real_nanos() - start) / frames;
+        if (batch == 0 || batchNs < ns) {
+            ns = batchNs;
+            cycles = batchCycles;
+        }
+    }
+    return true;
+}
+
+// Virtual us from sending a pattern to the first frame on the ring after it
+double bench_first_frame(int code) {
+    HostRecorder &r = host_recorder();
+    size_t seen = r.frames.size();
+    uint64_t sentAt = host_micros64();
+    LED_Message_queue_send(code, 0, 40, 40, false, LED_PRIORITY_ACTUATION, true);
+    // the LED task runs as soon as this task waits
+    host_clock_advance(100000);
+    if (r.frames.size() == seen) return -1;
+    return (double)(r.frames[seen].at - sentAt);
+}
+
+std::string bench_patterns() {
+    std::string out = "{";
+    for (size_t i = 0; i < sizeof(benchPatterns) / sizeof(benchPatterns[0]); i++) {
+        const BenchPattern &p = benchPatterns[i];
+        int framesPerPlay;
+        double ns = 0;
+        double cycles = 0;
+        bool enabled = bench_frame_compute(p.code, framesPerPlay, ns, cycles);
+        if (i > 0) out += ", ";
+        out += "\"" + std::string(p.name) + "\": ";
+        if (!enabled) {
+            out += "{\"enabled\": false}";
+            continue;
+        }
+        char text[160];
+        snprintf(text, sizeof(text), "{\"enabled\": true, \"frames_per_play\": %d, \"compute_ns_per_frame\": %.1f, "
+                 "\"compute_cycles_per_frame\": %.0f}", framesPerPlay, ns, cycles);
+        out += text;
+    }
+    return out + "}";
+}
+
+// First-frame latency of every enabled pattern, with the LED task running
+std::string bench_pattern_latency() {
+    std::string out = "{";
+    bool first = true;
+    for (size_t i = 0; i < sizeof(benchPatterns) / sizeof(benchPatterns[0]); i++) {
+        const BenchPattern &p = benchPatterns[i];
+        uint8_t program[LED_PROGRAM_MAX_BYTES];
+        if (led_program_load(p.code, program) == 0) continue;
+
+        std::vector<double> still;
+        std::vector<double> running;
+        for (int trial = 0; trial < BENCH_TRIALS; trial++) {
+            // a still ring: the last pattern has ended and the refresh timer stopped
+            host_clock_advance(BENCH_SETTLE_US + trial * 317);
+            still.push_back(bench_first_frame(p.code));
+            // replacing the pattern just started, at a different refresh phase each time
+            host_clock_advance(trial * 317);
+            running.push_back(bench_first_frame(p.code));
+        }
+        if (!first) out += ", ";
+        first = false;
+        out += "\"" + std::string(p.name) + "\": {\"still_us\": " + stats_json(still) +
+               ", \"running_us\": " + stats_json(running) + "}";
+    }
+    return out + "}";
+}
+
+
+/*
+ * =======================================================
+ * Relay
+ * =======================================================
+ */
+
+// Call a handler like the web server does, return the status it sent
+int bench_request(void (*handler)(AsyncWebServerRequest *), const char *path, const char *interval) {
+    AsyncWebServerRequest request;
+    request.path = path;
+    request.remote.ip = BENCH_CLIENT_IP;
+    if (interval != NULL) {
+        request.params.push_back(AsyncWebParameter("interval", interval));
+    }
+    handler(&request);
+    return request.response != NULL ? request.response->code : 0;
+}
+
+// Edges of the relay pin recorded from index seen on
+std::vector<HostEdge> bench_relay_edges(size_t seen) {
+    std::vector<HostEdge> edges;
+    HostRecorder &r = host_recorder();
+    for (size_t i = seen; i < r.edges.size(); i++) {
+        if (r.edges[i].pin == relayPins[0]) edges.push_back(r.edges[i]);
+    }
+    return edges;
+}
+
+std::string bench_relay() {
+    HostRecorder &r = host_recorder();
+    std::vector<double> clickCpu, clickRelease, queuedPress, queuedRelease, holdCpu, releaseCpu;
+    int failures = 0;
+    for (int trial = 0; trial < BENCH_TRIALS; trial++) {
+        // a 300 ms click on an idle relay, then a second one 100 ms into it,
+        // queued behind the first and started after the release gap
+        host_clock_advance(BENCH_SETTLE_US + trial * 317);
+        size_t seen = r.edges.size();
+        uint64_t requestAt = host_micros64();
+        uint64_t requestNanos = host_real_nanos();
+        failures += bench_request(handleClick, "/control/click", "300") != 200;
+        host_clock_advance(100000);
+        uint64_t queuedAt = host_micros64();
+        failures += bench_request(handleClick, "/control/click", "300") != 200;
+        host_clock_advance(1000000);
+        std::vector<HostEdge> edges = bench_relay_edges(seen);
+        if (edges.size() != 4) {
+            failures++;
+            continue;
+        }
+        clickCpu.push_back((double)(edges[0].realNanos - requestNanos));
+        clickRelease.push_back((double)(edges[1].at - requestAt));
+        queuedPress.push_back((double)(edges[2].at - queuedAt));
+        queuedRelease.push_back((double)(edges[3].at - queuedAt));
+
+        // hold and release
+        host_clock_advance(trial * 317);
+        seen = r.edges.size();
+        requestNanos = host_real_nanos();
+        failures += bench_request(handleActivation, "/control/activate", NULL) != 200;
+        uint64_t releaseNanos = host_real_nanos();
+        failures += bench_request(handleDeactivation, "/control/deactivate", NULL) != 200;
+        edges = bench_relay_edges(seen);
+        if (edges.size() != 2) {
+            failures++;
+            continue;
+        }
+        holdCpu.push_back((double)(edges[0].realNanos - requestNanos));
+        releaseCpu.push_back((double)(edges[1].realNanos - releaseNanos));
+    }
+    char text[64];
+    snprintf(text, sizeof(text), "{\"failures\": %d", failures);
+    return std::string(text) +
+           ", \"click_press_cpu_ns\": " + stats_json(clickCpu) +
+           ", \"click_300ms_release_us\": " + stats_json(clickRelease) +
+           ", \"queued_click_press_us\": " + stats_json(queuedPress) +
+           ", \"queued_click_release_us\": " + stats_json(queuedRelease) +
+           ", \"activate_press_cpu_ns\": " + stats_json(holdCpu) +
+           ", \"deactivate_release_cpu_ns\": " + stats_json(releaseCpu) + "}";
+}
+
+// Handler call timed in host CPU ns and in virtual us
+int bench_timed_request(void (*handler)(AsyncWebServerRequest *), const char *path, const char *interval,
+                        std::vector<double> &cpu, uint64_t &virtualMax) {
+    uint64_t at = host_micros64();
+    uint64_t nanos = host_real_nanos();
+    int status = bench_request(handler, path, interval);
+    cpu.push_back((double)(host_real_nanos() - nanos));
+    virtualMax = max(virtualMax, host_micros64() - at);
+    return status;
+}
+
+// / and short clicks every BENCH_PULSE_STEP_US, on an idle relay and while a
+// RELAY_PULSE_MAX_MS click runs: a handler waiting on the pulse would take
+// virtual time, so both maxima have to stay 0 and the CPU times alike
+std::string bench_long_pulse() {
+    std::vector<double> idleCpu, pulseCpu;
+    uint64_t idleVirtual = 0;
+    uint64_t pulseVirtual = 0;
+    std::map<int, int> pulseStatus;
+    char interval[8];
+    snprintf(interval, sizeof(interval), "%d", RELAY_PULSE_MAX_MS);
+
+    host_clock_advance(BENCH_SETTLE_US);
+    for (int step = 0; step < BENCH_PULSE_STEPS; step++) {
+        bench_timed_request(handleRoot, "/", NULL, idleCpu, idleVirtual);
+        bench_timed_request(handleClick, "/control/click", "50", idleCpu, idleVirtual);
+        host_clock_advance(BENCH_PULSE_STEP_US);
+    }
+
+    host_clock_advance(BENCH_SETTLE_US);
+    bench_request(handleClick, "/control/click", interval);
+    for (int step = 0; step < BENCH_PULSE_STEPS; step++) {
+        host_clock_advance(BENCH_PULSE_STEP_US);
+        bench_timed_request(handleRoot, "/", NULL, pulseCpu, pulseVirtual);
+        pulseStatus[bench_timed_request(handleClick, "/control/click", "50", pulseCpu, pulseVirtual)]++;
+    }
+    host_clock_advance(BENCH_SETTLE_US);
+
+    char text[128];
+    snprintf(text, sizeof(text), "{\"pulse_ms\": %d, \"idle_virtual_max_us\": %llu, \"pulse_virtual_max_us\": %llu",
+             RELAY_PULSE_MAX_MS, (unsigned long long)idleVirtual, (unsigned long long)pulseVirtual);
+    std::string out = std::string(text) + ", \"idle_cpu_ns\": " + stats_json(idleCpu) +
+                      ", \"pulse_cpu_ns\": " + stats_json(pulseCpu) + ", \"pulse_click_status\": {";
+    for (std::map<int, int>::iterator it = pulseStatus.begin(); it != pulseStatus.end(); ++it) {
+        if (it != pulseStatus.begin()) out += ", ";
+        out += "\"" + std::to_string(it->first) + "\": " + std::to_string(it->second);
+    }
+    return out + "}}";
+}
+
+
+/*
+ * =======================================================
+ * Main
+ * =======================================================
+ */
+
+// Every recorded frame and edge, one per line in time order
+void bench_write_record(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return;
+    }
+    HostRecorder &r = host_recorder();
+    size_t f = 0;
+    size_t e = 0;
+    while (f < r.frames.size() || e < r.edges.size()) {
+        if (e == r.edges.size() || (f < r.frames.size() && r.frames[f].at <= r.edges[e].at)) {
+            fprintf(file, "%llu frame", (unsigned long long)r.frames[f].at);
+            for (size_t i = 0; i < r.frames[f].bytes.size(); i++) fprintf(file, " %02x", r.frames[f].bytes[i]);
+            fprintf(file, "\n");
+            f++;
+        } else {
+            fprintf(file, "%llu edge pin %d %s\n", (unsigned long long)r.edges[e].at, r.edges[e].pin,
+                    r.edges[e].level == HIGH ? "high" : "low");
+            e++;
+        }
+    }
+    fclose(file);
+}
+
+int main(int argc, char **argv) {
+    std::string label;
+    const char *recordPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            label = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--label TEXT] [--record FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // CPU figures first, with nothing else running
+    led_patterns_init();
+    std::string patterns = bench_patterns();
+
+    // same start order as setup()
+    if (!log_init()) {
+        Serial.println("[ERROR] >>> log drain failed to start");
+    }
+    if (!led_queue_init()) {
+        LOG_ERROR("LED queue failed to create");
+    }
+    task_create(TASK_LED_RING, LED_ring_task);
+    if (!relay_init()) {
+        LOG_ERROR("relay pulse timer failed to create");
+    }
+    host_clock_advance(100000);
+    host_recorder().enabled = true;
+
+    std::string latency = bench_pattern_latency();
+    std::string relay = bench_relay();
+    std::string longPulse = bench_long_pulse();
+
+    printf("{\"label\": \"%s\", \"led_refresh_hz\": %d, \"patterns\": %s, \"first_frame\": %s, \"relay\": %s, "
+           "\"long_pulse\": %s}\n", label.c_str(), LED_REFRESH_HZ, patterns.c_str(), latency.c_str(), relay.c_str(),
+           longPulse.c_str());
+    fprintf(stderr, "%zu frames and %zu relay edges recorded over %.1f s of virtual time\n",
+            host_recorder().frames.size(), host_recorder().edges.size(), host_micros64() / 1e6);
+    if (recordPath != NULL) {
+        bench_write_record(recordPath);
+    }
+    fflush(stdout);
+    // the LED task and the log drain are still blocked in their threads
+    _exit(0);
+}
@@ -0,0 +1,347 @@
+// ==================================================================
+// Device emulator: the firmware's HTTP handlers on a Linux host
+// ==================================================================
+// Build (from the repository root):
+//   g++ -std=c++11 -O2 -pthread -Itools/loadtest/emulator/shim -o switch_emulator tools/loadtest/emulator/switch_emulator.cpp
+//
+// Usage:
+//   switch_emulator [--port 8080] [--verbose] [--flash-dir .] [--flash-erase-us 0]
+//
+// Compiles the unchanged firmware sources for the control page,
+// /control/* (control_handlers.h with the admission, relay and LED
+// modules underneath) and /update (ota_update.h) against the shims in
+// shim/. Request bodies reach the body handler in pieces of one TCP
+// segment, as on the device. /update writes the OTA partitions as files
+// in --flash-dir (app1.bin takes the upload), each sector erase stalls
+// for --flash-erase-us; the restart into the new image is not emulated. A single thread runs
+// every handler, like the AsyncTCP task on the device; the relay timer
+// and the LED task run in their own threads as they do there. The
+// /control/{ch}/... routes use relayPins from wireless_config.h.
+// Absolute numbers are a host's, so compare runs with each other, not
+// with the device. /control/sequence needs the hardware timer and is not
+// emulated (404).
+
+#include "Arduino.h"
+#include "ESPAsyncWebServer.h"
+#include "soc/gpio_struct.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <map>
+
+bool hostSerialEcho = false;
+int hostPinLevel[40];
+HostSerial Serial;
+HostEsp ESP;
+HostGpio GPIO;
+
+#include "../../../wireless_transceiver_v2/index_html.h"
+#include "../../../wireless_transceiver_v2/wireless_config.h"
+#include "../../../wireless_transceiver_v2/build_profile.h"
+#include "../../../wireless_transceiver_v2/metrics.h"
+#include "../../../wireless_transceiver_v2/task_topology.h"
+#include "../../../wireless_transceiver_v2/trace.h"
+#include "../../../wireless_transceiver_v2/log.h"
+#include "../../../wireless_transceiver_v2/led_task.h"
+#include "../../../wireless_transceiver_v2/relay_task.h"
+
+// The sequencer needs the hardware timer, nothing to stop here
+void sequence_stop_locked() {}
+
+#include "../../../wireless_transceiver_v2/admission.h"
+#include "../../../wireless_transceiver_v2/control_handlers.h"
+#include "../../../wireless_transceiver_v2/ota_update.h"
+
+// Longest request head accepted
+#define EMULATOR_MAX_HEAD 8192
+// Body bytes per body handler call, one TCP segment on the device
+#define EMULATOR_BODY_CHUNK 1436
+
+const char *hostFlashDir = ".";
+uint32_t hostFlashEraseMicros = 0;
+
+struct Route {
+    ArRequestHandlerFunction handler;
+    ArBodyHandlerFunction body;         // NULL to drop the request body
+};
+
+struct Connection {
+    std::string in;
+    std::string out;
+    uint32_t ip;            // peer address as lwIP stores it (network order)
+    bool closeAfterWrite;
+    AsyncWebServerRequest *request;     // request whose body is arriving, NULL between requests
+    size_t bodyIndex;                   // body bytes handed on so far
+    bool closeAfterRequest;
+};
+
+
+/*
+ * =======================================================
+ * HTTP
+ * =======================================================
+ */
+
+std::string url_decode(const std::string &text) {
+    std::string out;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '%' && i + 2 < text.size()) {
+            out += (char)strtol(text.substr(i + 1, 2).c_str(), NULL, 16);
+            i += 2;
+        } else {
+            out += text[i] == '+' ? ' ' : text[i];
+        }
+    }
+    return out;
+}
+
+const char *reason(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 404: return "Not Found";
+        case 409: return "Conflict";
+        case 413: return "Payload Too Large";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        default:  return "Status";
+    }
+}
+
+// Route of a fixed path, NULL for the rest
+const Route *route_find(const String &path) {
+    static std::map<std::string, Route> routes = {
+        { "/", { handleRoot, NULL } },
+        { "/control/click", { handleClick, NULL } },
+        { "/control/activate", { handleActivation, NULL } },
+        { "/control/deactivate", { handleDeactivation, NULL } },
+        { "/update", { handleUpdate, handleUpdateBody } },
+    };
+    std::map<std::string, Route>::iterator route = routes.find(path.c_str());
+    return route == routes.end() ? NULL : &route->second;
+}
+
+// Parse one request head (without the blank line)
+AsyncWebServerRequest *parse(const std::string &head, uint32_t ip, bool &close) {
+    AsyncWebServerRequest *request = new AsyncWebServerRequest();
+    request->remote.ip = ip;
+
+    size_t lineEnd = head.find("\r\n");
+    std::string line = head.substr(0, lineEnd);
+    size_t first = line.find(' ');
+    size_t second = line.find(' ', first + 1);
+    std::string target = (first == std::string::npos) ? "/" : line.substr(first + 1, second - first - 1);
+    close = line.compare(second + 1, std::string::npos, "HTTP/1.0") == 0;
+    std::string verb = line.substr(0, first);
+    request->verb = verb == "POST" ? HTTP_POST : verb == "DELETE" ? HTTP_DELETE : HTTP_GET;
+
+    size_t query = target.find('?');
+    request->path = url_decode(target.substr(0, query)).c_str();
+    if (query != std::string::npos) {
+        std::string rest = target.substr(query + 1);
+        size_t start = 0;
+        while (start < rest.size()) {
+            size_t amp = rest.find('&', start);
+            if (amp == std::string::npos) amp = rest.size();
+            std::string pair = rest.substr(start, amp - start);
+            size_t equals = pair.find('=');
+            request->params.push_back(AsyncWebParameter(url_decode(pair.substr(0, equals)),
+                url_decode(equals == std::string::npos ? "" : pair.substr(equals + 1))));
+            start = amp + 1;
+        }
+    }
+    size_t at = lineEnd;
+    while (at != std::string::npos && at + 2 < head.size()) {
+        size_t next = head.find("\r\n", at + 2);
+        std::string header = head.substr(at + 2, next == std::string::npos ? std::string::npos : next - at - 2);
+        size_t colon = header.find(':');
+        if (colon != std::string::npos) {
+            std::string value = header.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(' '));
+            request->headers.push_back(AsyncWebHeader(header.substr(0, colon), value));
+            if (strcasecmp(header.substr(0, colon).c_str(), "Connection") == 0) {
+                close = strcasecmp(value.c_str(), "close") == 0;
+            }
+            if (strcasecmp(header.substr(0, colon).c_str(), "Content-Length") == 0) {
+                request->length = strtoul(value.c_str(), NULL, 10);
+            }
+        }
+        at = next;
+    }
+    return request;
+}
+
+// Run the handler of a request whose body has arrived
+// return the serialized response
+std::string serve(AsyncWebServerRequest &request, bool close) {
+    static ControlChannelHandler channelRoutes;
+    const Route *route = route_find(request.path);
+    if (route != NULL) {
+        route->handler(&request);
+    } else if (channelRoutes.canHandle(&request)) {
+        channelRoutes.handleRequest(&request);
+    }
+    if (request.response == NULL) {
+        request.send(404, "text/plain", "Not found");
+    }
+
+    AsyncWebServerResponse &r = *request.response;
+    std::string out = "HTTP/1.1 " + std::to_string(r.code) + " " + reason(r.code) + "\r\n";
+    if (r.contentType.length() > 0) out += std::string("Content-Type: ") + r.contentType.c_str() + "\r\n";
+    for (size_t i = 0; i < r.headers.size(); i++) {
+        out += std::string(r.headers[i].first.c_str()) + ": " + r.headers[i].second.c_str() + "\r\n";
+    }
+    out += "Content-Length: " + std::to_string(r.body.size()) + "\r\n";
+    out += close ? "Connection: close\r\n\r\n" : "Connection: keep-alive\r\n\r\n";
+    out += r.body;
+    return out;
+}
+
+// The request is done with, as when its connection closes on the device
+void release(AsyncWebServerRequest *request) {
+    if (request->disconnected) {
+        request->disconnected();
+    }
+    delete request;
+}
+
+
+/*
+ * =======================================================
+ * Main
+ * =======================================================
+ */
+
+int main(int argc, char **argv) {
+    int port = 8080;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            hostSerialEcho = true;
+        } else if (strcmp(argv[i], "--flash-dir") == 0 && i + 1 < argc) {
+            hostFlashDir = argv[++i];
+        } else if (strcmp(argv[i], "--flash-erase-us") == 0 && i + 1 < argc) {
+            hostFlashEraseMicros = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--port 8080] [--verbose] [--flash-dir .] [--flash-erase-us 0]\n", argv[0]);
+            return 2;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // same start order as setup()
+    if (!log_init()) {
+        Serial.println("[ERROR] >>> log drain failed to start");
+    }
+    if (!led_queue_init()) {
+        LOG_ERROR("LED queue failed to create");
+    }
+    if (!led_patterns_init()) {
+        LOG_ERROR("LED pattern lock failed to create");
+    }
+    task_create(TASK_LED_RING, LED_ring_task);
+    if (!relay_init()) {
+        LOG_ERROR("relay pulse timer failed to create");
+    }
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listener, (sockaddr *)&address, sizeof(address)) < 0 || listen(listener, 512) < 0) {
+        perror("listen");
+        return 1;
+    }
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+    fprintf(stderr, "switch emulator on port %d\n", port);
+
+    std::map<int, Connection> connections;
+    std::vector<pollfd> fds;
+    for (;;) {
+        fds.clear();
+        fds.push_back({ listener, POLLIN, 0 });
+        for (std::map<int, Connection>::iterator it = connections.begin(); it != connections.end(); ++it) {
+            fds.push_back({ it->first, (short)(it->second.out.empty() ? POLLIN : POLLOUT), 0 });
+        }
+        poll(fds.data(), fds.size(), -1);
+
+        if (fds[0].revents & POLLIN) {
+            sockaddr_in peer;
+            socklen_t peerLength = sizeof(peer);
+            int client;
+            while ((client = accept(listener, (sockaddr *)&peer, &peerLength)) >= 0) {
+                fcntl(client, F_SETFL, O_NONBLOCK);
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+                Connection &c = connections[client];
+                c.ip = peer.sin_addr.s_addr;
+                c.closeAfterWrite = false;
+                c.request = NULL;
+                peerLength = sizeof(peer);
+            }
+        }
+
+        for (size_t i = 1; i < fds.size(); i++) {
+            int fd = fds[i].fd;
+            Connection &c = connections[fd];
+            bool drop = false;
+            if (fds[i].revents & POLLOUT) {
+                ssize_t sent = send(fd, c.out.data(), c.out.size(), 0);
+                if (sent > 0) c.out.erase(0, sent);
+                if (sent < 0 || (c.out.empty() && c.closeAfterWrite)) drop = true;
+            } else if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                char buffer[4096];
+                ssize_t length = recv(fd, buffer, sizeof(buffer), 0);
+                if (length <= 0) {
+                    drop = true;
+                } else {
+                    c.in.append(buffer, length);
+                }
+            }
+            // every complete request that arrived, in order
+            while (!drop && !c.closeAfterWrite) {
+                if (c.request == NULL) {
+                    size_t end = c.in.find("\r\n\r\n");
+                    if (end == std::string::npos) break;
+                    c.request = parse(c.in.substr(0, end), c.ip, c.closeAfterRequest);
+                    c.bodyIndex = 0;
+                    c.in.erase(0, end + 4);
+                }
+                // hand the body on as it arrives
+                const Route *route = route_find(c.request->path);
+                while (c.bodyIndex < c.request->length && !c.in.empty()) {
+                    size_t n = min(min(c.in.size(), c.request->length - c.bodyIndex), (size_t)EMULATOR_BODY_CHUNK);
+                    if (route != NULL && route->body != NULL) {
+                        route->body(c.request, (uint8_t *)c.in.data(), n, c.bodyIndex, c.request->length);
+                    }
+                    c.bodyIndex += n;
+                    c.in.erase(0, n);
+                }
+                if (c.bodyIndex < c.request->length) break;
+                c.out += serve(*c.request, c.closeAfterRequest);
+                c.closeAfterWrite = c.closeAfterRequest;
+                release(c.request);
+                c.request = NULL;
+            }
+            if (c.request == NULL && c.in.size() > EMULATOR_MAX_HEAD) drop = true;
+            if (drop) {
+                if (c.request != NULL) release(c.request);
+                close(fd);
+                connections.erase(fd);
+            }
+        }
+    }
+}
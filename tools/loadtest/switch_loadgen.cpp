@@ -0,0 +1,408 @@
+// ==================================================================
+// HTTP load generator for the switch (device or emulator)
+// ==================================================================
+// Build (Linux):
+//   g++ -std=c++11 -O2 -o switch_loadgen tools/loadtest/switch_loadgen.cpp
+//
+// Usage:
+//   switch_loadgen [options]
+// Options:
+//   --target ADDR:PORT    device or switch_emulator (default 127.0.0.1:8080)
+//   --duration S          measured seconds (default 10)
+//   --connections N       connections kept open (default 8)
+//   --rate R              open loop: R requests/s on a fixed schedule;
+//                         without it every connection sends its next
+//                         request as soon as the last one is answered (closed loop)
+//   --mix LIST            weighted request mix (default root=1,click=6,activate=1,deactivate=1)
+//   --click-ms MS         click width (default 50)
+//   --clients N           spread connections over N source addresses
+//                         127.0.0.2 .. (loopback targets only), so per-client
+//                         limits see N phones instead of one
+//   --keys P              percent of control requests carrying an Idempotency-Key,
+//                         half of them retries of an earlier key (default 0)
+//   --close               one request per connection instead of keep-alive
+//   --label TEXT          copied into the report
+//
+// Prints one JSON object with throughput, status counts and latency
+// percentiles (overall and per endpoint) to stdout, a summary to stderr.
+// Open-loop latency counts from the scheduled send time, so a slow server
+// shows up as latency instead of quietly lowering the request rate.
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     // ppoll
+#endif
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// One kind of request in the mix
+struct Endpoint {
+    std::string name;
+    std::string path;
+    int weight;
+    bool control;           // subject to admission, may carry an idempotency key
+};
+
+// Latencies (us) and status counts of one endpoint or of everything
+struct Stats {
+    std::vector<double> latencies;
+    std::map<int, long> status;
+    long errors = 0;
+};
+
+struct Connection {
+    int sock = -1;
+    bool connected = false;
+    bool busy = false;
+    size_t endpoint;
+    Clock::time_point startedAt;     // scheduled (open loop) or actual send time
+    std::string out;
+    std::string in;
+};
+
+
+/*
+ * =======================================================
+ * Options
+ * =======================================================
+ */
+
+sockaddr_in target;
+double duration = 10;
+int connectionCount = 8;
+double rate = 0;
+int clickMs = 50;
+int clients = 0;
+int keyPercent = 0;
+bool closeEach = false;
+std::string label;
+std::vector<Endpoint> endpoints;
+
+bool parse_mix(const std::string &mix) {
+    endpoints.clear();
+    size_t start = 0;
+    while (start < mix.size()) {
+        size_t comma = mix.find(',', start);
+        if (comma == std::string::npos) comma = mix.size();
+        std::string item = mix.substr(start, comma - start);
+        size_t equals = item.find('=');
+        std::string name = item.substr(0, equals);
+        int weight = equals == std::string::npos ? 1 : atoi(item.c_str() + equals + 1);
+        Endpoint e;
+        e.name = name;
+        e.weight = weight;
+        e.control = true;
+        if (name == "root") {
+            e.path = "/";
+            e.control = false;
+        } else if (name == "click") {
+            e.path = "/control/click?interval=" + std::to_string(clickMs);
+        } else if (name == "activate" || name == "deactivate") {
+            e.path = "/control/" + name;
+        } else {
+            fprintf(stderr, "unknown endpoint %s (root, click, activate, deactivate)\n", name.c_str());
+            return false;
+        }
+        if (weight > 0) endpoints.push_back(e);
+        start = comma + 1;
+    }
+    return !endpoints.empty();
+}
+
+
+/*
+ * =======================================================
+ * Connections
+ * =======================================================
+ */
+
+bool open_connection(Connection &c, int index) {
+    c.sock = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(c.sock, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    if (clients > 0) {
+        sockaddr_in source;
+        memset(&source, 0, sizeof(source));
+        source.sin_family = AF_INET;
+        source.sin_addr.s_addr = htonl(0x7f000002 + index % clients);
+        if (bind(c.sock, (sockaddr *)&source, sizeof(source)) < 0) {
+            perror("bind source address");
+            close(c.sock);
+            c.sock = -1;
+            return false;
+        }
+    }
+    fcntl(c.sock, F_SETFL, O_NONBLOCK);
+    if (connect(c.sock, (sockaddr *)&target, sizeof(target)) < 0 && errno != EINPROGRESS) {
+        close(c.sock);
+        c.sock = -1;
+        return false;
+    }
+    c.connected = false;
+    c.in.clear();
+    return true;
+}
+
+void drop_connection(Connection &c) {
+    if (c.sock >= 0) close(c.sock);
+    c.sock = -1;
+    c.connected = false;
+}
+
+// Length of a complete response at the start of in, 0 if not complete yet
+size_t response_length(const std::string &in) {
+    size_t end = in.find("\r\n\r\n");
+    if (end == std::string::npos) return 0;
+    size_t length = 0;
+    size_t at = in.find("Content-Length:");
+    if (at == std::string::npos) at = in.find("content-length:");
+    if (at != std::string::npos && at < end) length = atol(in.c_str() + at + 15);
+    return in.size() >= end + 4 + length ? end + 4 + length : 0;
+}
+
+
+/*
+ * =======================================================
+ * Report
+ * =======================================================
+ */
+
+double percentile(std::vector<double> &sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[index];
+}
+
+std::string stats_json(Stats &s) {
+    std::sort(s.latencies.begin(), s.latencies.end());
+    char text[256];
+    snprintf(text, sizeof(text),
+             "\"requests\": %zu, \"errors\": %ld, \"latency_us\": {\"p50\": %.0f, \"p99\": %.0f, \"p999\": %.0f, \"max\": %.0f}",
+             s.latencies.size(), s.errors, percentile(s.latencies, 0.5), percentile(s.latencies, 0.99),
+             percentile(s.latencies, 0.999), s.latencies.empty() ? 0 : s.latencies.back());
+    std::string out = text;
+    out += ", \"status\": {";
+    for (std::map<int, long>::iterator it = s.status.begin(); it != s.status.end(); ++it) {
+        if (it != s.status.begin()) out += ", ";
+        out += "\"" + std::to_string(it->first) + "\": " + std::to_string(it->second);
+    }
+    return out + "}";
+}
+
+
+/*
+ * =======================================================
+ * Main
+ * =======================================================
+ */
+
+int main(int argc, char **argv) {
+    std::string targetText = "127.0.0.1:8080";
+    std::string mix = "root=1,click=6,activate=1,deactivate=1";
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if (option == "--close") { closeEach = true; continue; }
+        if (i + 1 >= argc) option = "";
+        i++;
+        if (option == "--target") targetText = value;
+        else if (option == "--duration") duration = atof(value.c_str());
+        else if (option == "--connections") connectionCount = std::max(1, atoi(value.c_str()));
+        else if (option == "--rate") rate = atof(value.c_str());
+        else if (option == "--mix") mix = value;
+        else if (option == "--click-ms") clickMs = atoi(value.c_str());
+        else if (option == "--clients") clients = atoi(value.c_str());
+        else if (option == "--keys") keyPercent = atoi(value.c_str());
+        else if (option == "--label") label = value;
+        else {
+            fprintf(stderr, "usage: %s [--target ADDR:PORT] [--duration S] [--connections N] [--rate R]\n"
+                            "       [--mix root=1,click=6,...] [--click-ms MS] [--clients N] [--keys P] [--close] [--label TEXT]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    size_t colon = targetText.rfind(':');
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_port = htons(colon == std::string::npos ? 80 : atoi(targetText.c_str() + colon + 1));
+    if (inet_pton(AF_INET, targetText.substr(0, colon).c_str(), &target.sin_addr) != 1 || !parse_mix(mix)) {
+        fprintf(stderr, "bad --target or --mix\n");
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    std::mt19937 random(12345);
+    int totalWeight = 0;
+    for (size_t i = 0; i < endpoints.size(); i++) totalWeight += endpoints[i].weight;
+    std::vector<std::string> usedKeys;
+    long nextKey = 0;
+
+    std::vector<Connection> connections(connectionCount);
+    Stats total;
+    std::vector<Stats> perEndpoint(endpoints.size());
+    std::deque<Clock::time_point> backlog;      // open loop: scheduled sends waiting for a connection
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::microseconds((long)(duration * 1e6));
+    Clock::time_point nextArrival = start;
+    double interval = rate > 0 ? 1.0 / rate : 0;
+    long scheduled = 0;
+
+    for (;;) {
+        Clock::time_point now = Clock::now();
+        bool running = now < end;
+        if (rate > 0 && running) {
+            while (nextArrival <= now) {
+                backlog.push_back(nextArrival);
+                scheduled++;
+                nextArrival = start + std::chrono::microseconds((long)(scheduled * interval * 1e6));
+            }
+        }
+
+        // hand out work to idle connections
+        for (int i = 0; i < connectionCount && running; i++) {
+            Connection &c = connections[i];
+            if (c.busy) continue;
+            if (rate > 0 && backlog.empty()) break;
+            if (c.sock < 0 && !open_connection(c, i)) {
+                total.errors++;
+                continue;
+            }
+            int pick = std::uniform_int_distribution<int>(0, totalWeight - 1)(random);
+            size_t e = 0;
+            while (pick >= endpoints[e].weight) pick -= endpoints[e++].weight;
+            c.endpoint = e;
+            c.busy = true;
+            if (rate > 0) {
+                c.startedAt = backlog.front();
+                backlog.pop_front();
+            } else {
+                c.startedAt = now;
+            }
+            std::string headers = "Host: switch\r\n";
+            if (endpoints[e].control && (int)(random() % 100) < keyPercent) {
+                std::string key;
+                if (!usedKeys.empty() && random() % 2 == 0) {
+                    key = usedKeys[random() % usedKeys.size()];
+                } else {
+                    key = "load-" + std::to_string(nextKey++);
+                    usedKeys.push_back(key);
+                }
+                headers += "Idempotency-Key: " + key + "\r\n";
+            }
+            if (closeEach) headers += "Connection: close\r\n";
+            c.out = "GET " + endpoints[e].path + " HTTP/1.1\r\n" + headers + "\r\n";
+        }
+
+        bool anyBusy = false;
+        std::vector<pollfd> fds;
+        std::vector<int> owners;
+        for (int i = 0; i < connectionCount; i++) {
+            Connection &c = connections[i];
+            if (!c.busy) continue;
+            anyBusy = true;
+            fds.push_back({ c.sock, (short)(!c.connected || !c.out.empty() ? POLLOUT : POLLIN), 0 });
+            owners.push_back(i);
+        }
+        if (!running && !anyBusy) break;
+        // sleep until the next scheduled arrival at most, with microsecond resolution
+        long waitUs = 10000;
+        if (rate > 0 && running) {
+            long untilArrival = std::chrono::duration_cast<std::chrono::microseconds>(nextArrival - Clock::now()).count();
+            waitUs = std::max(0L, std::min(waitUs, untilArrival));
+        }
+        timespec timeout = { 0, waitUs * 1000 };
+        ppoll(fds.data(), fds.size(), &timeout, NULL);
+
+        now = Clock::now();
+        for (size_t k = 0; k < fds.size(); k++) {
+            Connection &c = connections[owners[k]];
+            bool failed = false;
+            bool done = false;
+            if (fds[k].revents & POLLOUT) {
+                if (!c.connected) {
+                    int error = 0;
+                    socklen_t length = sizeof(error);
+                    getsockopt(c.sock, SOL_SOCKET, SO_ERROR, &error, &length);
+                    if (error != 0) failed = true;
+                    c.connected = true;
+                }
+                if (!failed && !c.out.empty()) {
+                    ssize_t sent = send(c.sock, c.out.data(), c.out.size(), 0);
+                    if (sent < 0 && errno != EAGAIN) failed = true;
+                    if (sent > 0) c.out.erase(0, sent);
+                }
+            } else if (fds[k].revents & (POLLIN | POLLHUP | POLLERR)) {
+                char buffer[8192];
+                ssize_t length = recv(c.sock, buffer, sizeof(buffer), 0);
+                if (length <= 0) {
+                    failed = true;
+                } else {
+                    c.in.append(buffer, length);
+                    size_t complete = response_length(c.in);
+                    if (complete > 0) {
+                        int code = atoi(c.in.c_str() + 9);
+                        bool serverClose = c.in.find("Connection: close") < c.in.find("\r\n\r\n");
+                        double us = std::chrono::duration<double, std::micro>(now - c.startedAt).count();
+                        // requests started during the run count, the tail drains without counting
+                        if (c.startedAt < end) {
+                            total.latencies.push_back(us);
+                            total.status[code]++;
+                            perEndpoint[c.endpoint].latencies.push_back(us);
+                            perEndpoint[c.endpoint].status[code]++;
+                        }
+                        c.in.erase(0, complete);
+                        done = true;
+                        if (closeEach || serverClose) drop_connection(c);
+                    }
+                }
+            }
+            if (!failed && !done && now - c.startedAt > std::chrono::seconds(5)) failed = true;
+            if (failed) {
+                total.errors++;
+                perEndpoint[c.endpoint].errors++;
+                drop_connection(c);
+                done = true;
+            }
+            if (done) c.busy = false;
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    size_t answered = total.latencies.size();
+    std::string json = "{\"label\": \"" + label + "\", \"mode\": \"" + (rate > 0 ? "open" : "closed") + "\"";
+    char text[256];
+    snprintf(text, sizeof(text), ", \"connections\": %d, \"clients\": %d, \"offered_rps\": %.1f, \"duration_s\": %.2f, "
+             "\"throughput_rps\": %.1f, ", connectionCount, clients, rate, duration, answered / duration);
+    json += text + stats_json(total) + ", \"endpoints\": {";
+    for (size_t i = 0; i < endpoints.size(); i++) {
+        if (i > 0) json += ", ";
+        json += "\"" + endpoints[i].name + "\": {" + stats_json(perEndpoint[i]) + "}";
+    }
+    json += "}}";
+    printf("%s\n", json.c_str());
+
+    fprintf(stderr, "%zu answered in %.1f s (%.0f/s), %ld errors, latency p50 %.0f / p99 %.0f / p999 %.0f us\n",
+            answered, elapsed, answered / duration, total.errors, percentile(total.latencies, 0.5),
+            percentile(total.latencies, 0.99), percentile(total.latencies, 0.999));
+    return 0;
+}
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+# ==================================================================
+# Flash and static RAM cost of every build_profile.h switch
+# ==================================================================
+# Builds the sketch with arduino-cli as profiled, then once more per
+# switch in wireless_transceiver_v2/build_profile.h with that switch
+# flipped, and prints what each feature or built-in LED pattern costs:
+# the size with it on minus the size with it off.
+#
+#   python3 tools/size_report/size_report.py
+#   python3 tools/size_report/size_report.py --fqbn esp32:esp32:esp32:PartitionScheme=min_spiffs
+#   python3 tools/size_report/size_report.py --only buildOta buildWebSocket --json
+#
+# The maximum comes from the partition scheme in --fqbn, so the
+# headroom line shows whether a build fits e.g. the two OTA app slots of
+# a 4 MB module. Builds run in a temporary copy; the sketch itself is not
+# touched. Each build takes a minute or so, --only limits the list.
+
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SKETCH = os.path.join(HERE, "..", "..", "wireless_transceiver_v2")
+PROFILE = "build_profile.h"
+SWITCH = re.compile(r"^constexpr bool (build\w+) = (true|false);", re.M)
+# arduino-cli (and the IDE) print these after a successful build
+FLASH = re.compile(r"Sketch uses (\d+) bytes .*? Maximum is (\d+) bytes")
+RAM = re.compile(r"Global variables use (\d+) bytes .*? Maximum is (\d+) bytes")
+
+
+def read_switches(profile):
+    return [(name, value == "true") for name, value in SWITCH.findall(profile)]
+
+
+def flip(profile, name, on):
+    return re.sub(r"^(constexpr bool %s = )(true|false);" % name,
+                  r"\g<1>%s;" % ("true" if on else "false"), profile, flags=re.M)
+
+
+# Build the sketch with the given build_profile.h
+# return (flash, flash maximum, static RAM, RAM maximum) in bytes
+def build(args, profile, work):
+    sketch = os.path.join(work, "wireless_transceiver_v2")
+    shutil.rmtree(sketch, ignore_errors=True)
+    shutil.copytree(SKETCH, sketch)
+    with open(os.path.join(sketch, PROFILE), "w", encoding="utf-8", newline="\n") as f:
+        f.write(profile)
+    command = [args.arduino_cli, "compile", "--fqbn", args.fqbn,
+               "--build-path", os.path.join(work, "build"), sketch]
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    flash = FLASH.search(result.stdout)
+    ram = RAM.search(result.stdout)
+    if result.returncode != 0 or flash is None or ram is None:
+        sys.stderr.write(result.stdout)
+        raise SystemExit("build failed: %s" % " ".join(command))
+    return int(flash.group(1)), int(flash.group(2)), int(ram.group(1)), int(ram.group(2))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flash and static RAM cost of every build_profile.h switch")
+    parser.add_argument("--fqbn", default="esp32:esp32:esp32", help="board, with the partition scheme option if any")
+    parser.add_argument("--arduino-cli", default="arduino-cli", help="arduino-cli executable")
+    parser.add_argument("--only", nargs="+", metavar="SWITCH", help="report these switches only")
+    parser.add_argument("--json", action="store_true", help="print JSON instead of a table")
+    args = parser.parse_args()
+
+    with open(os.path.join(SKETCH, PROFILE), encoding="utf-8") as f:
+        profile = f.read()
+    switches = read_switches(profile)
+    if args.only:
+        unknown = set(args.only) - set(name for name, _ in switches)
+        if unknown:
+            raise SystemExit("not in %s: %s" % (PROFILE, ", ".join(sorted(unknown))))
+        switches = [s for s in switches if s[0] in args.only]
+
+    work = tempfile.mkdtemp(prefix="size_report_")
+    try:
+        flash, flash_max, ram, ram_max = build(args, profile, work)
+        costs = []
+        for name, on in switches:
+            other_flash, _, other_ram, _ = build(args, flip(profile, name, not on), work)
+            # cost of the switch: size with it on minus size with it off
+            sign = 1 if on else -1
+            costs.append({"switch": name, "on": on,
+                          "flash": sign * (flash - other_flash), "ram": sign * (ram - other_ram)})
+            if not args.json:
+                sys.stderr.write("%s done\n" % name)
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+    if args.json:
+        print(json.dumps({"fqbn": args.fqbn, "flash": flash, "flash_max": flash_max,
+                          "ram": ram, "ram_max": ram_max, "switches": costs}, indent=2))
+        return
+    print("%-26s %4s %12s %12s" % ("switch", "on", "flash", "static RAM"))
+    for c in costs:
+        print("%-26s %4s %+12d %+12d" % (c["switch"], "yes" if c["on"] else "no", c["flash"], c["ram"]))
+    print("%-26s %4s %12d %12d" % ("build as profiled", "", flash, ram))
+    print("%-26s %4s %12d %12d" % ("headroom", "", flash_max - flash, ram_max - ram))
+
+
+if __name__ == "__main__":
+    main()
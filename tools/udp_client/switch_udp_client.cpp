@@ -0,0 +1,325 @@
+// ==================================================================
+// Host client for the switch's binary UDP control protocol
+// ==================================================================
+// Protocol: wireless_transceiver_v2/udp_protocol.h (shared with the firmware)
+//
+// Build (Linux/macOS):
+//   g++ -std=c++11 -O2 -pthread -o switch_udp_client switch_udp_client.cpp
+//
+// Usage:
+//   switch_udp_client <host> <key> click <ms> [port]
+//   switch_udp_client <host> <key> press|release|ping [port]
+//   switch_udp_client --loopback
+// <key> is the udpControlKey from wireless_config.h (32 hex digits).
+// --loopback runs the firmware's protocol handler on 127.0.0.1 with a fake
+// relay and checks acks, resends, replays and epochs against it.
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "../../wireless_transceiver_v2/udp_protocol.h"
+
+#define DEFAULT_PORT 4210
+#define ACK_TIMEOUT_MS 250
+#define ATTEMPTS 5
+
+
+// One client session: its own sender id and sequence numbers
+class UdpClient {
+public:
+    UdpClient(const uint8_t key[16], const sockaddr_in &device) : device_(device) {
+        memcpy(key_, key, sizeof(key_));
+        std::random_device random;
+        do {
+            sender_ = random();
+        } while (sender_ == 0);
+        sock_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        timeval timeout = { 0, ACK_TIMEOUT_MS * 1000 };
+        setsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    ~UdpClient() {
+        close(sock_);
+    }
+
+    // Send raw bytes and wait for one ack from the device
+    // return false on timeout or if the ack does not verify
+    bool exchange(const uint8_t *packet, UdpPacket &ack) {
+        sendto(sock_, packet, UDP_PACKET_BYTES, 0, (const sockaddr *)&device_, sizeof(device_));
+        uint8_t in[UDP_PACKET_BYTES + 1];
+        for (;;) {
+            ssize_t length = recv(sock_, in, sizeof(in), 0);
+            if (length < 0) {
+                return false;
+            }
+            if (udp_decode(key_, in, length, ack) && (ack.type & UDP_ACK)) {
+                return true;
+            }
+        }
+    }
+
+    // Run a command until it is acknowledged, resending the same packet on timeouts
+    // status: UDP_STATUS_* of the ack, rttMs: round trip of the answered attempt
+    // return false if the device never answered
+    bool command(int type, int argument, int &status, double &rttMs) {
+        UdpPacket request;
+        request.type = type;
+        request.sender = sender_;
+        request.sequence = ++sequence_;
+        request.argument = argument;
+        for (int attempt = 0; attempt < ATTEMPTS; attempt++) {
+            request.epoch = epoch_;
+            uint8_t packet[UDP_PACKET_BYTES];
+            udp_encode(key_, request, packet);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            UdpPacket ack;
+            if (!exchange(packet, ack) || ack.sender != sender_ || ack.sequence != request.sequence) {
+                continue;
+            }
+            rttMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (ack.argument == UDP_STATUS_EPOCH) {
+                // device rebooted or first contact, same sequence number with the new epoch
+                epoch_ = ack.epoch;
+                attempt--;
+                if (++epochRetries_ > ATTEMPTS) return false;
+                continue;
+            }
+            epochRetries_ = 0;
+            status = ack.argument;
+            return true;
+        }
+        return false;
+    }
+
+    const uint8_t *key() const { return key_; }
+    uint32_t sender() const { return sender_; }
+    uint32_t epoch() const { return epoch_; }
+    uint32_t sequence() const { return sequence_; }
+
+private:
+    uint8_t key_[16];
+    sockaddr_in device_;
+    int sock_;
+    uint32_t sender_;
+    uint32_t epoch_ = 0;
+    uint32_t sequence_ = 0;
+    int epochRetries_ = 0;
+};
+
+
+const char *status_name(int status) {
+    switch (status) {
+        case UDP_STATUS_OK: return "ok";
+        case UDP_STATUS_BUSY: return "busy";
+        case UDP_STATUS_INVALID: return "invalid";
+        case UDP_STATUS_STALE: return "stale";
+        case UDP_STATUS_EPOCH: return "epoch";
+        default: return "unknown";
+    }
+}
+
+
+/*
+ * =======================================================
+ * Loopback Harness
+ * =======================================================
+ */
+
+std::atomic<int> fakeRelayRuns(0);
+std::mt19937 fakeRandom(1234);
+
+uint32_t fake_epoch_source() {
+    return fakeRandom();
+}
+
+int fake_execute(int type, int argument) {
+    if (type == UDP_CMD_PING) return UDP_STATUS_OK;
+    if (type == UDP_CMD_CLICK && argument > 6000) return UDP_STATUS_INVALID;
+    fakeRelayRuns++;
+    return UDP_STATUS_OK;
+}
+
+int checksFailed = 0;
+
+void check(bool ok, const char *what) {
+    printf("%s  %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) checksFailed++;
+}
+
+int run_loopback() {
+    // SipHash-2-4 reference vector: key 00..0f, message 00..0e
+    uint8_t vectorKey[16];
+    uint8_t message[15];
+    for (int i = 0; i < 16; i++) vectorKey[i] = i;
+    for (int i = 0; i < 15; i++) message[i] = i;
+    check(udp_siphash24(vectorKey, message, sizeof(message)) == 0xa129ca6149be45e5ULL, "siphash reference vector");
+
+    uint8_t key[16];
+    udp_parse_key("000102030405060708090a0b0c0d0e0f", key);
+    UdpServer server;
+    udp_server_init(server, key, fake_epoch_source, fake_execute);
+
+    int deviceSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in device;
+    memset(&device, 0, sizeof(device));
+    device.sin_family = AF_INET;
+    device.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    device.sin_port = 0;
+    bind(deviceSock, (sockaddr *)&device, sizeof(device));
+    socklen_t deviceLength = sizeof(device);
+    getsockname(deviceSock, (sockaddr *)&device, &deviceLength);
+    timeval tick = { 0, 50 * 1000 };
+    setsockopt(deviceSock, SOL_SOCKET, SO_RCVTIMEO, &tick, sizeof(tick));
+
+    // the "device", same handler as the firmware task
+    std::atomic<bool> running(true);
+    std::atomic<bool> rebootRequest(false);
+    std::thread deviceThread([&]() {
+        uint8_t in[UDP_PACKET_BYTES + 1];
+        uint8_t ack[UDP_PACKET_BYTES];
+        while (running) {
+            if (rebootRequest.exchange(false)) {
+                udp_server_new_epoch(server);
+            }
+            sockaddr_in source;
+            socklen_t sourceLength = sizeof(source);
+            ssize_t length = recvfrom(deviceSock, in, sizeof(in), 0, (sockaddr *)&source, &sourceLength);
+            if (length <= 0) continue;
+            size_t ackLength = udp_server_handle(server, in, length, ack);
+            if (ackLength > 0) sendto(deviceSock, ack, ackLength, 0, (sockaddr *)&source, sourceLength);
+        }
+    });
+
+    UdpClient client(key, device);
+    int status = -1;
+    double rtt = 0;
+
+    check(client.command(UDP_CMD_PING, 0, status, rtt) && status == UDP_STATUS_OK && client.epoch() == server.epoch,
+          "first contact learns the epoch");
+    check(client.command(UDP_CMD_CLICK, 100, status, rtt) && status == UDP_STATUS_OK && fakeRelayRuns == 1,
+          "click runs once and is acknowledged");
+    printf("      round trip %.3f ms\n", rtt);
+
+    // resend of the last click, as after a lost ack
+    UdpPacket request;
+    request.type = UDP_CMD_CLICK;
+    request.epoch = client.epoch();
+    request.sender = client.sender();
+    request.sequence = client.sequence();
+    request.argument = 100;
+    uint8_t packet[UDP_PACKET_BYTES];
+    udp_encode(key, request, packet);
+    UdpPacket ack;
+    check(client.exchange(packet, ack) && ack.argument == UDP_STATUS_OK && fakeRelayRuns == 1 && server.resent == 1,
+          "resent click gets the stored ack without running again");
+
+    // tampered packet
+    packet[16] ^= 1;
+    check(!client.exchange(packet, ack) && server.dropped == 1, "packet with a wrong MAC is dropped");
+
+    // sequence number behind the window
+    for (int i = 0; i < UDP_WINDOW + 1; i++) client.command(UDP_CMD_PING, 0, status, rtt);
+    request.sequence = client.sequence() - UDP_WINDOW - 1;
+    udp_encode(key, request, packet);
+    check(client.exchange(packet, ack) && ack.argument == UDP_STATUS_STALE && fakeRelayRuns == 1,
+          "old sequence number is refused");
+
+    // packet recorded before a reboot
+    request.sequence = client.sequence() + 1;
+    udp_encode(key, request, packet);
+    rebootRequest = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    check(client.exchange(packet, ack) && ack.argument == UDP_STATUS_EPOCH && fakeRelayRuns == 1,
+          "packet from an earlier epoch is refused");
+    check(client.command(UDP_CMD_PRESS, 0, status, rtt) && status == UDP_STATUS_OK && fakeRelayRuns == 2,
+          "client follows the new epoch");
+
+    // more senders than the device tracks
+    uint32_t before = server.epoch;
+    bool allOk = true;
+    for (int i = 0; i < UDP_SENDERS; i++) {
+        UdpClient other(key, device);
+        allOk = other.command(UDP_CMD_PING, 0, status, rtt) && status == UDP_STATUS_OK && allOk;
+    }
+    check(allOk && server.epoch != before, "a sender beyond the table starts a new epoch");
+    check(client.command(UDP_CMD_RELEASE, 0, status, rtt) && status == UDP_STATUS_OK && fakeRelayRuns == 3,
+          "existing client recovers after the epoch change");
+
+    running = false;
+    deviceThread.join();
+    close(deviceSock);
+    printf("%s\n", checksFailed == 0 ? "all checks passed" : "CHECKS FAILED");
+    return checksFailed == 0 ? 0 : 1;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "--loopback") == 0) {
+        return run_loopback();
+    }
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s <host> <key> click <ms>|press|release|ping [port]\n"
+                        "       %s --loopback\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    uint8_t key[16];
+    if (!udp_parse_key(argv[2], key)) {
+        fprintf(stderr, "key must be 32 hex digits\n");
+        return 2;
+    }
+    int type;
+    int argument = 0;
+    int next = 4;
+    if (strcmp(argv[3], "click") == 0 && argc > 4) {
+        type = UDP_CMD_CLICK;
+        argument = atoi(argv[4]);
+        next = 5;
+    } else if (strcmp(argv[3], "press") == 0) {
+        type = UDP_CMD_PRESS;
+    } else if (strcmp(argv[3], "release") == 0) {
+        type = UDP_CMD_RELEASE;
+    } else if (strcmp(argv[3], "ping") == 0) {
+        type = UDP_CMD_PING;
+    } else {
+        fprintf(stderr, "unknown command %s\n", argv[3]);
+        return 2;
+    }
+    int port = argc > next ? atoi(argv[next]) : DEFAULT_PORT;
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *found = NULL;
+    if (getaddrinfo(argv[1], NULL, &hints, &found) != 0 || found == NULL) {
+        fprintf(stderr, "cannot resolve %s\n", argv[1]);
+        return 2;
+    }
+    sockaddr_in device = *(sockaddr_in *)found->ai_addr;
+    device.sin_port = htons(port);
+    freeaddrinfo(found);
+
+    UdpClient client(key, device);
+    int status;
+    double rtt;
+    if (!client.command(type, argument, status, rtt)) {
+        fprintf(stderr, "no answer from %s:%d\n", argv[1], port);
+        return 1;
+    }
+    printf("%s (%.2f ms)\n", status_name(status), rtt);
+    return status == UDP_STATUS_OK ? 0 : 1;
+}
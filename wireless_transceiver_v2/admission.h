@@ -0,0 +1,169 @@
+// ==================================================================
+// Code containing admission control for the /control/* endpoints
+// ==================================================================
+// Every control request has to take a token from two buckets: its
+// client's (by remote IP) and the global one. An empty bucket answers
+// 429 right away, so a flood of requests costs a table lookup each and
+// never reaches the relay or the LED queue.
+// Requests may carry an idempotency key (header "Idempotency-Key" or
+// url parameter "key"). The answer to a key is kept for a while, and a
+// retry from the same client with the same key gets that answer again
+// without running twice.
+
+// Token buckets: sustained requests per second and burst size
+#define ADMISSION_GLOBAL_RATE 10
+#define ADMISSION_GLOBAL_BURST 20
+#define ADMISSION_CLIENT_RATE 4
+#define ADMISSION_CLIENT_BURST 8
+// Clients tracked at once, the least recently seen one is replaced
+#define ADMISSION_CLIENTS 8
+
+// Idempotency keys remembered, and for how long (ms)
+#define ADMISSION_KEYS 16
+#define ADMISSION_KEY_TTL 60000
+
+// admission_take() results
+#define ADMISSION_OK 0
+#define ADMISSION_CLIENT_LIMIT 1
+#define ADMISSION_GLOBAL_LIMIT 2
+
+// Bucket contents in thousandths of a token
+struct AdmissionBucket {
+    uint32_t milliTokens;
+    uint32_t refilledAt;    // millis() of the last refill
+};
+
+struct AdmissionClient {
+    uint32_t ip;            // 0 if the slot is free
+    AdmissionBucket bucket;
+};
+
+// Answer stored for an idempotency key
+struct AdmissionKey {
+    uint32_t hash;          // 0 if the slot is free
+    uint32_t storedAt;      // millis()
+    int status;
+    const char *body;       // static string
+};
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+AdmissionBucket admissionGlobal = { ADMISSION_GLOBAL_BURST * 1000, 0 };
+AdmissionClient admissionClients[ADMISSION_CLIENTS];
+AdmissionKey admissionKeys[ADMISSION_KEYS];
+int admissionNextKey = 0;
+portMUX_TYPE admissionMux = portMUX_INITIALIZER_UNLOCKED;
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+// Add the tokens earned since the last refill, at rate per second up to burst
+void admission_refill(AdmissionBucket &bucket, uint32_t now, uint32_t rate, uint32_t burst) {
+    uint32_t elapsed = now - bucket.refilledAt;
+    bucket.refilledAt = now;
+    // elapsed * rate stays well inside 32 bits for any sane gap, clamp long ones
+    uint32_t earned = (elapsed > burst * 1000) ? burst * 1000 : elapsed * rate;
+    bucket.milliTokens = min(bucket.milliTokens + earned, burst * 1000);
+}
+
+// Take a token for a request from ip
+// return ADMISSION_OK, or which limit refused it (nothing is taken then)
+int admission_take(uint32_t ip) {
+    uint32_t now = millis();
+    int result = ADMISSION_OK;
+
+    portENTER_CRITICAL(&admissionMux);
+    AdmissionClient *client = NULL;
+    AdmissionClient *oldest = &admissionClients[0];
+    for (int i = 0; i < ADMISSION_CLIENTS; i++) {
+        if (admissionClients[i].ip == ip) client = &admissionClients[i];
+        if (admissionClients[i].ip == 0 ||
+            (oldest->ip != 0 && (int32_t)(admissionClients[i].bucket.refilledAt - oldest->bucket.refilledAt) < 0)) {
+            oldest = &admissionClients[i];
+        }
+    }
+    if (client == NULL) {
+        // new client starts with a full bucket
+        client = oldest;
+        client->ip = ip;
+        client->bucket.milliTokens = ADMISSION_CLIENT_BURST * 1000;
+        client->bucket.refilledAt = now;
+    }
+    admission_refill(client->bucket, now, ADMISSION_CLIENT_RATE, ADMISSION_CLIENT_BURST);
+    admission_refill(admissionGlobal, now, ADMISSION_GLOBAL_RATE, ADMISSION_GLOBAL_BURST);
+    if (client->bucket.milliTokens < 1000) {
+        result = ADMISSION_CLIENT_LIMIT;
+    } else if (admissionGlobal.milliTokens < 1000) {
+        result = ADMISSION_GLOBAL_LIMIT;
+    } else {
+        client->bucket.milliTokens -= 1000;
+        admissionGlobal.milliTokens -= 1000;
+    }
+    portEXIT_CRITICAL(&admissionMux);
+
+    if (result == ADMISSION_CLIENT_LIMIT) metrics_increment(metricsAdmissionRejectedClient);
+    if (result == ADMISSION_GLOBAL_LIMIT) metrics_increment(metricsAdmissionRejectedGlobal);
+    return result;
+}
+
+// FNV-1a hash of an idempotency key together with the client and the endpoint
+// it was used on, so clients that happen to pick the same key (e.g. a counter
+// restarting at 1 after a page reload) do not get each other's answers
+// return 0 for an empty key (no key given)
+uint32_t admission_key_hash(uint32_t ip, const char *path, const char *key) {
+    if (key[0] == '\0') {
+        return 0;
+    }
+    uint32_t hash = 2166136261UL;
+    for (int i = 0; i < 4; i++) hash = (hash ^ ((ip >> (8 * i)) & 0xff)) * 16777619UL;
+    for (const char *c = path; *c; c++) hash = (hash ^ (uint8_t)*c) * 16777619UL;
+    hash = (hash ^ ' ') * 16777619UL;
+    for (const char *c = key; *c; c++) hash = (hash ^ (uint8_t)*c) * 16777619UL;
+    return hash == 0 ? 1 : hash;
+}
+
+// Look up the stored answer for a key hash
+// return false if there is none (or it expired)
+bool admission_key_find(uint32_t hash, int &status, const char *&body) {
+    if (hash == 0) {
+        return false;
+    }
+    uint32_t now = millis();
+    bool found = false;
+    portENTER_CRITICAL(&admissionMux);
+    for (int i = 0; i < ADMISSION_KEYS; i++) {
+        if (admissionKeys[i].hash == hash && now - admissionKeys[i].storedAt < ADMISSION_KEY_TTL) {
+            status = admissionKeys[i].status;
+            body = admissionKeys[i].body;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&admissionMux);
+    if (found) metrics_increment(metricsAdmissionReplays);
+    return found;
+}
+
+// Remember the answer given to a key, the oldest stored key is replaced
+void admission_key_store(uint32_t hash, int status, const char *body) {
+    if (hash == 0) {
+        return;
+    }
+    portENTER_CRITICAL(&admissionMux);
+    AdmissionKey &slot = admissionKeys[admissionNextKey];
+    admissionNextKey = (admissionNextKey + 1) % ADMISSION_KEYS;
+    slot.hash = hash;
+    slot.storedAt = millis();
+    slot.status = status;
+    slot.body = body;
+    portEXIT_CRITICAL(&admissionMux);
+}
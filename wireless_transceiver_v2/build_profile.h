@@ -0,0 +1,40 @@
+// ==================================================================
+// Build profile: features and LED patterns compiled into the firmware
+// ==================================================================
+// Every switch is a constexpr bool. A feature that is off has its routes,
+// tasks and init calls skipped behind `if (build...)`, which the compiler
+// folds away, so its handlers and data are never referenced and the
+// linker drops them (the ESP32 core links with --gc-sections). A built-in
+// LED pattern that is off is left out of the pattern lookup
+// (led_patterns.h) and its program is not emitted at all.
+// Nothing here costs anything at runtime.
+// tools/size_report/size_report.py builds the sketch once per switch
+// turned off and prints what each one costs in flash and static RAM.
+
+// Features
+constexpr bool buildControlPage = true;     // control page at / (index_html.h)
+constexpr bool buildWebSocket = true;       // WebSocket commands at /ws, used by the control page
+constexpr bool buildUdpControl = true;      // signed UDP commands (udp_task.h)
+constexpr bool buildSequence = true;        // /control/sequence timelines on the hardware timer
+constexpr bool buildLedUploads = true;      // /led/pattern uploads kept in NVS (~2 KB RAM)
+constexpr bool buildMetrics = true;         // Prometheus text at /metrics
+constexpr bool buildOta = true;             // /update and rollback of new images (ota_update.h)
+constexpr bool buildWifiEnterprise = true;  // WPA2 Enterprise (eduroam) connect path
+
+// Built-in LED patterns (codes in led_task.h)
+// A pattern that is off shows nothing unless a program for its code is
+// uploaded through /led/pattern.
+// Sent by the firmware itself:
+constexpr bool buildLedFadeIn = true;
+constexpr bool buildLedLoading = true;
+constexpr bool buildLedLoadIn = true;
+constexpr bool buildLedLoadOut = true;
+constexpr bool buildLedBreathe = true;
+constexpr bool buildLedCircleIn = true;
+constexpr bool buildLedPersistStatus2 = true;
+// Not sent by the firmware:
+constexpr bool buildLedOff = false;
+constexpr bool buildLedLoadingLong = false;
+constexpr bool buildLedFlash = false;
+constexpr bool buildLedFlashFast = false;
+constexpr bool buildLedPersistStatus1 = false;
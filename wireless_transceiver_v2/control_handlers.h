@@ -0,0 +1,261 @@
+// ==================================================================
+// Code containing the HTTP handlers for the control page and /control/*
+// ==================================================================
+// Kept apart from the sketch so the same handlers can also be built on
+// a host behind a server shim (tools/loadtest) and measured under load.
+// The /control/sequence handler stays in the sketch, it needs the
+// hardware timer.
+
+
+// Longest round trip a client may report (us), longer reports are ignored
+#define CONTROL_ROUND_TRIP_MAX 10000000
+
+
+/*
+ * =======================================================
+ * Admission
+ * =======================================================
+ */
+
+// Record the round trip a client measured for its previous command (us)
+// the control page sends it as "rtt_us" with the next command
+void control_observe_round_trip(MetricsHistogram &histogram, long micros) {
+    if (micros > 0 && micros <= CONTROL_ROUND_TRIP_MAX) {
+        metrics_observe(histogram, micros);
+    }
+}
+
+// Admission for one control command from ip, shared by HTTP and WebSocket
+// keyHash: the command's idempotency key hash (0 without a key)
+// return true if the command is already answered, status and body then hold
+// the answer: the stored one for a retried key, or 429
+bool control_admit_command(uint32_t ip, uint32_t keyHash, int &status, const char *&body) {
+    if (admission_key_find(keyHash, status, body)) {
+        return true;
+    }
+    if (admission_take(ip) != ADMISSION_OK) {
+        status = 429;
+        body = "TOO MANY REQUESTS";
+        return true;
+    }
+    return false;
+}
+
+// Count a control command's answer and keep it for its idempotency key
+void control_record(uint32_t keyHash, int status, const char *body) {
+    if (status == 409) metrics_increment(metricsAdmissionConflicts);
+    admission_key_store(keyHash, status, body);
+}
+
+// Admission for /control/* requests, see admission.h
+// keyHash: set to the request's idempotency key hash (0 without a key)
+// return true if the request is already answered: a retry of a stored key, or 429
+bool control_admit(AsyncWebServerRequest *request, uint32_t &keyHash) {
+    String key;
+    if (request->hasHeader("Idempotency-Key")) {
+        key = request->getHeader("Idempotency-Key")->value();
+    } else if (request->hasParam("key")) {
+        key = request->getParam("key")->value();
+    }
+    if (request->hasParam("rtt_us")) {
+        control_observe_round_trip(metricsControlRoundTripHttp, request->getParam("rtt_us")->value().toInt());
+    }
+    uint32_t ip = request->client()->remoteIP();
+    keyHash = admission_key_hash(ip, request->url().c_str(), key.c_str());
+
+    int status;
+    const char *body;
+    if (!control_admit_command(ip, keyHash, status, body)) {
+        return false;
+    }
+    AsyncWebServerResponse *response = request->beginResponse_P(status, "text/plain", body);
+    if (status == 429) response->addHeader("Retry-After", "1");
+    request->send(response);
+    return true;
+}
+
+// Answer a /control/* request and keep the answer for its idempotency key
+void control_reply(AsyncWebServerRequest *request, uint32_t keyHash, int status, const char *body) {
+    control_record(keyHash, status, body);
+    request->send_P(status, "text/plain", body);
+}
+
+
+/*
+ * =======================================================
+ * Callback Functions
+ * =======================================================
+ */
+
+void handleRoot(AsyncWebServerRequest *request) {
+    TRACE_SCOPE("http root");
+    // Browser already holds this build of the page
+    if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == INDEX_HTML_ETAG) {
+        AsyncWebServerResponse *response = request->beginResponse(304);
+        response->addHeader("ETag", INDEX_HTML_ETAG);
+        request->send(response);
+        return;
+    }
+    // Page is stored gzipped, see wireless_transceiver_webpage_v2/build_index_html.py
+    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", INDEX_HTML_GZ, INDEX_HTML_GZ_LEN);
+    response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("ETag", INDEX_HTML_ETAG);
+    // revalidate on every load, the ETag changes with each firmware build of the page
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+// Pulse the relays of the channels in the mask
+// url parameter "interval": pulse width in ms (0-6000)
+void control_click(AsyncWebServerRequest *request, uint32_t channels) {
+    TRACE_SCOPE("http click");
+    uint32_t keyHash;
+    if (control_admit(request, keyHash)) {
+        return;
+    }
+    int paramValue = 0; // url parameter named "interval" ranging between 0 to 6000ms
+    if (request->hasParam("interval") ) {
+        paramValue = request->getParam("interval")->value().toInt();
+        LOG_DEBUG("handleClick: interval %d", paramValue);
+    }else{
+        LOG_ERROR("handleClick: no url Param - interval");
+        control_reply(request, keyHash, 400, "MISSING INTERVAL");
+        return;
+    }
+    
+    if (paramValue > RELAY_PULSE_MAX_MS || paramValue < 0) {
+        LOG_ERROR("handleClick: invalid parameter range (0-6000ms)");
+        control_reply(request, keyHash, 400, "INVALID INTERVAL");
+        return;
+    }
+    
+    // Engage Switch for defined periods
+    // the pulse is ended (and its animations shown) by the relay timer
+    if (relay_pulse(channels, paramValue) == RELAY_PULSE_BUSY) {
+        control_reply(request, keyHash, 409, "BUSY");
+        return;
+    }
+
+    // Acknowledge with 200 response
+    control_reply(request, keyHash, 200, "OK");
+}
+
+// Engage the relays of the channels in the mask until deactivated, from any state
+// cancels pending clicks and a running sequence; already held is a no-op
+void control_activate(AsyncWebServerRequest *request, uint32_t channels) {
+    TRACE_SCOPE("http activate");
+    uint32_t keyHash;
+    if (control_admit(request, keyHash)) {
+        return;
+    }
+    // Engage Switch (and display animation)
+    relay_hold(channels);
+    // Acknowledge with 200 response
+    control_reply(request, keyHash, 200, "OK");
+}
+
+// Release the relays of the channels in the mask from any state, cancels
+// pending clicks and a running sequence; already idle is a no-op
+void control_deactivate(AsyncWebServerRequest *request, uint32_t channels) {
+    TRACE_SCOPE("http deactivate");
+    uint32_t keyHash;
+    if (control_admit(request, keyHash)) {
+        return;
+    }
+    // Disengage Switch (and display animation)
+    relay_release(channels);
+    // Acknowledge with 200 response
+    control_reply(request, keyHash, 200, "OK");
+}
+
+// /control/click, /control/activate and /control/deactivate drive channel 0
+void handleClick (AsyncWebServerRequest *request) {
+    control_click(request, RELAY_CHANNEL(0));
+}
+
+void handleActivation (AsyncWebServerRequest *request) {
+    control_activate(request, RELAY_CHANNEL(0));
+}
+
+void handleDeactivation (AsyncWebServerRequest *request) {
+    control_deactivate(request, RELAY_CHANNEL(0));
+}
+
+
+/*
+ * =======================================================
+ * Channel Routes
+ * =======================================================
+ * /control/{ch}/click, /control/{ch}/activate and /control/{ch}/deactivate,
+ * ch being a channel number, a comma separated list ("0,2") or "all".
+ * Channels in one request switch together, see relay_task.h.
+ */
+
+// Channel mask of the {ch} path segment, 0 if malformed or a channel does not exist
+uint32_t control_parse_channels(const char *text, int length) {
+    if (length == 3 && strncmp(text, "all", 3) == 0) {
+        return RELAY_ALL_CHANNELS;
+    }
+    uint32_t channels = 0;
+    int channel = -1;
+    for (int i = 0; i <= length; i++) {
+        if (i < length && text[i] >= '0' && text[i] <= '9') {
+            channel = (channel < 0 ? 0 : channel * 10) + (text[i] - '0');
+            if (channel >= RELAY_CHANNELS) return 0;
+        } else if ((i == length || text[i] == ',') && channel >= 0) {
+            channels |= RELAY_CHANNEL(channel);
+            channel = -1;
+        } else {
+            return 0;
+        }
+    }
+    return channels;
+}
+
+// Handler of one /control/{ch}/{action} action
+typedef void (*ControlAction)(AsyncWebServerRequest *request, uint32_t channels);
+
+// Split a /control/{ch}/{action} path
+// return the handler for the action, NULL if the path is not one
+ControlAction control_parse_path(const String &url, uint32_t &channels) {
+    const char *path = url.c_str();
+    if (strncmp(path, "/control/", 9) != 0) {
+        return NULL;
+    }
+    const char *segment = path + 9;
+    const char *slash = strchr(segment, '/');
+    if (slash == NULL) {
+        return NULL;
+    }
+    channels = control_parse_channels(segment, slash - segment);
+    if (channels == 0) {
+        return NULL;
+    }
+    const char *action = slash + 1;
+    if (strcmp(action, "click") == 0) return control_click;
+    if (strcmp(action, "activate") == 0) return control_activate;
+    if (strcmp(action, "deactivate") == 0) return control_deactivate;
+    return NULL;
+}
+
+// One handler for every /control/{ch}/... route, added with server.addHandler()
+class ControlChannelHandler : public AsyncWebHandler {
+public:
+    bool canHandle(AsyncWebServerRequest *request) override {
+        uint32_t channels;
+        if (control_parse_path(request->url(), channels) == NULL) {
+            return false;
+        }
+        // keep Idempotency-Key, the server drops headers nobody asked for
+        request->addInterestingHeader("ANY");
+        return true;
+    }
+
+    void handleRequest(AsyncWebServerRequest *request) override {
+        uint32_t channels;
+        ControlAction action = control_parse_path(request->url(), channels);
+        if (action != NULL) {
+            action(request, channels);
+        }
+    }
+};
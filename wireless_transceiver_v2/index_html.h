@@ -1,135 +1,123 @@
-// PROGMEM: Store data in flash (program) memory instead of SRAM, 
+// Generated by wireless_transceiver_webpage_v2/build_index_html.py, do not edit.
+// Source: wireless_transceiver_webpage_v2/index.html
+// 7445 bytes of html, 1807 bytes gzipped
+// PROGMEM: Store data in flash (program) memory instead of SRAM
 
-const char INDEX_HTML[] PROGMEM = R"=====(
-<!DOCTYPE HTML>
-<html>
-    <head>
-        <Title>Accessible Wireless Switch</Title>
-        <meta name="viewport" content="width=device-width, initial-scale=1">
-        <link rel="icon" href="data:,">
-        <style>
-            html {
-                font-family: Arial, Helvetica, sans-serif;
-                text-align: center;
-            }
-            h1 {
-              font-size: 1.8rem;
-              color: white;
-            }
-            h2{
-              font-size: 1.5rem;
-              font-weight: bold;
-              color: #DE8344;
-            }
-            .topnav {
-                overflow: hidden;
-                background-color: #333333;
-            }
-            body {
-                margin: 0;
-            }
-            .content {
-                padding: 30px;
-                max-width: 600px;
-                margin: 0 auto;
-            }
-            .card {
-                background-color: #F8F7F9;;
-                box-shadow: 2px 2px 12px 1px rgba(140, 140, 140, .5);
-                padding-top: 10px;
-                padding-bottom: 20px;
-                border-radius: 30px;
-            }
-            .button {
-                padding: 15px 50px;
-                font-size: 24px;
-                text-align: center;
-                outline: none;
-                color: #fff;
-                background-color: #DE8344;
-                border: none;
-                border-radius: 15px;
-                -webkit-touch-callout: none;
-                -webkit-user-select: none;
-                -khtml-user-select: none;
-                -moz-user-select: none;
-                -ms-user-select: none;
-                user-select: none;
-                -webkit-tap-highlight-color: rgba(0,0,0,0);
-            }
-            .button:active {
-                background-color: #DEA27E;
-                box-shadow: 2 2px #CDCDCD;
-                transform: translateY(2px);
-            }
-            .state {
-                font-size: 1.5rem;
-                color: #8c8c8c;
-                font-weight: bold
-            }
-        </style>
-    </head>
-        
-    <body>
-        <!-- Div for the top title bar -->
-        <div class="topnav">
-            <h1>Accessible Wireless Switch<h1>
-        </div>
-        <div style="background: #DE9558; height: 10px;"></div>
-        <!-- Div for the body of the page -->
-        <div class="content">
-            <div class="card">
-                <p class="state">
-                    This page is for settings and configurations.
-                </p>
-            </div>
-            <br>
-            <br>
-            <div class="card">
-                <h2>Switch Control</h2>
-                <p class="state">Click here to activate switch once:</p>
-                
-                <p>
-                    <button id="button_ACT" class="button">Activate Switch</button>
-                </p>
+#define INDEX_HTML_ETAG "\"c15ea5a51e1c6ec3\""
 
-            </div>
-            <br>
-            <br>
-            <div class="card">
-                <h2>Device Documentations</h2>
-                <p class="state">Get help here</p>
-                
-                
-                <button id="button_help" class="button" onclick="window.location.href='https://drive.google.com/drive/folders/1nD83zP2qYV-7mvF2n2yecVb5Hgfm7Zpj?usp=share_link';">
-                    User Manual
-                </button>
-                <br>
-                <br>
-                <button id="button_help" class="button" onclick="window.location.href='https://github.com/EvanZhou1999/Accessible_wireless_transceiver';">
-                    Source Code
-                </button>
-                
-
-            </div>
-            
-        </div>
-        
-        <script>
-            document.getElementById('button_ACT').addEventListener('click', switchClick);
-            
-            function switchClick() {
-                // Send request
-                var xhttp = new XMLHttpRequest();
-                xhttp.onreadystatechange = function() {};
-                const path = "control/click?interval=500"; // Engage switch for 0.5 seconds
-                xhttp.open("GET", path, true);
-                xhttp.send();
-              }
-
-        </script>
-    </body>
-</html>
-
-
-)=====";
+const size_t INDEX_HTML_GZ_LEN = 1807;
+const uint8_t INDEX_HTML_GZ[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xad, 0x58, 0x7b, 0x6f, 0xdb, 0x36,
+    0x10, 0xff, 0xdf, 0x9f, 0x82, 0x53, 0x81, 0x5a, 0x5e, 0x6d, 0xf9, 0xd1, 0x64, 0x4d, 0xec, 0x28,
+    0x45, 0x97, 0x38, 0xcb, 0x80, 0x76, 0x0d, 0x5a, 0xaf, 0x5b, 0x57, 0x04, 0x01, 0x2d, 0xd1, 0x16,
+    0x17, 0x89, 0xd4, 0x48, 0xca, 0x4e, 0xda, 0xe5, 0xbb, 0xef, 0xee, 0x24, 0xd9, 0x4e, 0xa2, 0xee,
+    0x01, 0x2c, 0x46, 0x2c, 0xf1, 0x78, 0x77, 0xbc, 0xfb, 0xdd, 0x8b, 0xc9, 0xd1, 0x37, 0xa7, 0x6f,
+    0x4f, 0x66, 0x1f, 0x2f, 0xa6, 0xec, 0x7c, 0xf6, 0xe6, 0xf5, 0x71, 0xeb, 0x28, 0x71, 0x59, 0x8a,
+    0x0f, 0xc1, 0x63, 0x78, 0xcc, 0xa4, 0x4b, 0xc5, 0xf1, 0xab, 0x28, 0x12, 0xd6, 0xca, 0x79, 0x2a,
+    0xd8, 0x2f, 0xd2, 0x88, 0x14, 0x16, 0xec, 0xfd, 0x5a, 0xba, 0x28, 0x39, 0xea, 0x97, 0x1c, 0xad,
+    0xa3, 0x4c, 0x38, 0xce, 0x14, 0xcf, 0x44, 0xe8, 0xad, 0xa4, 0x58, 0xe7, 0xda, 0x38, 0x8f, 0x45,
+    0x5a, 0x39, 0xa1, 0x5c, 0xe8, 0xad, 0x65, 0xec, 0x92, 0x30, 0x16, 0x2b, 0x19, 0x89, 0x1e, 0x2d,
+    0xba, 0x4c, 0x2a, 0xe9, 0x24, 0x4f, 0x7b, 0x36, 0xe2, 0xa9, 0x08, 0x87, 0x1e, 0x28, 0x49, 0xa5,
+    0xba, 0x66, 0x70, 0x40, 0xe8, 0x49, 0x10, 0xf5, 0x58, 0x62, 0xc4, 0x22, 0xf4, 0x62, 0xee, 0xf8,
+    0xb8, 0x8b, 0xfb, 0xd6, 0xdd, 0xe2, 0x61, 0x68, 0x23, 0xfb, 0xd2, 0x5a, 0x80, 0xf6, 0xde, 0x82,
+    0x67, 0x32, 0xbd, 0x1d, 0xb3, 0x57, 0x06, 0x74, 0x75, 0xd9, 0xb9, 0x48, 0x57, 0xc2, 0xc9, 0x88,
+    0x77, 0x99, 0xe5, 0xca, 0xf6, 0xac, 0x30, 0x72, 0x31, 0x69, 0x39, 0x71, 0xe3, 0x7a, 0x3c, 0x95,
+    0x4b, 0x35, 0x66, 0x11, 0x58, 0x24, 0xcc, 0xa4, 0x75, 0xd7, 0x4a, 0x86, 0xb5, 0x16, 0x2b, 0x3f,
+    0x8b, 0x31, 0x1b, 0x06, 0x07, 0x46, 0x64, 0x93, 0x56, 0xa4, 0x53, 0x6d, 0xc6, 0x6c, 0x9d, 0x48,
+    0x27, 0x88, 0x6f, 0xf4, 0x80, 0x6d, 0x9f, 0xd8, 0x88, 0xb4, 0x16, 0x72, 0x99, 0xb8, 0x31, 0x9b,
+    0xeb, 0x34, 0xde, 0x48, 0x3e, 0x39, 0x9d, 0x1e, 0x3c, 0xdf, 0xdb, 0x43, 0xd9, 0xc0, 0xe9, 0x5c,
+    0xf1, 0x15, 0x1c, 0xa4, 0x57, 0xc2, 0x2c, 0x52, 0xbd, 0x1e, 0xb3, 0x44, 0xc6, 0xb1, 0x50, 0x93,
+    0xd6, 0x9c, 0x47, 0xd7, 0x4b, 0xa3, 0x0b, 0x15, 0xf7, 0x6a, 0xc1, 0xe7, 0xf4, 0x83, 0x82, 0x73,
+    0x1d, 0xdf, 0x82, 0x54, 0xc6, 0xcd, 0x52, 0x82, 0xd5, 0x03, 0x52, 0x56, 0x01, 0x0a, 0xf4, 0x9c,
+    0xc7, 0xb1, 0x54, 0xcb, 0x31, 0x7b, 0x3e, 0xc8, 0x6f, 0x26, 0xc0, 0x76, 0x53, 0xe2, 0x3a, 0x66,
+    0xdf, 0x0d, 0x2a, 0x4a, 0x25, 0xc8, 0x78, 0xe1, 0x74, 0x29, 0xcd, 0x4d, 0x0c, 0xa2, 0x0d, 0xc7,
+    0x9e, 0x1d, 0x9c, 0xbd, 0x38, 0x3b, 0x9c, 0x80, 0x49, 0xfa, 0xa6, 0x67, 0x13, 0x1e, 0xa3, 0x99,
+    0xa3, 0xfc, 0x86, 0x7e, 0x87, 0xf4, 0x05, 0xbf, 0x66, 0x39, 0xe7, 0xfe, 0x70, 0x6f, 0xd0, 0x65,
+    0xdb, 0xaf, 0x60, 0xbf, 0x33, 0xa9, 0x8d, 0xe9, 0x81, 0xaf, 0x00, 0x0f, 0x1d, 0x5f, 0x93, 0xe6,
+    0xda, 0x39, 0x9d, 0x81, 0x32, 0xa2, 0xce, 0xb5, 0x89, 0x85, 0xe9, 0x19, 0x1e, 0xcb, 0xc2, 0xd6,
+    0xb6, 0x83, 0x65, 0xf3, 0x02, 0xb8, 0xd4, 0xae, 0x5b, 0xc3, 0x7d, 0x38, 0x70, 0x9f, 0xf6, 0x77,
+    0xa0, 0x1f, 0xed, 0x21, 0xa1, 0x29, 0x9a, 0xba, 0x70, 0x90, 0x3d, 0xc0, 0xa2, 0xb4, 0x12, 0xdb,
+    0x40, 0x2c, 0x16, 0x8b, 0x46, 0x9c, 0xeb, 0x00, 0x95, 0x06, 0xd5, 0x52, 0x0f, 0xcc, 0x43, 0x1b,
+    0x26, 0x2d, 0x08, 0xf1, 0xfc, 0x5a, 0x3a, 0x70, 0xae, 0x88, 0x92, 0x1e, 0x24, 0x6b, 0x0a, 0x67,
+    0xd5, 0x12, 0xf5, 0x66, 0x01, 0x89, 0x06, 0xc9, 0x96, 0x8a, 0x68, 0xbb, 0x75, 0x8d, 0x79, 0xda,
+    0xb8, 0x93, 0xe9, 0xcf, 0xcd, 0x74, 0xdb, 0x44, 0x6e, 0xe2, 0xac, 0x6d, 0xe2, 0x79, 0x2f, 0x81,
+    0x04, 0x4c, 0x31, 0x09, 0x6b, 0xe7, 0x28, 0x4c, 0x83, 0x2e, 0x7d, 0x3a, 0x3b, 0xf0, 0x8e, 0x79,
+    0xe4, 0xe4, 0x4a, 0x34, 0x67, 0xc0, 0xe9, 0xf4, 0xd5, 0xe8, 0xc5, 0xf4, 0x41, 0x02, 0x50, 0xf8,
+    0x9f, 0x9c, 0x9c, 0xe2, 0x07, 0x60, 0x37, 0x50, 0x51, 0x0b, 0x6d, 0x20, 0x9a, 0xf4, 0x9a, 0x72,
+    0x27, 0x3e, 0xfa, 0xc0, 0x52, 0x1e, 0x62, 0x1d, 0xac, 0x59, 0x63, 0xa5, 0xd4, 0x87, 0x1c, 0x44,
+    0xf8, 0x69, 0xa8, 0x1c, 0x94, 0x47, 0x75, 0x2a, 0xba, 0xbd, 0xaf, 0x61, 0x10, 0x1c, 0x36, 0x6a,
+    0xb8, 0x6b, 0x1d, 0xf5, 0xab, 0x6e, 0x70, 0xd4, 0xaf, 0x9a, 0x15, 0x56, 0x0c, 0x3c, 0x62, 0xb9,
+    0x62, 0x51, 0xca, 0xad, 0x0d, 0xbd, 0xb2, 0xf6, 0xb0, 0x73, 0x24, 0xc3, 0xbf, 0xeb, 0x62, 0xb0,
+    0x0b, 0x6a, 0x40, 0xb0, 0x12, 0x27, 0xcd, 0xa1, 0xb7, 0x85, 0x89, 0x00, 0x3a, 0xdc, 0xdf, 0x3f,
+    0x98, 0xb0, 0xa4, 0x32, 0x9b, 0xd2, 0xdc, 0x3b, 0xde, 0x15, 0xab, 0x4e, 0xad, 0x8a, 0xd4, 0x7b,
+    0x40, 0x85, 0xe2, 0x43, 0x52, 0x5e, 0x13, 0x08, 0x2f, 0xa0, 0xcc, 0x12, 0x69, 0x59, 0xce, 0x97,
+    0x82, 0xc1, 0x13, 0xe0, 0x65, 0x56, 0x38, 0x07, 0x35, 0x60, 0x19, 0x57, 0x31, 0xb6, 0xd0, 0x85,
+    0x5c, 0x16, 0x86, 0x3b, 0xa9, 0x95, 0x0d, 0xc0, 0xcc, 0x7c, 0x6b, 0xeb, 0xdc, 0xd4, 0x5f, 0x0d,
+    0x07, 0x25, 0xa3, 0xe3, 0xd2, 0x3d, 0x76, 0x02, 0x06, 0x19, 0x9d, 0x02, 0x50, 0xa3, 0x06, 0x03,
+    0x4e, 0x52, 0x19, 0x5d, 0x83, 0x5b, 0x46, 0x30, 0xa7, 0x19, 0xe5, 0x08, 0x06, 0xd2, 0x96, 0xb2,
+    0x5a, 0x45, 0x62, 0x5c, 0x1e, 0x8a, 0xbf, 0x55, 0xa1, 0xca, 0x18, 0xd0, 0xa1, 0xd7, 0xab, 0x57,
+    0x27, 0x33, 0xaf, 0xd6, 0x58, 0x92, 0x3c, 0x80, 0xba, 0x52, 0x52, 0x4f, 0x89, 0x72, 0xe3, 0xb8,
+    0xb2, 0x3e, 0x27, 0xf9, 0x2a, 0xde, 0x1b, 0xe1, 0x7a, 0x7d, 0xfc, 0x9f, 0x5c, 0x3c, 0xa5, 0x99,
+    0xc2, 0x4e, 0x75, 0x54, 0x64, 0x00, 0x7a, 0x09, 0xd3, 0x57, 0x3c, 0xfd, 0x41, 0x38, 0xf0, 0x33,
+    0xcd, 0xc9, 0xd9, 0xf2, 0x94, 0xc7, 0xfe, 0x20, 0xc3, 0x43, 0x87, 0x10, 0x05, 0x44, 0x09, 0x07,
+    0x99, 0x82, 0xd2, 0x08, 0x52, 0x1d, 0xd1, 0x49, 0x01, 0x4d, 0xa8, 0x76, 0xe2, 0x5c, 0x6e, 0xc7,
+    0xfd, 0x7e, 0x6c, 0xa0, 0xbe, 0x82, 0xa5, 0xd6, 0xcb, 0x54, 0x40, 0xaf, 0xce, 0x4a, 0x42, 0x7f,
+    0x01, 0x19, 0x2e, 0x8c, 0xed, 0x0f, 0xd5, 0xe9, 0xc1, 0xf3, 0xcf, 0x17, 0xa3, 0x3f, 0x3e, 0x7e,
+    0xe8, 0xbd, 0xc8, 0x56, 0x67, 0x23, 0x35, 0xba, 0x15, 0xd1, 0x87, 0xf9, 0xfe, 0xf9, 0x72, 0x91,
+    0xbd, 0xf8, 0x2d, 0xff, 0xfd, 0x65, 0x61, 0xf3, 0x10, 0xaa, 0xcf, 0x88, 0x2b, 0x1c, 0x85, 0x6d,
+    0xc8, 0xaf, 0xd6, 0xcf, 0x50, 0xfd, 0xec, 0x0d, 0x57, 0x05, 0x4f, 0x5b, 0x3b, 0x40, 0x6e, 0x71,
+    0xf9, 0x7f, 0x5d, 0x58, 0x4a, 0x97, 0x14, 0x73, 0x32, 0x7e, 0xba, 0xe2, 0xea, 0xb7, 0x44, 0x17,
+    0xc3, 0xc3, 0xc3, 0xc3, 0xfe, 0xb6, 0x7a, 0xae, 0xd6, 0x55, 0xf5, 0x5c, 0x51, 0x17, 0x88, 0x04,
+    0xb8, 0x68, 0xc8, 0xd4, 0xf7, 0xba, 0x30, 0x10, 0x8b, 0x13, 0x1d, 0x8b, 0x5d, 0x53, 0xab, 0x48,
+    0x56, 0x0f, 0x1b, 0x19, 0x99, 0xbb, 0xe3, 0x56, 0x5c, 0x45, 0x2c, 0x58, 0x0a, 0x37, 0x4d, 0x05,
+    0xbe, 0x7e, 0x7f, 0xfb, 0x63, 0xec, 0xb7, 0xb7, 0x79, 0xd5, 0xee, 0x04, 0x30, 0x0e, 0xa6, 0x2b,
+    0xd8, 0x7a, 0x2d, 0x2d, 0x64, 0x87, 0x30, 0x7e, 0x9b, 0xbc, 0x68, 0x77, 0xab, 0xfc, 0xa4, 0xe4,
+    0x85, 0xfe, 0xb3, 0xe2, 0x86, 0xad, 0x2d, 0x0b, 0x99, 0x2a, 0xd2, 0xb4, 0x5e, 0xfe, 0x04, 0x73,
+    0xe2, 0xc7, 0x18, 0x88, 0xc3, 0x9a, 0x72, 0x21, 0x14, 0x8e, 0x17, 0x20, 0x7d, 0xb9, 0x9b, 0xb0,
+    0xdd, 0x9f, 0x7e, 0x1f, 0x4a, 0x2d, 0xcb, 0xb0, 0xe4, 0x64, 0xcc, 0x7a, 0xc7, 0x50, 0x85, 0xf0,
+    0xea, 0x64, 0x26, 0x48, 0x94, 0xba, 0xc0, 0x0c, 0x2c, 0x6f, 0x16, 0x25, 0x24, 0xf0, 0xce, 0x83,
+    0x92, 0x5f, 0x22, 0x60, 0x76, 0x5d, 0xa8, 0x26, 0x87, 0x57, 0x12, 0x08, 0x03, 0x2c, 0x0a, 0x65,
+    0x04, 0x32, 0x88, 0xf8, 0xae, 0xb5, 0x28, 0x54, 0x84, 0xd0, 0x83, 0x41, 0x50, 0x9a, 0x0a, 0xfa,
+    0xba, 0xdf, 0x81, 0xb6, 0x57, 0xda, 0x2f, 0xd6, 0xec, 0x17, 0x31, 0x7f, 0xaf, 0xa3, 0x6b, 0xe1,
+    0xfc, 0xf6, 0x1a, 0x63, 0xd2, 0x66, 0xcf, 0xd8, 0xa3, 0xa8, 0x69, 0xeb, 0x80, 0xdc, 0xee, 0xaf,
+    0x6d, 0x1b, 0xfc, 0x5f, 0xdb, 0x40, 0xab, 0x0c, 0x82, 0x82, 0x7d, 0x24, 0x64, 0xf5, 0x09, 0xbe,
+    0x40, 0xf0, 0x50, 0x39, 0x39, 0x21, 0xf2, 0xf4, 0x16, 0x76, 0x89, 0x18, 0xe0, 0xb5, 0x2a, 0xb0,
+    0x79, 0x2a, 0xe1, 0x18, 0x86, 0x3a, 0xe4, 0x82, 0xf9, 0xc4, 0xf2, 0x69, 0x70, 0x09, 0xb7, 0xb3,
+    0x2d, 0x5c, 0x28, 0xbf, 0xdd, 0x1c, 0x5e, 0xb2, 0x30, 0x0c, 0x59, 0x5b, 0x5f, 0xb7, 0x71, 0xc3,
+    0x88, 0x08, 0xa6, 0xe6, 0xbb, 0x1a, 0x1f, 0xbf, 0xbd, 0xb1, 0x1e, 0x82, 0x94, 0xc3, 0x95, 0x07,
+    0x06, 0x06, 0x87, 0x26, 0x12, 0x28, 0xbd, 0x06, 0x37, 0x7b, 0x5b, 0xb5, 0x9f, 0xea, 0xc3, 0x2e,
+    0x69, 0x80, 0xc4, 0x90, 0x54, 0xd0, 0x32, 0x1a, 0xb6, 0x71, 0xf7, 0xae, 0xf2, 0x31, 0x4a, 0xb5,
+    0xbd, 0xe7, 0xe1, 0x16, 0x39, 0x8a, 0xfc, 0x83, 0x18, 0xb7, 0xa0, 0x99, 0xce, 0x20, 0x88, 0x30,
+    0xb2, 0xfd, 0x0d, 0xda, 0x5d, 0xb8, 0x8d, 0x0c, 0x68, 0x34, 0xa2, 0xe6, 0x4d, 0x34, 0x1e, 0x7a,
+    0xb2, 0x09, 0x6a, 0x97, 0x65, 0x76, 0x83, 0x21, 0xe8, 0xdd, 0x24, 0xc3, 0xa7, 0x0d, 0xcb, 0x25,
+    0xfb, 0xf3, 0x4f, 0x00, 0xa8, 0x69, 0x23, 0xac, 0x12, 0x02, 0x86, 0x59, 0x95, 0x13, 0xf4, 0x86,
+    0x69, 0x41, 0x2f, 0xdb, 0xcc, 0x80, 0xe5, 0x1d, 0x58, 0x65, 0x02, 0xe2, 0x7f, 0xf6, 0x0c, 0x5f,
+    0x49, 0x80, 0x3d, 0x0b, 0xc1, 0x04, 0x5c, 0xa2, 0x14, 0xab, 0x17, 0x5b, 0x49, 0x20, 0xbd, 0xe1,
+    0x2e, 0x09, 0xc8, 0x00, 0x3f, 0xb3, 0xec, 0x5b, 0x98, 0x4f, 0xe4, 0x22, 0xda, 0x8c, 0xf7, 0x25,
+    0xe0, 0xf8, 0x74, 0x89, 0x93, 0xd7, 0x30, 0x9f, 0x68, 0x18, 0xe1, 0x8d, 0xbd, 0xb5, 0x77, 0xf6,
+    0xbe, 0x77, 0x97, 0xe5, 0x5d, 0x2b, 0xc8, 0x0b, 0x9b, 0xf8, 0x94, 0x6e, 0x63, 0x86, 0xc9, 0x68,
+    0xc9, 0x0e, 0xb0, 0xed, 0x4c, 0xde, 0x88, 0xd8, 0x1f, 0x74, 0x70, 0x0b, 0x8c, 0x62, 0x3e, 0x5f,
+    0x2d, 0x89, 0xc3, 0xb7, 0x95, 0xe5, 0x7d, 0x60, 0x26, 0x77, 0x3a, 0x0d, 0xec, 0x78, 0x25, 0xae,
+    0x14, 0x12, 0x0f, 0xd2, 0x3b, 0xed, 0x32, 0x1b, 0xbe, 0xd6, 0x1e, 0xaa, 0x31, 0x01, 0xbd, 0x41,
+    0x42, 0x30, 0x0d, 0xfe, 0xd9, 0x02, 0x46, 0x93, 0x99, 0xbf, 0x6b, 0xa9, 0xfc, 0x36, 0x76, 0xc5,
+    0x52, 0xc7, 0x26, 0xb2, 0x8e, 0x5f, 0x8b, 0x86, 0xb8, 0xfe, 0x53, 0x4c, 0xcb, 0x92, 0xf8, 0xc6,
+    0x94, 0x69, 0xee, 0x0a, 0xa3, 0xca, 0x6b, 0x38, 0xca, 0x14, 0x04, 0xd5, 0x4e, 0x08, 0x1e, 0x05,
+    0x04, 0x58, 0x2b, 0xa1, 0xc2, 0xde, 0xb3, 0x66, 0xa7, 0x73, 0xf9, 0x1b, 0xe0, 0x1d, 0x37, 0x18,
+    0xa3, 0x47, 0x05, 0x53, 0x46, 0xd0, 0x38, 0x57, 0x1a, 0x03, 0x99, 0xfe, 0xf4, 0x29, 0xd4, 0x48,
+    0x60, 0xe0, 0xce, 0x73, 0xfb, 0x9e, 0xae, 0x5c, 0x58, 0x8d, 0x9b, 0xa2, 0x0b, 0xde, 0x5e, 0x4c,
+    0x7f, 0xaa, 0xb5, 0x4a, 0xb4, 0xa3, 0xee, 0x83, 0x98, 0x4f, 0xdb, 0xe2, 0x92, 0x31, 0x66, 0x26,
+    0x1d, 0x0b, 0x76, 0x3a, 0x3c, 0xfb, 0x3e, 0x4a, 0x3b, 0x75, 0x5c, 0xf6, 0x17, 0x6c, 0x88, 0x3e,
+    0x68, 0xc4, 0xd8, 0x45, 0x70, 0x35, 0x1f, 0x50, 0x9c, 0x51, 0xf4, 0x25, 0x50, 0xe0, 0x79, 0x55,
+    0xd8, 0x10, 0x69, 0x48, 0x82, 0x3c, 0x69, 0x77, 0x3a, 0x13, 0xec, 0x8d, 0x53, 0xb5, 0xc4, 0xa6,
+    0x54, 0xdd, 0x27, 0x30, 0x01, 0x07, 0xc1, 0x3e, 0xb4, 0x57, 0xb8, 0xd9, 0xc4, 0xb6, 0x82, 0xa8,
+    0x46, 0xf5, 0x06, 0xc7, 0x50, 0xd5, 0x05, 0x7f, 0x7d, 0xf3, 0xfa, 0x1c, 0x56, 0xef, 0xc4, 0x1f,
+    0x85, 0xb0, 0x0e, 0x91, 0xa0, 0x5d, 0xe8, 0x01, 0xe4, 0x3b, 0xcd, 0xf4, 0x28, 0xe1, 0x6a, 0xf9,
+    0xa8, 0x1d, 0x20, 0x50, 0x25, 0xef, 0x03, 0x94, 0xf6, 0x10, 0xbc, 0x72, 0x07, 0xc5, 0x31, 0x86,
+    0x40, 0x85, 0x66, 0xd0, 0xd8, 0xc8, 0xce, 0x67, 0xb3, 0x8b, 0xaf, 0xf4, 0x30, 0xc2, 0xad, 0x53,
+    0xf5, 0xa5, 0x46, 0xf4, 0x48, 0xb8, 0x83, 0x17, 0x57, 0x05, 0x15, 0x9b, 0x43, 0x71, 0x02, 0x0f,
+    0x5d, 0x0d, 0xe1, 0x26, 0xd6, 0xa7, 0x21, 0xf6, 0x52, 0xe2, 0x9f, 0x2e, 0x2b, 0x9e, 0x86, 0x00,
+    0xa6, 0xb7, 0x05, 0xd3, 0x7b, 0x5a, 0x81, 0xe9, 0x6d, 0xc0, 0xf4, 0xbc, 0x7f, 0x83, 0x65, 0x85,
+    0x4f, 0x2e, 0x94, 0xef, 0xfd, 0x30, 0x9d, 0x79, 0x5d, 0x3a, 0x17, 0x9a, 0x8e, 0x29, 0xc4, 0x06,
+    0x3e, 0x0a, 0x23, 0x99, 0xbe, 0x33, 0x7d, 0x26, 0x78, 0x9d, 0xae, 0x06, 0x33, 0x4c, 0xee, 0xf2,
+    0x22, 0xdd, 0x2f, 0xff, 0x17, 0xf0, 0x17, 0x9f, 0xa4, 0x11, 0x44, 0x23, 0x10, 0x00, 0x00,
+};
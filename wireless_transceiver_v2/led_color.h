@@ -0,0 +1,79 @@
+// ==================================================================
+// Code containing integer color math for the LED ring
+// ==================================================================
+// - Brightness levels (0 - 255) go through a perceptual gamma table
+//   (CIE lightness) generated at compile time with 16-bit precision.
+// - The fraction below one LSB is carried per pixel channel to the next
+//   frame (temporal dithering), so slow fades at the low end move
+//   smoothly instead of in visible steps.
+// No floats, no heap: a table lookup and a multiply per channel.
+
+
+/*
+ * =======================================================
+ * Gamma Table
+ * =======================================================
+ * Entry l is the light output (0 - 65535) for perceived brightness l,
+ * from the CIE 1976 lightness curve with L* = l * 100 / 255:
+ *   Y = ((L* + 16) / 116)^3   above L* = 8
+ *   Y = L* / 903.3            below
+ */
+
+// Compile-time index list 0 .. N-1 (C++11 has no std::index_sequence)
+template<int... Is> struct LedIndexList {};
+template<int N, int... Is> struct LedMakeIndexList : LedMakeIndexList<N - 1, N - 1, Is...> {};
+template<int... Is> struct LedMakeIndexList<0, Is...> { typedef LedIndexList<Is...> type; };
+
+// (L* + 16) * 255 for level l
+constexpr uint64_t led_lightness_scaled(int l) {
+    return (uint64_t)l * 100 + 16 * 255;
+}
+
+constexpr uint16_t led_gamma16(int l) {
+    return (l * 100 <= 8 * 255)
+        ? (uint16_t)((uint64_t)l * 6553500 / (255ULL * 9033 / 10))
+        : (uint16_t)(led_lightness_scaled(l) * led_lightness_scaled(l) * led_lightness_scaled(l) * 65535
+                     / (led_lightness_scaled(255) * led_lightness_scaled(255) * led_lightness_scaled(255)));
+}
+
+template<typename List = LedMakeIndexList<256>::type> struct LedGammaTable;
+template<int... Is> struct LedGammaTable<LedIndexList<Is...> > {
+    static const uint16_t levels[256];
+};
+template<int... Is>
+const uint16_t LedGammaTable<LedIndexList<Is...> >::levels[256] PROGMEM = { led_gamma16(Is)... };
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+// Fraction of an LSB still owed per pixel channel (R, G, B), only used by the LED task
+uint8_t ledDither[NUMPIXELS][3];
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+// One channel: color c (0 - 255) at light output gamma (0 - 65535)
+// adds the fraction left over from the last frame and keeps the new one
+inline uint8_t led_dither_channel(uint8_t &error, int c, uint16_t gamma) {
+    // 8.8 fixed point, gamma + 1 so full output gives exactly c
+    uint32_t value = ((c * ((uint32_t)gamma + 1)) >> 8) + error;
+    error = value & 0xff;
+    return value >> 8;
+}
+
+// Set pixel i to a color at a perceived brightness level (0 - 255)
+void led_set_pixel_level(int i, int red, int green, int blue, int level) {
+    uint16_t gamma = LedGammaTable<>::levels[level];
+    // (G, R, B)
+    pixels.setPixelColor(i, pixels.Color(led_dither_channel(ledDither[i][1], green, gamma),
+                                         led_dither_channel(ledDither[i][0], red, gamma),
+                                         led_dither_channel(ledDither[i][2], blue, gamma)));
+}
@@ -0,0 +1,195 @@
+// ==================================================================
+// Code containing the LED ring output backend and frame pacing
+// ==================================================================
+// Patterns draw into the pixels buffer (the back buffer) and led_show()
+// only hands the finished frame over. A periodic timer sends the newest
+// frame to the ring at LED_REFRESH_HZ; frames replaced before they were
+// sent are counted as skipped. The timer only runs while frames are
+// coming in: it stops on the first tick with nothing to send and the
+// next submitted frame starts it again, so a still ring costs no
+// wake-ups. The default backend streams frames with the RMT peripheral,
+// so no pixel timing runs on the CPU and interrupts stay enabled. Any
+// other backend (e.g. a mock in a host build) only has to implement
+// LedOutput.
+
+#include "esp_timer.h"
+#include "driver/rmt.h"
+
+// Frames sent to the ring per second
+#define LED_REFRESH_HZ 100
+// Bytes in one frame, 3 per pixel in wire order
+#define LED_FRAME_BYTES (NUMPIXELS * 3)
+
+// RMT channel and WS2812 bit timing, in 25 ns ticks (80 MHz APB / 2)
+#define LED_RMT_CHANNEL RMT_CHANNEL_0
+#define LED_RMT_CLK_DIV 2
+#define LED_RMT_T0H 14      // 350 ns
+#define LED_RMT_T0L 34      // 850 ns
+#define LED_RMT_T1H 28      // 700 ns
+#define LED_RMT_T1L 24      // 600 ns
+
+
+// Output backend interface
+class LedOutput {
+public:
+    // return false if the backend could not be set up
+    virtual bool begin() = 0;
+    // true once the previous frame has been sent completely
+    virtual bool idle() = 0;
+    // start sending a frame, returns immediately
+    // frame has to stay unchanged until idle() returns true
+    virtual void send(const uint8_t *frame, size_t length) = 0;
+};
+
+// RMT backend, the driver refills the RMT memory from its interrupt
+// (translating bytes to WS2812 bits) while the frame goes out
+class LedOutputRmt : public LedOutput {
+public:
+    bool begin() {
+        rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)LED_PIN, LED_RMT_CHANNEL);
+        config.clk_div = LED_RMT_CLK_DIV;
+        return rmt_config(&config) == ESP_OK &&
+               rmt_driver_install(LED_RMT_CHANNEL, 0, 0) == ESP_OK &&
+               rmt_translator_init(LED_RMT_CHANNEL, translate) == ESP_OK;
+    }
+
+    bool idle() {
+        return rmt_wait_tx_done(LED_RMT_CHANNEL, 0) == ESP_OK;
+    }
+
+    void send(const uint8_t *frame, size_t length) {
+        rmt_write_sample(LED_RMT_CHANNEL, frame, length, false);
+    }
+
+private:
+    // Runs in the RMT interrupt, one RMT item per bit, MSB first
+    static void IRAM_ATTR translate(const void *src, rmt_item32_t *dest, size_t srcSize,
+                                    size_t wantedNum, size_t *translatedSize, size_t *itemNum) {
+        const uint8_t *bytes = (const uint8_t *)src;
+        size_t size = 0;
+        size_t num = 0;
+        while (size < srcSize && num + 8 <= wantedNum) {
+            for (int bit = 7; bit >= 0; bit--) {
+                bool one = bytes[size] & (1 << bit);
+                dest[num].level0 = 1;
+                dest[num].duration0 = one ? LED_RMT_T1H : LED_RMT_T0H;
+                dest[num].level1 = 0;
+                dest[num].duration1 = one ? LED_RMT_T1L : LED_RMT_T0L;
+                num++;
+            }
+            size++;
+        }
+        *translatedSize = size;
+        *itemNum = num;
+    }
+};
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+LedOutputRmt ledOutputRmt;
+LedOutput *ledOutput = NULL;
+esp_timer_handle_t ledRefreshTimer = NULL;
+
+// Double buffer: the refresh timer sends ledFrames[ledFrontFrame] while
+// led_show() fills the other one
+uint8_t ledFrames[2][LED_FRAME_BYTES];
+int ledFrontFrame = 0;
+bool ledFrameReady = false;     // back frame holds a frame not yet sent
+bool ledRefreshRunning = false; // refresh timer started and not stopped since
+portMUX_TYPE ledFrameMux = portMUX_INITIALIZER_UNLOCKED;
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+// Hand a finished frame to the output, returns immediately
+// a frame still waiting from the last call is replaced and counted as skipped
+void led_output_submit(const uint8_t *frame) {
+    portENTER_CRITICAL(&ledFrameMux);
+    bool skipped = ledFrameReady;
+    memcpy(ledFrames[1 - ledFrontFrame], frame, LED_FRAME_BYTES);
+    ledFrameReady = true;
+    bool start = !ledRefreshRunning && ledRefreshTimer != NULL;
+    if (start) {
+        ledRefreshRunning = true;
+    }
+    portEXIT_CRITICAL(&ledFrameMux);
+
+    // outside the spinlock, the esp_timer API takes its own lock;
+    // fails harmlessly if a stop in the callback has not happened yet,
+    // the callback starts the timer again then
+    if (start) {
+        esp_timer_start_periodic(ledRefreshTimer, 1000000 / LED_REFRESH_HZ);
+    }
+
+    TRACE_INSTANT("led frame submit", skipped);
+    if (skipped) metrics_increment(metricsLedFramesSkipped);
+}
+
+// esp_timer callback, runs in the esp_timer task at LED_REFRESH_HZ
+// sends the newest frame once the previous one is out, stops when there is none
+void led_refresh_callback(void * arg) {
+    metrics_increment(metricsLedRefreshWakeups);
+    if (!ledOutput->idle()) {
+        // previous frame still going out, the waiting frame keeps for the next tick
+        return;
+    }
+    portENTER_CRITICAL(&ledFrameMux);
+    bool ready = ledFrameReady;
+    if (ready) {
+        ledFrontFrame = 1 - ledFrontFrame;
+        ledFrameReady = false;
+    } else {
+        ledRefreshRunning = false;
+    }
+    portEXIT_CRITICAL(&ledFrameMux);
+
+    if (ready) {
+        TRACE_SCOPE("led frame send");
+        ledOutput->send(ledFrames[ledFrontFrame], LED_FRAME_BYTES);
+        metrics_increment(metricsLedFramesSent);
+        return;
+    }
+
+    esp_timer_stop(ledRefreshTimer);
+    // a frame submitted between the decision and the stop marked the timer
+    // running again, its start may have failed while the timer was still
+    // armed, so start it here (fails harmlessly if it did not)
+    portENTER_CRITICAL(&ledFrameMux);
+    bool restart = ledRefreshRunning;
+    portEXIT_CRITICAL(&ledFrameMux);
+    if (restart) {
+        esp_timer_start_periodic(ledRefreshTimer, 1000000 / LED_REFRESH_HZ);
+    }
+}
+
+// Start the output backend and create the refresh timer
+// the timer starts with the first submitted frame
+// return false if either could not be set up
+bool led_output_begin(LedOutput &output) {
+    ledOutput = &output;
+    if (!ledOutput->begin()) {
+        return false;
+    }
+    esp_timer_create_args_t timerArgs;
+    timerArgs.callback = led_refresh_callback;
+    timerArgs.arg = NULL;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "led_refresh";
+    esp_timer_handle_t timer;
+    if (esp_timer_create(&timerArgs, &timer) != ESP_OK) {
+        return false;
+    }
+    portENTER_CRITICAL(&ledFrameMux);
+    ledRefreshTimer = timer;
+    portEXIT_CRITICAL(&ledFrameMux);
+    return true;
+}
@@ -0,0 +1,427 @@
+// ==================================================================
+// Code containing LED keyframe patterns and their interpreter
+// ==================================================================
+// Patterns are data, not code: a small binary program of brightness
+// keyframes per pixel that the LED task steps through frame by frame.
+// The built-in patterns below are stored in flash as such programs,
+// and programs uploaded through /led/pattern are kept in NVS and can
+// add new pattern codes or replace a built-in one without a reflash.
+//
+// Program format (little endian):
+//   0  u8   magic LED_PROGRAM_MAGIC
+//   1  u8   version LED_PROGRAM_VERSION
+//   2  u8   flags, LED_PROGRAM_OWN_COLOR: r, g, b follow the header
+//           (otherwise the color of the LED message is used)
+//   3  u8   repeat: extra plays after the first, LED_PROGRAM_FOREVER loops
+//           until the pattern is replaced
+//   4  u16  frame interval in ms
+//   6  u16  duration of one play in ms, frames are drawn while t < duration
+//   8  u8   track count
+//  [9  u8   r, g, b]
+//   then per track:
+//      u8   pixel mask, bit i = pixel i (a later track overrides an earlier one)
+//      u8   point count, at least 1
+//      per point: u16 time in ms (not decreasing), u8 level 0 - 255
+// A track level is interpolated linearly between points and holds the
+// first/last level before/after them. Two points at the same time make
+// a step. Pixels without a track are off.
+
+#include <Preferences.h>
+
+#define LED_PROGRAM_MAGIC 0x4B      // 'K'
+#define LED_PROGRAM_VERSION 1
+#define LED_PROGRAM_OWN_COLOR 0x01
+#define LED_PROGRAM_FOREVER 255
+#define LED_PROGRAM_HEADER_BYTES 9
+#define LED_PROGRAM_MIN_FRAME_MS 5
+
+// Uploaded programs kept in NVS (and in RAM while running)
+#define LED_CUSTOM_PATTERNS 4
+#define LED_PATTERNS_NAMESPACE "led_patterns"
+
+// Program building helpers for the tables below
+#define LED_U16(v) ((v) & 0xff), ((v) >> 8)
+#define LED_PROGRAM(repeat, frameMs, durationMs, tracks) \
+    LED_PROGRAM_MAGIC, LED_PROGRAM_VERSION, 0, repeat, LED_U16(frameMs), LED_U16(durationMs), tracks
+#define LED_TRACK(mask, points) mask, points
+#define LED_KEY(ms, level) LED_U16(ms), level
+
+
+// Program of an uploaded pattern
+struct LEDCustomPattern {
+    int code;                   // 0 if the slot is free
+    uint16_t length;
+    uint8_t program[LED_PROGRAM_MAX_BYTES];
+};
+
+// Built-in pattern code Code. Switched off (Enabled false) it has no program;
+// switched on it is specialized below with load(), copying its program
+template<int Code, bool Enabled> struct LEDBuiltin;
+template<int Code> struct LEDBuiltin<Code, false> {};
+
+// Lookup over the built-in patterns: one compare per pattern that is
+// switched on, patterns switched off are not part of it
+template<typename... Patterns> struct LEDBuiltinSet;
+template<> struct LEDBuiltinSet<> {
+    static size_t load(int code, uint8_t *program) { return 0; }
+};
+template<int Code, typename... Rest> struct LEDBuiltinSet<LEDBuiltin<Code, false>, Rest...> : LEDBuiltinSet<Rest...> {};
+template<int Code, typename... Rest> struct LEDBuiltinSet<LEDBuiltin<Code, true>, Rest...> {
+    static size_t load(int code, uint8_t *program) {
+        return code == Code ? LEDBuiltin<Code, true>::load(program) : LEDBuiltinSet<Rest...>::load(code, program);
+    }
+};
+
+
+/*
+ * =======================================================
+ * Built-in Patterns
+ * =======================================================
+ * Re-expressed from the former hand-written frame functions, at 10 ms
+ * frames (the ring refresh rate) unless the pattern only steps.
+ * Trails are the same linear envelopes, circle in was sampled and reduced
+ * to its corner points.
+ */
+
+const uint8_t ledProgramFadeIn[] PROGMEM = {
+    LED_PROGRAM(0, 10, 440, 1),
+    LED_TRACK(0x7f, 2), LED_KEY(0, 0), LED_KEY(300, 255),
+};
+
+const uint8_t ledProgramOff[] PROGMEM = {
+    LED_PROGRAM(0, 10, 10, 0),
+};
+
+// one trail from pixel 1 to 6, centre off
+const uint8_t ledProgramLoading[] PROGMEM = {
+    LED_PROGRAM(0, 10, 1620, 6),
+    LED_TRACK(0x02, 3), LED_KEY(0, 0), LED_KEY(300, 255), LED_KEY(600, 0),
+    LED_TRACK(0x04, 3), LED_KEY(200, 0), LED_KEY(500, 255), LED_KEY(800, 0),
+    LED_TRACK(0x08, 3), LED_KEY(400, 0), LED_KEY(700, 255), LED_KEY(1000, 0),
+    LED_TRACK(0x10, 3), LED_KEY(600, 0), LED_KEY(900, 255), LED_KEY(1200, 0),
+    LED_TRACK(0x20, 3), LED_KEY(800, 0), LED_KEY(1100, 255), LED_KEY(1400, 0),
+    LED_TRACK(0x40, 3), LED_KEY(1000, 0), LED_KEY(1300, 255), LED_KEY(1600, 0),
+};
+
+// slower trail with a longer tail
+const uint8_t ledProgramLoadingLong[] PROGMEM = {
+    LED_PROGRAM(0, 10, 3800, 6),
+    LED_TRACK(0x02, 3), LED_KEY(400, 0), LED_KEY(1400, 255), LED_KEY(2400, 0),
+    LED_TRACK(0x04, 3), LED_KEY(600, 0), LED_KEY(1600, 255), LED_KEY(2600, 0),
+    LED_TRACK(0x08, 3), LED_KEY(800, 0), LED_KEY(1800, 255), LED_KEY(2800, 0),
+    LED_TRACK(0x10, 3), LED_KEY(1000, 0), LED_KEY(2000, 255), LED_KEY(3000, 0),
+    LED_TRACK(0x20, 3), LED_KEY(1200, 0), LED_KEY(2200, 255), LED_KEY(3200, 0),
+    LED_TRACK(0x40, 3), LED_KEY(1400, 0), LED_KEY(2400, 255), LED_KEY(3400, 0),
+};
+
+// pixels light up one after the other and stay on
+const uint8_t ledProgramLoadIn[] PROGMEM = {
+    LED_PROGRAM(0, 10, 1820, 7),
+    LED_TRACK(0x01, 2), LED_KEY(0, 0), LED_KEY(300, 255),
+    LED_TRACK(0x02, 2), LED_KEY(200, 0), LED_KEY(500, 255),
+    LED_TRACK(0x04, 2), LED_KEY(400, 0), LED_KEY(700, 255),
+    LED_TRACK(0x08, 2), LED_KEY(600, 0), LED_KEY(900, 255),
+    LED_TRACK(0x10, 2), LED_KEY(800, 0), LED_KEY(1100, 255),
+    LED_TRACK(0x20, 2), LED_KEY(1000, 0), LED_KEY(1300, 255),
+    LED_TRACK(0x40, 2), LED_KEY(1200, 0), LED_KEY(1500, 255),
+};
+
+// all on, then pixels fade out one after the other
+const uint8_t ledProgramLoadOut[] PROGMEM = {
+    LED_PROGRAM(0, 10, 1620, 7),
+    LED_TRACK(0x01, 2), LED_KEY(100, 255), LED_KEY(400, 0),
+    LED_TRACK(0x02, 2), LED_KEY(300, 255), LED_KEY(600, 0),
+    LED_TRACK(0x04, 2), LED_KEY(500, 255), LED_KEY(800, 0),
+    LED_TRACK(0x08, 2), LED_KEY(700, 255), LED_KEY(1000, 0),
+    LED_TRACK(0x10, 2), LED_KEY(900, 255), LED_KEY(1200, 0),
+    LED_TRACK(0x20, 2), LED_KEY(1100, 255), LED_KEY(1400, 0),
+    LED_TRACK(0x40, 2), LED_KEY(1300, 255), LED_KEY(1600, 0),
+};
+
+// slow breath out, quicker breath in, hold
+const uint8_t ledProgramBreathe[] PROGMEM = {
+    LED_PROGRAM(0, 10, 2670, 2),
+    LED_TRACK(0x01, 4), LED_KEY(0, 252), LED_KEY(1600, 89), LED_KEY(1625, 92), LED_KEY(2265, 255),
+    LED_TRACK(0x7e, 5), LED_KEY(0, 255), LED_KEY(500, 255), LED_KEY(1600, 31), LED_KEY(1825, 31), LED_KEY(2265, 255),
+};
+
+// two laps with a growing trail, centre fades in on the second lap
+const uint8_t ledProgramCircleIn[] PROGMEM = {
+    LED_PROGRAM(0, 10, 1200, 7),
+    LED_TRACK(0x01, 2), LED_KEY(600, 0), LED_KEY(1200, 255),
+    LED_TRACK(0x02, 14), LED_KEY(0, 0), LED_KEY(66, 0), LED_KEY(82, 144), LED_KEY(100, 255), LED_KEY(120, 170),
+        LED_KEY(139, 112), LED_KEY(170, 45), LED_KEY(201, 0), LED_KEY(466, 0), LED_KEY(574, 144),
+        LED_KEY(699, 255), LED_KEY(842, 169), LED_KEY(998, 103), LED_KEY(1199, 213),
+    LED_TRACK(0x04, 14), LED_KEY(0, 0), LED_KEY(133, 0), LED_KEY(164, 144), LED_KEY(200, 255), LED_KEY(240, 170),
+        LED_KEY(281, 108), LED_KEY(340, 45), LED_KEY(401, 0), LED_KEY(533, 0), LED_KEY(656, 144),
+        LED_KEY(799, 255), LED_KEY(938, 180), LED_KEY(1100, 116), LED_KEY(1199, 170),
+    LED_TRACK(0x08, 12), LED_KEY(0, 0), LED_KEY(199, 0), LED_KEY(246, 144), LED_KEY(300, 255), LED_KEY(355, 176),
+        LED_KEY(431, 100), LED_KEY(510, 45), LED_KEY(598, 1), LED_KEY(738, 144), LED_KEY(899, 255),
+        LED_KEY(1048, 183), LED_KEY(1199, 128),
+    LED_TRACK(0x10, 10), LED_KEY(0, 0), LED_KEY(266, 0), LED_KEY(328, 144), LED_KEY(400, 255), LED_KEY(469, 180),
+        LED_KEY(530, 130), LED_KEY(699, 37), LED_KEY(843, 161), LED_KEY(999, 255), LED_KEY(1199, 171),
+    LED_TRACK(0x20, 9), LED_KEY(0, 0), LED_KEY(333, 0), LED_KEY(410, 144), LED_KEY(500, 255), LED_KEY(636, 146),
+        LED_KEY(800, 64), LED_KEY(935, 166), LED_KEY(1098, 255), LED_KEY(1199, 213),
+    LED_TRACK(0x40, 8), LED_KEY(0, 0), LED_KEY(399, 0), LED_KEY(492, 144), LED_KEY(599, 255), LED_KEY(741, 158),
+        LED_KEY(898, 86), LED_KEY(1048, 182), LED_KEY(1199, 255),
+};
+
+// flash twice
+const uint8_t ledProgramFlash[] PROGMEM = {
+    LED_PROGRAM(0, 500, 2000, 1),
+    LED_TRACK(0x7f, 7), LED_KEY(0, 255), LED_KEY(500, 255), LED_KEY(500, 0), LED_KEY(1000, 0),
+        LED_KEY(1000, 255), LED_KEY(1500, 255), LED_KEY(1500, 0),
+};
+
+const uint8_t ledProgramFlashFast[] PROGMEM = {
+    LED_PROGRAM(0, 200, 800, 1),
+    LED_TRACK(0x7f, 7), LED_KEY(0, 255), LED_KEY(200, 255), LED_KEY(200, 0), LED_KEY(400, 0),
+        LED_KEY(400, 255), LED_KEY(600, 255), LED_KEY(600, 0),
+};
+
+// centre fades in, ring glows faintly at the end
+const uint8_t ledProgramPersistStatus1[] PROGMEM = {
+    LED_PROGRAM(0, 10, 800, 2),
+    LED_TRACK(0x01, 2), LED_KEY(0, 3), LED_KEY(790, 255),
+    LED_TRACK(0x7e, 3), LED_KEY(0, 0), LED_KEY(720, 0), LED_KEY(790, 23),
+};
+
+// centre fades in, ring off
+const uint8_t ledProgramPersistStatus2[] PROGMEM = {
+    LED_PROGRAM(0, 10, 800, 1),
+    LED_TRACK(0x01, 2), LED_KEY(0, 0), LED_KEY(790, 252),
+};
+
+// Program of each built-in code, load() and with it the program are only
+// linked for patterns switched on
+#define LED_BUILTIN_PROGRAM(code, data) \
+    template<> struct LEDBuiltin<code, true> { \
+        static size_t load(uint8_t *program) { \
+            memcpy_P(program, data, sizeof(data)); \
+            return sizeof(data); \
+        } \
+    }
+LED_BUILTIN_PROGRAM(LED_FADEIN, ledProgramFadeIn);
+LED_BUILTIN_PROGRAM(LED_OFF, ledProgramOff);
+LED_BUILTIN_PROGRAM(LED_LOADING, ledProgramLoading);
+LED_BUILTIN_PROGRAM(LED_LOADING_LONG, ledProgramLoadingLong);
+LED_BUILTIN_PROGRAM(LED_LOAD_IN, ledProgramLoadIn);
+LED_BUILTIN_PROGRAM(LED_LOAD_OUT, ledProgramLoadOut);
+LED_BUILTIN_PROGRAM(LED_BREATHE, ledProgramBreathe);
+LED_BUILTIN_PROGRAM(LED_CIRCLE_IN, ledProgramCircleIn);
+LED_BUILTIN_PROGRAM(LED_FLASH, ledProgramFlash);
+LED_BUILTIN_PROGRAM(LED_FLASH_FAST, ledProgramFlashFast);
+LED_BUILTIN_PROGRAM(LED_PERSIST_STATUS_1, ledProgramPersistStatus1);
+LED_BUILTIN_PROGRAM(LED_PERSIST_STATUS_2, ledProgramPersistStatus2);
+
+// The built-in patterns of this build, switched in build_profile.h
+typedef LEDBuiltinSet<
+    LEDBuiltin<LED_FADEIN, buildLedFadeIn>,
+    LEDBuiltin<LED_OFF, buildLedOff>,
+    LEDBuiltin<LED_LOADING, buildLedLoading>,
+    LEDBuiltin<LED_LOADING_LONG, buildLedLoadingLong>,
+    LEDBuiltin<LED_LOAD_IN, buildLedLoadIn>,
+    LEDBuiltin<LED_LOAD_OUT, buildLedLoadOut>,
+    LEDBuiltin<LED_BREATHE, buildLedBreathe>,
+    LEDBuiltin<LED_CIRCLE_IN, buildLedCircleIn>,
+    LEDBuiltin<LED_FLASH, buildLedFlash>,
+    LEDBuiltin<LED_FLASH_FAST, buildLedFlashFast>,
+    LEDBuiltin<LED_PERSIST_STATUS_1, buildLedPersistStatus1>,
+    LEDBuiltin<LED_PERSIST_STATUS_2, buildLedPersistStatus2>
+> LEDBuiltinPatterns;
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+// Uploaded patterns, slot i is stored under NVS key "s<i>" as code (2 bytes) + program
+struct LEDCustomPattern ledCustomPatterns[LED_CUSTOM_PATTERNS];
+// Guards ledCustomPatterns; a mutex rather than a spinlock, a whole program
+// is copied under it and interrupts stay enabled meanwhile
+SemaphoreHandle_t xLedPatternsMutex = NULL;
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+inline uint16_t led_program_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+// Check that a program is well formed, so the interpreter never reads past it
+bool led_program_validate(const uint8_t *program, size_t length) {
+    if (length < LED_PROGRAM_HEADER_BYTES || length > LED_PROGRAM_MAX_BYTES) return false;
+    if (program[0] != LED_PROGRAM_MAGIC || program[1] != LED_PROGRAM_VERSION) return false;
+    if (led_program_u16(program + 4) < LED_PROGRAM_MIN_FRAME_MS || led_program_u16(program + 6) == 0) return false;
+    size_t pos = LED_PROGRAM_HEADER_BYTES;
+    if (program[2] & LED_PROGRAM_OWN_COLOR) pos += 3;
+    for (int track = 0; track < program[8]; track++) {
+        if (pos + 2 > length) return false;
+        int points = program[pos + 1];
+        pos += 2;
+        if (points == 0 || pos + points * 3 > length) return false;
+        for (int i = 1; i < points; i++) {
+            if (led_program_u16(program + pos + i * 3) < led_program_u16(program + pos + (i - 1) * 3)) return false;
+        }
+        pos += points * 3;
+    }
+    return pos == length;
+}
+
+// Level of a track at time t (ms), points: count entries of u16 time + u8 level
+int led_program_level(const uint8_t *points, int count, uint32_t t) {
+    if (t <= led_program_u16(points)) return points[2];
+    for (int i = 1; i < count; i++) {
+        const uint8_t *next = points + i * 3;
+        uint32_t nextAt = led_program_u16(next);
+        if (t < nextAt) {
+            const uint8_t *prev = next - 3;
+            uint32_t prevAt = led_program_u16(prev);
+            return prev[2] + ((int)next[2] - prev[2]) * (int)(t - prevAt) / (int)(nextAt - prevAt);
+        }
+    }
+    return points[(count - 1) * 3 + 2];
+}
+
+// Draw frame number 'frame' of a validated program
+// return the delay in ms before the next frame, or LED_PATTERN_DONE
+int led_program_frame(const uint8_t *program, int frame, int red, int green, int blue) {
+    uint32_t frameMs = led_program_u16(program + 4);
+    uint32_t duration = led_program_u16(program + 6);
+    uint32_t t = frame * frameMs;
+    if (program[3] != LED_PROGRAM_FOREVER && t / duration > program[3]) {
+        return LED_PATTERN_DONE;
+    }
+    t %= duration;
+
+    const uint8_t *pos = program + LED_PROGRAM_HEADER_BYTES;
+    if (program[2] & LED_PROGRAM_OWN_COLOR) {
+        red = pos[0];
+        green = pos[1];
+        blue = pos[2];
+        pos += 3;
+    }
+    uint8_t levels[NUMPIXELS] = {0};
+    for (int track = 0; track < program[8]; track++) {
+        int mask = pos[0];
+        int points = pos[1];
+        int level = led_program_level(pos + 2, points, t);
+        for (int i = 0; i < NUMPIXELS; i++) {
+            if (mask & (1 << i)) levels[i] = level;
+        }
+        pos += 2 + points * 3;
+    }
+    for (int i = 0; i < NUMPIXELS; i++) {
+        led_set_pixel_level(i, red, green, blue, levels[i]);
+    }
+    led_show();
+    return frameMs;
+}
+
+// Copy the program for a pattern code into program (LED_PROGRAM_MAX_BYTES)
+// an uploaded program takes precedence over a built-in one
+// return its length, 0 if the code is unknown
+size_t led_program_load(int code, uint8_t *program) {
+    if (!buildLedUploads) {
+        return LEDBuiltinPatterns::load(code, program);
+    }
+    size_t length = 0;
+    xSemaphoreTake(xLedPatternsMutex, portMAX_DELAY);
+    for (int i = 0; i < LED_CUSTOM_PATTERNS; i++) {
+        if (ledCustomPatterns[i].code == code) {
+            length = ledCustomPatterns[i].length;
+            memcpy(program, ledCustomPatterns[i].program, length);
+            break;
+        }
+    }
+    xSemaphoreGive(xLedPatternsMutex);
+    if (length > 0) return length;
+    return LEDBuiltinPatterns::load(code, program);
+}
+
+// Create the slot lock and read uploaded patterns from NVS, called once
+// before the LED task starts
+// return false if the lock could not be created
+bool led_patterns_init() {
+    xLedPatternsMutex = xSemaphoreCreateMutex();
+    if (xLedPatternsMutex == NULL) {
+        return false;
+    }
+    Preferences prefs;
+    prefs.begin(LED_PATTERNS_NAMESPACE, true);
+    uint8_t blob[2 + LED_PROGRAM_MAX_BYTES];
+    for (int i = 0; i < LED_CUSTOM_PATTERNS; i++) {
+        char key[4] = { 's', (char)('0' + i), '\0' };
+        ledCustomPatterns[i].code = 0;
+        size_t length = prefs.isKey(key) ? prefs.getBytes(key, blob, sizeof(blob)) : 0;
+        if (length > 2 && led_program_validate(blob + 2, length - 2)) {
+            ledCustomPatterns[i].code = led_program_u16(blob);
+            ledCustomPatterns[i].length = length - 2;
+            memcpy(ledCustomPatterns[i].program, blob + 2, length - 2);
+        }
+    }
+    prefs.end();
+    return true;
+}
+
+// Store a validated program under a pattern code (1 - 65535), replacing an
+// earlier upload for the same code. Used from the next pattern start on.
+// return false if all slots are taken
+bool led_patterns_store(int code, const uint8_t *program, size_t length) {
+    int slot = -1;
+    xSemaphoreTake(xLedPatternsMutex, portMAX_DELAY);
+    for (int i = 0; i < LED_CUSTOM_PATTERNS; i++) {
+        if (ledCustomPatterns[i].code == code) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && ledCustomPatterns[i].code == 0) slot = i;
+    }
+    if (slot >= 0) {
+        ledCustomPatterns[slot].code = code;
+        ledCustomPatterns[slot].length = length;
+        memcpy(ledCustomPatterns[slot].program, program, length);
+    }
+    xSemaphoreGive(xLedPatternsMutex);
+    if (slot < 0) return false;
+
+    uint8_t blob[2 + LED_PROGRAM_MAX_BYTES];
+    blob[0] = code & 0xff;
+    blob[1] = code >> 8;
+    memcpy(blob + 2, program, length);
+    char key[4] = { 's', (char)('0' + slot), '\0' };
+    Preferences prefs;
+    prefs.begin(LED_PATTERNS_NAMESPACE, false);
+    prefs.putBytes(key, blob, 2 + length);
+    prefs.end();
+    return true;
+}
+
+// Drop the upload for a pattern code, a built-in pattern of that code is used again
+// return false if there was none
+bool led_patterns_remove(int code) {
+    int slot = -1;
+    xSemaphoreTake(xLedPatternsMutex, portMAX_DELAY);
+    for (int i = 0; i < LED_CUSTOM_PATTERNS; i++) {
+        if (ledCustomPatterns[i].code == code) {
+            ledCustomPatterns[i].code = 0;
+            slot = i;
+            break;
+        }
+    }
+    xSemaphoreGive(xLedPatternsMutex);
+    if (slot < 0) return false;
+
+    char key[4] = { 's', (char)('0' + slot), '\0' };
+    Preferences prefs;
+    prefs.begin(LED_PATTERNS_NAMESPACE, false);
+    prefs.remove(key);
+    prefs.end();
+    return true;
+}
@@ -9,6 +9,24 @@
 #define LED_PIN 32
 #define NUMPIXELS 7
 
+// Frame output to the ring (RMT backend, fixed refresh rate)
+#include "led_output.h"
+
+// Drawing a pattern frame returns the time in ms until its next frame,
+// or LED_PATTERN_DONE once the last frame has been drawn
+#define LED_PATTERN_DONE -1
+// Largest keyframe pattern program (format in led_patterns.h)
+#define LED_PROGRAM_MAX_BYTES 512
+// Ticks to wait for a message before a replayable pattern starts over
+#define LED_IDLE_WAIT 10
+
+// LED event queue
+#define LED_QUEUE_LENGTH 10
+// Message priorities, higher ones are played first
+#define LED_PRIORITY_STATUS 0       // persistent indicators, replaced by any newer message
+#define LED_PRIORITY_ACTUATION 1    // switch feedback and other one-off transitions
+#define LED_PRIORITY_ERROR 2
+
 // LED pattern codes
 #define LED_FADEIN 100
 #define LED_OFF 200
@@ -31,6 +49,26 @@ struct LEDMessage {
     bool useprevcolor = false;  // whether the new pattern should use whatever color used by the previous one
     bool allowreplay;    // Is this pattern allowed to be replayed if no message from queue?
     bool playedflag = false;     // Whether this pattern has been played once
+    bool preempt = false;        // Whether this pattern interrupts the running one instead of waiting for it
+    int priority = LED_PRIORITY_STATUS;
+    uint32_t queuedAt = 0;       // micros() when the message was sent
+};
+
+// State of the pattern currently shown on the ring
+struct LEDAnimation {
+    int pattern;
+    uint8_t program[LED_PROGRAM_MAX_BYTES];   // keyframe program of the pattern (led_patterns.h)
+    size_t programLength;                     // 0 if the pattern code is unknown
+    int colors[3]; // R, G, B
+    int priority;
+    bool allowreplay;
+    bool active;              // false once the pattern has drawn its last frame
+    int frame;                // next frame to draw
+    TickType_t nextFrameAt;   // tick count the next frame is due at
+    uint32_t queuedAt;        // micros() when the starting message was sent
+#ifdef LED_PROFILE_FRAMES
+    uint32_t computeCycles;   // cycles spent computing frames so far
+#endif
 };
 
 /*
@@ -40,423 +78,395 @@ struct LEDMessage {
  */
 
 // Setup LED ring
+// only used as the frame buffer and color packer, led_output.h sends the frames
 Adafruit_NeoPixel pixels(NUMPIXELS, LED_PIN, NEO_RGB + NEO_KHZ800);
 
-// Create LED queue handler
-QueueHandle_t xLedQueue = NULL;
+// LED event queue, kept in play order: highest priority first, oldest first within a priority
+struct LEDMessage ledQueue[LED_QUEUE_LENGTH];
+int ledQueueCount = 0;
+portMUX_TYPE ledQueueMux = portMUX_INITIALIZER_UNLOCKED;
+// Given on every send to wake the LED task
+SemaphoreHandle_t xLedQueueSignal = NULL;
+
+
+// Integer color math: gamma and dithering
+#include "led_color.h"
 
 
 /*
  * =======================================================
- * Functions
+ * Frame Profiling
  * =======================================================
+ * Build with LED_PROFILE_FRAMES defined to print the average CPU cycles
+ * each pattern spends computing a frame (excluding led_show()) when
+ * the pattern finishes.
+ * Build with PROFILE_LATENCY defined to print the time from a message
+ * being sent to the first frame of its pattern.
+ * Both print one "[PROFILE] >>>" line per event so a serial capture can
+ * be compared between builds. tools/loadtest/emulator/switch_bench
+ * measures the same on a host, without a board.
  */
+#ifdef LED_PROFILE_FRAMES
+uint32_t ledShowCycles = 0;     // cycles spent in led_show() during the current frame
+#endif
+
+// Hand the frame drawn in pixels to the output, it is sent on the next refresh
+void led_show() {
+#ifdef LED_PROFILE_FRAMES
+    uint32_t start = ESP.getCycleCount();
+    led_output_submit(pixels.getPixels());
+    ledShowCycles += ESP.getCycleCount() - start;
+#else
+    led_output_submit(pixels.getPixels());
+#endif
+}
 
-int* RGBtoHSV(int r, int g, int b) {
-    float h, s, v;
-    float r_ = r / 255.0f;
-    float g_ = g / 255.0f;
-    float b_ = b / 255.0f;
-
-    float cmax = std::max(std::max(r_, g_), b_);
-    float cmin = std::min(std::min(r_, g_), b_);
-    float delta = cmax - cmin;
-
-    if (delta == 0) {
-        h = 0;
-    } else if (cmax == r_) {
-        h = 60 * fmod(((g_ - b_) / delta), 6);
-    } else if (cmax == g_) {
-        h = 60 * (((b_ - r_) / delta) + 2);
-    } else if (cmax == b_) {
-        h = 60 * (((r_ - g_) / delta) + 4);
-    }
-
-    if (cmax == 0) {
-        s = 0;
-    } else {
-        s = delta / cmax;
-    }
-
-    v = cmax;
 
-    int* hsv = new int[3];
-    hsv[0] = int(h);
-    hsv[1] = int(s);
-    hsv[2] = int(v);
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
 
-    return hsv;
+void led_off(){
+    pixels.fill(pixels.Color(0, 0, 0));
+    led_show();
 }
 
+// Keyframe pattern programs and their interpreter
+#include "led_patterns.h"
 
 
-void setColor(int red, int green, int blue){
-    for(int i=0; i<NUMPIXELS; i++) {
-        // (G, R, B)
-        pixels.setPixelColor(i, pixels.Color(green, red, blue));
-        pixels.show();
-        delay(100);
-     }
-}
-
-void led_fade_in(int red, int green, int blue){
+/*
+ * =======================================================
+ * LED Event Queue
+ * =======================================================
+ * Replaces a plain FIFO so the ring always shows the latest device state:
+ * - messages are ordered by priority (error > actuation > status)
+ * - a new message removes waiting status messages, they are out of date
+ * - when full, the oldest message of the lowest priority is dropped,
+ *   or the new one if everything waiting outranks it
+ * Senders never block. The LED task is the only receiver.
+ */
 
-    //int* hsvValue = RGBtoHSV(red, green, blue);
-    
-    for(int i=0; i<120; i++) {
-        //pixels.fill(pixels.ColorHSV(hsvValue[0], hsvValue[1], i));
-        pixels.fill(pixels.Color(int(green/100.0*i), int(red/100.0*i), int(blue/100.0*i)));
-        pixels.show();
-        vTaskDelay(3 / portTICK_PERIOD_MS);
-    }
-    for(int i=120; i>100; i--) {
-        pixels.fill(pixels.Color(int(green/100.0*i), int(red/100.0*i), int(blue/100.0*i)));
-        pixels.show();
-        vTaskDelay(4 / portTICK_PERIOD_MS);
-    }
+// return false if the wake-up semaphore could not be created
+bool led_queue_init() {
+    xLedQueueSignal = xSemaphoreCreateBinary();
+    return xLedQueueSignal != NULL;
 }
 
-void led_off(){
-    pixels.fill(pixels.Color(0, 0, 0));
-    pixels.show();
+int led_queue_depth() {
+    portENTER_CRITICAL(&ledQueueMux);
+    int depth = ledQueueCount;
+    portEXIT_CRITICAL(&ledQueueMux);
+    return depth;
 }
 
-
-void led_loading(int red, int green, int blue){
-    led_off();
-    // loading trailing lnegth: 1 leds [alow 15 spacing]
-    // one trail in front and one trail at the end, 3 active leds
-    // led2[100], led3[200], ...... , led7[600]
-    float trailing = 150.0;
-    for(int t=-50; t<760; t++) {
-        for (int i=1; i<NUMPIXELS; i++){
-            float brightness = 100 - abs(i*100-t)*100/trailing;
-            if (brightness < 0){
-                brightness = 0;
-            }
-            pixels.setPixelColor(i, pixels.Color(int(green/100.0*brightness), int(red/100.0*brightness), int(blue/100.0*brightness)));
-        }
-        pixels.show();
-        vTaskDelay(2 / portTICK_PERIOD_MS);
+// Remove the entry at index, queue lock must be held
+void led_queue_remove_locked(int index) {
+    for (int i = index; i < ledQueueCount - 1; i++) {
+        ledQueue[i] = ledQueue[i + 1];
     }
+    ledQueueCount--;
 }
 
-void led_loading_long(int red, int green, int blue){
-    led_off();
-    // loading trailing lnegth: 1 leds [alow 15 spacing]
-    // one trail in front and one trail at the end, 3 active leds
-    // led2[100], led3[200], ...... , led7[600]
-    float trailing = 500.0;
-    for(int t=-600; t<1300; t++) {
-        for (int i=1; i<NUMPIXELS; i++){
-            float brightness = 100 - abs(i*100-t)*100/trailing;
-            if (brightness < 0){
-                brightness = 0;
-            }
-            pixels.setPixelColor(i, pixels.Color(int(green/100.0*brightness), int(red/100.0*brightness), int(blue/100.0*brightness)));
+// return false if the message was dropped
+bool led_queue_send(struct LEDMessage &msg) {
+    TRACE_SCOPE("led queue send");
+    int coalesced = 0;
+    bool dropped = false;
+    bool accepted = true;
+
+    portENTER_CRITICAL(&ledQueueMux);
+    // waiting status messages are superseded by anything newer
+    for (int i = ledQueueCount - 1; i >= 0; i--) {
+        if (ledQueue[i].priority == LED_PRIORITY_STATUS) {
+            led_queue_remove_locked(i);
+            coalesced++;
         }
-        pixels.show();
-        vTaskDelay(2 / portTICK_PERIOD_MS);
     }
-}
-
-void led_load_in(int red, int green, int blue){
-    led_off();
-    // loading trailing lnegth: 1 leds [alow 15 spacing]
-    // one trail in front and one trail at the end, 3 active leds
-    // led2[100], led3[200], ...... , led7[600]
-    float trailing = 150.0;
-    for(int t=-150; t<760; t++) {
-        for (int i=0; i<NUMPIXELS; i++){
-            float brightness = 100 - abs(i*100-t)*100/trailing;
-            if (brightness < 0){
-                brightness = 0;
-            }
-            if (i*100 > t){
-                pixels.setPixelColor(i, pixels.Color(int(green/100.0*brightness), int(red/100.0*brightness), int(blue/100.0*brightness)));
-            }
+    if (ledQueueCount == LED_QUEUE_LENGTH) {
+        // oldest entry of the lowest priority waiting
+        int lowest = ledQueueCount - 1;
+        while (lowest > 0 && ledQueue[lowest - 1].priority == ledQueue[lowest].priority) {
+            lowest--;
+        }
+        dropped = true;
+        if (ledQueue[lowest].priority <= msg.priority) {
+            led_queue_remove_locked(lowest);
+        } else {
+            accepted = false;
         }
-        pixels.show();
-        vTaskDelay(2 / portTICK_PERIOD_MS);
     }
-}
-
-void led_load_out(int red, int green, int blue){
-    pixels.fill(pixels.Color(green, red, blue));
-    // loading trailing lnegth: 1 leds [alow 15 spacing]
-    // one trail in front and one trail at the end, 3 active leds
-    // led2[100], led3[200], ...... , led7[600]
-    float trailing = 150.0;
-    for(int t=-50; t<760; t++) {
-        for (int i=0; i<NUMPIXELS; i++){
-            float brightness = 100 - abs(i*100-t)*100/trailing;
-            if (brightness < 0){
-                brightness = 0;
-            }
-            if (i*100 < t){
-                pixels.setPixelColor(i, pixels.Color(int(green/100.0*brightness), int(red/100.0*brightness), int(blue/100.0*brightness)));
-            }
+    if (accepted) {
+        // insert behind every waiting message of the same or higher priority
+        int index = ledQueueCount;
+        while (index > 0 && ledQueue[index - 1].priority < msg.priority) {
+            ledQueue[index] = ledQueue[index - 1];
+            index--;
         }
-        pixels.show();
-        vTaskDelay(2 / portTICK_PERIOD_MS);
+        ledQueue[index] = msg;
+        ledQueueCount++;
     }
+    int depth = ledQueueCount;
+    portEXIT_CRITICAL(&ledQueueMux);
+
+    for (int i = 0; i < coalesced; i++) metrics_increment(metricsLedMessagesCoalesced);
+    if (dropped) metrics_increment(metricsLedMessagesDropped);
+    metrics_update_max(metricsLedQueueHighWater, depth);
+    xSemaphoreGive(xLedQueueSignal);
+    return accepted;
 }
 
-// good idea but might not use this one
-void led_breathe_1(int red, int green, int blue){
-    float centerintensity = 60;
-    float restintensity = 60;
-    
-    // Decrease brightness (breathe out)
-    for(int i=50; i<140; i++) {
-        // center intensity raises from 50 - 100
-        // rest intensity raises from 90 - 140
-        if (i < 100) centerintensity -= 1;
-        if (i > 90) restintensity -= 1;
-        
-        pixels.fill(pixels.Color(int(green/100.0*restintensity), int(red/100.0*restintensity), int(blue/100.0*restintensity)));
-        pixels.setPixelColor(0,pixels.Color(int(green/100.0*centerintensity), int(red/100.0*centerintensity), int(blue/100.0*centerintensity)));
-        pixels.show();
-        vTaskDelay(10 / portTICK_PERIOD_MS);
-    }
-    // Increase brightness (breathe in)
-    for(int i=50; i<140; i++) {
-        // center intensity raises from 50 - 100
-        // rest intensity raises from 80 - 130
-        if (i < 100) centerintensity += 1;
-        if (i > 90) restintensity += 1;
-        
-        pixels.fill(pixels.Color(int(green/100.0*restintensity), int(red/100.0*restintensity), int(blue/100.0*restintensity)));
-        pixels.setPixelColor(0,pixels.Color(int(green/100.0*centerintensity), int(red/100.0*centerintensity), int(blue/100.0*centerintensity)));
-        pixels.show();
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+// Copy the next message without removing it, waiting up to wait ticks for one
+// return false if none arrived in time
+bool led_queue_peek(struct LEDMessage &msg, TickType_t wait) {
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        portENTER_CRITICAL(&ledQueueMux);
+        bool found = ledQueueCount > 0;
+        if (found) msg = ledQueue[0];
+        portEXIT_CRITICAL(&ledQueueMux);
+        if (found) return true;
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= wait) return false;
+        xSemaphoreTake(xLedQueueSignal, wait - elapsed);
     }
-    
 }
 
-void led_breathe_2(int red, int green, int blue){
-    float centerintensity = 100;
-    float restintensity = 100;
-    
-    // Decrease brightness (breathe out)
-    for(int i=0; i<65; i++) {
-        // center intensity raises from 50 - 100
-        // rest intensity raises from 90 - 140
-        centerintensity -= 1;
-        if (i > 20) restintensity -= 2;
-        
-        pixels.fill(pixels.Color(int(green/100.0*restintensity), int(red/100.0*restintensity), int(blue/100.0*restintensity)));
-        pixels.setPixelColor(0,pixels.Color(int(green/100.0*centerintensity), int(red/100.0*centerintensity), int(blue/100.0*centerintensity)));
-        pixels.show();
-        vTaskDelay(25 / portTICK_PERIOD_MS);
+// Remove and return the next message without waiting
+// return false if the queue is empty
+bool led_queue_receive(struct LEDMessage &msg) {
+    portENTER_CRITICAL(&ledQueueMux);
+    bool found = ledQueueCount > 0;
+    if (found) {
+        msg = ledQueue[0];
+        led_queue_remove_locked(0);
     }
-
-    // Increase brightness (breathe in)
-    for(int i=0; i<65; i++) {
-        centerintensity += 1;
-        if (i > 20) restintensity += 2;
-        
-        pixels.fill(pixels.Color(int(green/100.0*restintensity), int(red/100.0*restintensity), int(blue/100.0*restintensity)));
-        pixels.setPixelColor(0,pixels.Color(int(green/100.0*centerintensity), int(red/100.0*centerintensity), int(blue/100.0*centerintensity)));
-        pixels.show();
-        vTaskDelay(10 / portTICK_PERIOD_MS);
-    }
-    vTaskDelay(400 / portTICK_PERIOD_MS);
-    
+    portEXIT_CRITICAL(&ledQueueMux);
+    return found;
 }
 
 
-void led_circle_in(int red, int green, int blue){
-    led_off();
-    // loading trailing lnegth: 1 leds [alow 15 spacing]
-    // one trail in front and one trail at the end, 3 active leds
-    // led2[100], led3[200], ...... , led7[600]
-    float trailing = 0.0001; // this is to prevent division by zero
-    for(int t=0; t<600; t++) {
-        for (int i=1; i<NUMPIXELS; i++){
-            // dist - shortest distance from led to variable t. from either direction (on a circle)
-            float dist = 0.0;
-            if (i*100 <= t){
-                dist = min( t-(i*100), 600-t+(i*100) );
-            }else{
-                dist = min( (i*100)-t, 600-(i*100)+t );
-            }
-            float brightness = 100 - dist*100/trailing;
-            if (brightness < 0){
-                brightness = 0;
-            }
-            pixels.setPixelColor(i, pixels.Color(int(green/100.0*brightness), int(red/100.0*brightness), int(blue/100.0*brightness)));
-        }
-        trailing += 0.5;
-        pixels.show();
-        vTaskDelay(1 / portTICK_PERIOD_MS);
-    }
-    for(int t=0; t<600; t++) {
-        for (int i=1; i<NUMPIXELS; i++){
-            // dist - shortest distance from led to variable t. from either direction (on a circle)
-            float dist = 0.0;
-            if (i*100 <= t){
-                dist = min( t-(i*100), 600-t+(i*100) );
-            }else{
-                dist = min( (i*100)-t, 600-(i*100)+t );
-            }
-            float brightness = 100 - dist*100/trailing;
-            if (brightness < 0){
-                brightness = 0;
-            }
-            pixels.setPixelColor(i, pixels.Color(int(green/100.0*brightness), int(red/100.0*brightness), int(blue/100.0*brightness)));
-        }
-        pixels.setPixelColor(0, pixels.Color(int(green*(t/600.0)), int(red*(t/600.0)), int(blue*(t/600.0))));
-        trailing += 0.5;
-        pixels.show();
-        vTaskDelay(1 / portTICK_PERIOD_MS);
+// Draw one frame of the program loaded for a pattern
+// return the delay in ms before the next frame, or LED_PATTERN_DONE
+int playPattern(struct LEDAnimation &anim, int frame){
+    if (anim.programLength == 0) {
+        LOG_WARN("Unrecognized LED Pattern %d", anim.pattern);
+        return LED_PATTERN_DONE;
     }
+    return led_program_frame(anim.program, frame, anim.colors[0], anim.colors[1], anim.colors[2]);
 }
 
 
-void led_flash(int red, int green, int blue){
-    // Flash Twice per call
-    for(int i=0; i<2; i++) {
-        pixels.fill(pixels.Color(green, red, blue));
-        pixels.show();
-        vTaskDelay(500 / portTICK_PERIOD_MS);
-        pixels.fill(pixels.Color(0, 0, 0));
-        pixels.show();
-        vTaskDelay(500 / portTICK_PERIOD_MS);
-    }
+// Function that pushes a led message to the queue
+// return false if the message was dropped
+// ledmessage.useprevcolor set to false
+// priority: one of LED_PRIORITY_*
+// preempt: interrupt the running pattern instead of waiting for it to finish
+bool LED_Message_queue_send(int pattern, int red, int green, int blue, bool replay,
+                            int priority = LED_PRIORITY_STATUS, bool preempt = false) {
+    struct LEDMessage msg;
+    msg.pattern = pattern;
+    msg.colors[0] = red;
+    msg.colors[1] = green;
+    msg.colors[2] = blue;
+    msg.useprevcolor = false;
+    msg.allowreplay = replay;
+    msg.preempt = preempt;
+    msg.priority = priority;
+    msg.queuedAt = micros();
+
+    return led_queue_send(msg);
 }
 
-void led_flash_fast(int red, int green, int blue){
-    // Flash Twice per call
-    for(int i=0; i<2; i++) {
-        pixels.fill(pixels.Color(green, red, blue));
-        pixels.show();
-        vTaskDelay(200 / portTICK_PERIOD_MS);
-        pixels.fill(pixels.Color(0, 0, 0));
-        pixels.show();
-        vTaskDelay(200 / portTICK_PERIOD_MS);
-    }
+// Function that pushes a led message to the queue
+// return false if the message was dropped
+// ledmessage.useprevcolor set to true
+// priority: one of LED_PRIORITY_*
+// preempt: interrupt the running pattern instead of waiting for it to finish
+bool LED_Message_queue_send(int pattern, bool replay, int priority = LED_PRIORITY_STATUS, bool preempt = false) {
+    struct LEDMessage msg;
+    msg.pattern = pattern;
+    msg.useprevcolor = true;
+    msg.allowreplay = replay;
+    msg.preempt = preempt;
+    msg.priority = priority;
+    msg.queuedAt = micros();
+
+    return led_queue_send(msg);
 }
 
-void led_persist_status_1(int red, int green, int blue){
-    float centerintensity = 0;
-    float restintensity = 0;
-
-    for(int i=0; i<100; i++) {
-        centerintensity += 1;
-        if (i > 90) restintensity += 1;
-        
-        pixels.fill(pixels.Color(int(green/100.0*restintensity), int(red/100.0*restintensity), int(blue/100.0*restintensity)));
-        pixels.setPixelColor(0,pixels.Color(int(green/100.0*centerintensity), int(red/100.0*centerintensity), int(blue/100.0*centerintensity)));
-        pixels.show();
-        vTaskDelay(8 / portTICK_PERIOD_MS);
+// Start the pattern carried by a message from its first frame
+// the message color (or previous color) is applied and remembered here
+void led_start_animation(struct LEDAnimation &anim, struct LEDMessage &msg, int previousColor[3]) {
+    if (!msg.useprevcolor) {
+        // update previous color variable with current one.
+        previousColor[0] = msg.colors[0];
+        previousColor[1] = msg.colors[1];
+        previousColor[2] = msg.colors[2];
     }
+    TRACE_INSTANT("pattern start", msg.pattern);
+    anim.pattern = msg.pattern;
+    anim.programLength = led_program_load(msg.pattern, anim.program);
+    anim.priority = msg.priority;
+    anim.colors[0] = previousColor[0];
+    anim.colors[1] = previousColor[1];
+    anim.colors[2] = previousColor[2];
+    anim.allowreplay = msg.allowreplay;
+    anim.queuedAt = msg.queuedAt;
+    anim.active = true;
+    metrics_observe(metricsLedQueueWait, micros() - msg.queuedAt);
+    anim.frame = 0;
+    anim.nextFrameAt = xTaskGetTickCount();
+#ifdef LED_PROFILE_FRAMES
+    anim.computeCycles = 0;
+#endif
 }
 
-void led_persist_status_2(int red, int green, int blue){
-    led_off();
-    for(int i=0; i<100; i++) {
-        pixels.setPixelColor(0,pixels.Color(int(green/100.0*i), int(red/100.0*i), int(blue/100.0*i)));
-        pixels.show();
-        vTaskDelay(8 / portTICK_PERIOD_MS);
+// Draw the next frame of the running pattern and schedule the one after
+void led_step_animation(struct LEDAnimation &anim) {
+    TRACE_SCOPE("led frame");
+    if (anim.frame > 0 && (int32_t)(xTaskGetTickCount() - anim.nextFrameAt) > 0) {
+        metrics_increment(metricsLedFramesLate);
     }
-}
-
-
-void playPattern(int pattern, int red, int green, int blue){
-    switch(pattern){
-        case(LED_FADEIN):           led_fade_in(red, green, blue); break;
-        case(LED_OFF):              led_off(); break;
-        case(LED_LOADING):          led_loading(red, green, blue); break;
-        case(LED_LOADING_LONG):     led_loading_long(red, green, blue); break;
-        case(LED_LOAD_IN):          led_load_in(red, green, blue); break;
-        case(LED_LOAD_OUT):         led_load_out(red, green, blue); break;
-        case(LED_BREATHE):          led_breathe_2(red, green, blue); break;
-        case(LED_CIRCLE_IN):        led_circle_in(red, green, blue); break;
-        case(LED_FLASH):            led_flash(red, green, blue); break;
-        case(LED_FLASH_FAST):       led_flash_fast(red, green, blue); break;
-        case(LED_PERSIST_STATUS_1): led_persist_status_1(red, green, blue); break;
-        case(LED_PERSIST_STATUS_2): led_persist_status_2(red, green, blue); break;
-        default:
-            Serial.println("Unrecognized LED Pattern");
+#ifdef LED_PROFILE_FRAMES
+    ledShowCycles = 0;
+    uint32_t start = ESP.getCycleCount();
+#endif
+    int wait = playPattern(anim, anim.frame);
+#ifdef PROFILE_LATENCY
+    if (anim.frame == 0 && anim.queuedAt != 0) {
+        LOG_INFO("[PROFILE] >>> pattern %d: queue to first frame %u us",
+            anim.pattern, micros() - anim.queuedAt);
+    }
+#endif
+#ifdef LED_PROFILE_FRAMES
+    anim.computeCycles += ESP.getCycleCount() - start - ledShowCycles;
+#endif
+    anim.frame++;
+    if (wait == LED_PATTERN_DONE) {
+        anim.active = false;
+#ifdef LED_PROFILE_FRAMES
+        // the last call only reports completion, it draws nothing
+        if (anim.frame > 1) {
+            LOG_INFO("[PROFILE] >>> pattern %d: %d frames, %u cycles/frame",
+                anim.pattern, anim.frame - 1, anim.computeCycles / (anim.frame - 1));
+        }
+#endif
+    } else {
+        metrics_increment(metricsLedFramesRendered);
+        anim.nextFrameAt = xTaskGetTickCount() + wait / portTICK_PERIOD_MS;
     }
 }
 
-
 /*
  * =======================================================
  * LED ring Main Task loop
  * =======================================================
  * Setup Tasks:
- * - Begin RGB Pixel LED
+ * - Start the LED output backend and its refresh timer
  * - Initialize Previous Color variable
- * - Initialize LEDmessage struct
+ * - Initialize LEDAnimation struct
  * Loop Tasks:
- * - Receive LEDMessage from the Queue
- * - If there is a mesage, play the new pattern with color defined by useprevcolor flag
- *      - Only check and update previous color in this step
- * - If there is no message, play previous pattern if allowreplay flag, with previous color
+ * - Wait for the next frame of the running pattern, watching the Queue meanwhile
+ * - If a message arrives, start its pattern right away when nothing is running,
+ *   the running pattern is a replay, the message has the preempt flag, or it
+ *   outranks the running pattern's priority.
+ *   Otherwise it waits in the queue until the running pattern finishes
+ *      - Only check and update previous color when a pattern is started
+ * - If there is no message and nothing is running, replay previous pattern if allowreplay flag, with previous color
+ * - Once ledIdleTimeout has passed without a message, switch the ring off and
+ *   stop replaying; with nothing to draw the task blocks until the next message
+ * - Draw one frame of the running pattern
  */
 
 void LED_ring_task(void * parameter) {
     // Pixel LED Start
-    pixels.begin();
     pixels.clear();
+    if (!led_output_begin(ledOutputRmt)) {
+        LOG_ERROR("LED output failed to start");
+    }
     // Variable to store previous color
     int previousColor[3] = {0, 0, 0};
-    // Instantiate LED message
+    // Instantiate LED message and animation state
     struct LEDMessage ledmessage;
-    ledmessage.pattern = LED_OFF;
-    ledmessage.colors[0] = 0;
-    ledmessage.colors[1] = 0;
-    ledmessage.colors[2] = 0;
-    ledmessage.allowreplay = false;
+    struct LEDAnimation animation;
+    animation.pattern = LED_OFF;
+    animation.programLength = 0;
+    animation.priority = LED_PRIORITY_STATUS;
+    animation.colors[0] = 0;
+    animation.colors[1] = 0;
+    animation.colors[2] = 0;
+    animation.allowreplay = false;
+    animation.active = false;
+    animation.frame = 0;
+    animation.nextFrameAt = 0;
+    animation.queuedAt = 0;
+    // Idle timeout, counted from the last message started
+    TickType_t idleTimeout = ledIdleTimeout / portTICK_PERIOD_MS;
+    TickType_t lastMessageAt = xTaskGetTickCount();
+    bool ringOff = false;     // switched off by the idle timeout
+
 
-    
     // enter loop and processing queue message
     for(;;){
-        
-        if( xLedQueue != NULL ) {
-            if( xQueueReceive( xLedQueue,&( ledmessage ),( TickType_t ) 10 ) == pdPASS ){
-                // received new message from the queue
-                if(ledmessage.useprevcolor) {
-                    // if the message indicates the use of previous color
-                    playPattern(ledmessage.pattern, previousColor[0], previousColor[1], previousColor[2]);
-                }else{
-                    // if the message did not indicate use of previous color
-                    // then use the color defined in the message
-                    playPattern(ledmessage.pattern, ledmessage.colors[0], ledmessage.colors[1], ledmessage.colors[2]);
-                    // and update precious color variable with current one.
-                    previousColor[0] = ledmessage.colors[0];
-                    previousColor[1] = ledmessage.colors[1];
-                    previousColor[2] = ledmessage.colors[2];
-                }
-            }else {
-                // did not receive new message from the queue
-                // check if we should replay current one
-                if (ledmessage.allowreplay){
-                    // then play the pattern with (maybe already updated) previousColor.
-                    playPattern(ledmessage.pattern, previousColor[0], previousColor[1], previousColor[2]);
-                }
-                // if not the led will simply remain current display status.
+        metrics_increment(metricsLedTaskWakeups);
+
+        // time left until the running pattern's next frame is due,
+        // otherwise sleep until a message arrives, the next replay or the idle timeout
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait = portMAX_DELAY;
+        if (animation.active) {
+            wait = ((int32_t)(animation.nextFrameAt - now) > 0) ? animation.nextFrameAt - now : 0;
+        } else if (!ringOff) {
+            if (idleTimeout != 0) {
+                wait = (now - lastMessageAt >= idleTimeout) ? 0 : idleTimeout - (now - lastMessageAt);
+            }
+            if (animation.allowreplay && wait > LED_IDLE_WAIT) {
+                wait = LED_IDLE_WAIT;
             }
-        }else{
-            Serial.println("[ERROR] >>> xLedQueue NULL ");
         }
-        
-    } // infinite for loop bracket
-}
-
-
-
-
-
-
-
-
-
-
 
+        if( led_queue_peek( ledmessage, wait ) ){
+            if (!animation.active || animation.allowreplay || ledmessage.preempt || ledmessage.priority > animation.priority) {
+                // received new message from the queue, it replaces the running pattern
+                led_queue_receive( ledmessage );
+                TRACE_INSTANT("led queue receive", ledmessage.pattern);
+                led_start_animation(animation, ledmessage, previousColor);
+                lastMessageAt = xTaskGetTickCount();
+                ringOff = false;
+            }else{
+                // message waits for the running pattern, keep its frame timing
+                now = xTaskGetTickCount();
+                if ((int32_t)(animation.nextFrameAt - now) > 0) {
+                    vTaskDelay(animation.nextFrameAt - now);
+                }
+            }
+        }else if (!animation.active && !ringOff && idleTimeout != 0 &&
+                  xTaskGetTickCount() - lastMessageAt >= idleTimeout){
+            // nothing new for ledIdleTimeout, stop lighting the ring
+            led_off();
+            ringOff = true;
+        }else if (!animation.active && !ringOff && animation.allowreplay){
+            // did not receive new message from the queue
+            // replay the previous pattern with (maybe already updated) previousColor.
+            animation.colors[0] = previousColor[0];
+            animation.colors[1] = previousColor[1];
+            animation.colors[2] = previousColor[2];
+            animation.active = true;
+            animation.frame = 0;
+            animation.queuedAt = 0;
+#ifdef LED_PROFILE_FRAMES
+            animation.computeCycles = 0;
+#endif
+        }
+        // if nothing is running the led will simply remain current display status.
 
+        if (animation.active) {
+            led_step_animation(animation);
+        }
 
- 
+    } // infinite for loop bracket
+}
@@ -0,0 +1,168 @@
+// ==================================================================
+// Code containing deferred logging
+// ==================================================================
+// LOG_ERROR/LOG_WARN/LOG_INFO/LOG_DEBUG format a line into a ring of
+// fixed slots and return; a low priority task writes the lines to the
+// serial port afterwards, so no caller waits on the UART. Levels above
+// LOG_LEVEL compile to nothing, arguments included.
+// Producers claim a slot with a compare-and-swap on the head and
+// publish it by stamping its sequence number, the drain task is the
+// only consumer. A full ring drops the new line and counts it.
+// The drain task keeps the last LOG_HISTORY lines for /log.
+// Not for interrupt handlers or critical sections (gives a semaphore).
+
+// Levels
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Build with e.g. -DLOG_LEVEL=LOG_LEVEL_DEBUG to see more
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_LINE_MAX 120        // longer lines are cut
+#define LOG_SLOTS 32            // lines waiting for the serial port (power of 2)
+#define LOG_HISTORY 32          // lines kept for /log
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) log_write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) log_write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) log_write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) log_write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+struct LogLine {
+    uint32_t sequence;      // slot index + 1 once the line is complete
+    uint32_t at;            // millis()
+    uint8_t level;
+    char text[LOG_LINE_MAX];
+};
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+LogLine logSlots[LOG_SLOTS];
+uint32_t logHead = 0;           // next slot index to claim
+uint32_t logTail = 0;           // next slot index to drain, only written by the drain task
+// Given after every line to wake the drain task
+SemaphoreHandle_t xLogSignal = NULL;
+
+// Lines already written to the serial port, newest at logHistoryNext - 1
+LogLine logHistory[LOG_HISTORY];
+uint32_t logHistoryNext = 0;
+portMUX_TYPE logHistoryMux = portMUX_INITIALIZER_UNLOCKED;
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+const char *log_level_prefix(int level) {
+    switch (level) {
+        case LOG_LEVEL_ERROR: return "[ERROR] >>> ";
+        case LOG_LEVEL_WARN:  return "[WARN] >>> ";
+        default:              return "";
+    }
+}
+
+// Format a line into the ring, never blocks
+// use the LOG_* macros so disabled levels compile away
+void log_write(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void log_write(int level, const char *format, ...) {
+    uint32_t head = __atomic_load_n(&logHead, __ATOMIC_RELAXED);
+    do {
+        if (head - __atomic_load_n(&logTail, __ATOMIC_ACQUIRE) >= LOG_SLOTS) {
+            metrics_increment(metricsLogDropped);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&logHead, &head, head + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    LogLine &line = logSlots[head % LOG_SLOTS];
+    line.at = millis();
+    line.level = level;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line.text, LOG_LINE_MAX, format, args);
+    va_end(args);
+    __atomic_store_n(&line.sequence, head + 1, __ATOMIC_RELEASE);
+
+    if (xLogSignal != NULL) xSemaphoreGive(xLogSignal);
+}
+
+// Copy the kept lines, oldest first, to out as "<ms> <line>"
+void log_print_history(Print &out) {
+    portENTER_CRITICAL(&logHistoryMux);
+    uint32_t first = logHistoryNext - LOG_HISTORY;
+    portEXIT_CRITICAL(&logHistoryMux);
+    for (uint32_t index = first; index != first + LOG_HISTORY; index++) {
+        LogLine line;
+        portENTER_CRITICAL(&logHistoryMux);
+        // skip lines replaced since this call started
+        bool kept = logHistoryNext - index <= LOG_HISTORY;
+        if (kept) line = logHistory[index % LOG_HISTORY];
+        portEXIT_CRITICAL(&logHistoryMux);
+        if (!kept || line.sequence == 0) continue;
+        out.printf("%u %s%s\n", line.at, log_level_prefix(line.level), line.text);
+    }
+}
+
+/*
+ * =======================================================
+ * Log drain Task loop
+ * =======================================================
+ * - Wait until a line is published
+ * - Write every complete line to the serial port in order and keep it for /log
+ * - Free the slot only afterwards, so producers never overwrite a line being read
+ */
+void log_drain_task(void * parameter) {
+    for (;;) {
+        xSemaphoreTake(xLogSignal, portMAX_DELAY);
+        for (;;) {
+            LogLine &line = logSlots[logTail % LOG_SLOTS];
+            if (__atomic_load_n(&line.sequence, __ATOMIC_ACQUIRE) != logTail + 1) {
+                // next line not claimed yet, or still being formatted
+                break;
+            }
+            Serial.print(log_level_prefix(line.level));
+            Serial.println(line.text);
+
+            portENTER_CRITICAL(&logHistoryMux);
+            logHistory[logHistoryNext % LOG_HISTORY] = line;
+            logHistoryNext++;
+            portEXIT_CRITICAL(&logHistoryMux);
+
+            __atomic_store_n(&logTail, logTail + 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+// Start the drain task, lines logged before are kept and written then
+// return false if it could not be started
+bool log_init() {
+    xLogSignal = xSemaphoreCreateBinary();
+    if (xLogSignal != NULL) xSemaphoreGive(xLogSignal);
+    return xLogSignal != NULL && task_create(TASK_LOG_DRAIN, log_drain_task);
+}
@@ -0,0 +1,99 @@
+// ==================================================================
+// Code containing runtime counters and latency histograms
+// ==================================================================
+// All updates are single atomic adds (no locks, no allocation), so they
+// can be recorded from the web server, timer and LED tasks alike.
+// handleMetrics in the main sketch exposes them as Prometheus text.
+
+// Histogram bucket upper bounds in microseconds, an implicit +Inf bucket follows
+#define METRICS_BUCKETS 12
+const uint32_t metricsBucketBounds[METRICS_BUCKETS] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+
+// Fixed-bucket histogram of durations in microseconds
+// sum wraps after ~71 minutes of accumulated time, scrapers treat that as a reset
+struct MetricsHistogram {
+    uint32_t counts[METRICS_BUCKETS + 1];
+    uint32_t sum;
+};
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+MetricsHistogram metricsRelayEdgeLatency = {};   // relay request to relay edge
+MetricsHistogram metricsLedQueueWait = {};       // LED message sent to its pattern starting
+MetricsHistogram metricsSequenceJitter = {};     // sequence edge against its scheduled time
+// Command to acknowledgement as measured by the control page, reported with its next command
+MetricsHistogram metricsControlRoundTripWs = {};
+MetricsHistogram metricsControlRoundTripHttp = {};
+
+uint32_t metricsLedFramesRendered = 0;
+uint32_t metricsLedFramesLate = 0;               // frames drawn at least one tick after they were due
+uint32_t metricsLedFramesSent = 0;               // frames sent to the ring by the refresh timer
+uint32_t metricsLedFramesSkipped = 0;            // frames replaced by a newer one before they were sent
+uint32_t metricsLedMessagesDropped = 0;          // LED messages dropped because the queue was full
+uint32_t metricsLedMessagesCoalesced = 0;        // waiting status messages replaced by a newer message
+uint32_t metricsLedQueueHighWater = 0;           // most LED messages waiting at once
+uint32_t metricsAdmissionRejectedClient = 0;     // control requests refused with 429, client bucket empty
+uint32_t metricsAdmissionRejectedGlobal = 0;     // control requests refused with 429, global bucket empty
+uint32_t metricsAdmissionConflicts = 0;          // control requests refused with 409 by the relay state
+uint32_t metricsAdmissionReplays = 0;            // control requests answered from a stored idempotency key
+uint32_t metricsLogDropped = 0;                  // log lines dropped because the ring was full
+
+// Wake-ups of the periodic work, rate() of these is the idle wake-up rate
+uint32_t metricsLedTaskWakeups = 0;              // LED task loop passes
+uint32_t metricsLedRefreshWakeups = 0;           // LED refresh timer ticks
+uint32_t metricsHousekeepingWakeups = 0;         // housekeeping timer ticks
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+inline void metrics_increment(uint32_t &counter) {
+    __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+}
+
+// Raise a gauge to value if it is the highest seen so far
+inline void metrics_update_max(uint32_t &gauge, uint32_t value) {
+    uint32_t current = __atomic_load_n(&gauge, __ATOMIC_RELAXED);
+    while (value > current &&
+           !__atomic_compare_exchange_n(&gauge, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Record a duration in microseconds
+void metrics_observe(MetricsHistogram &histogram, uint32_t micros) {
+    int bucket = 0;
+    while (bucket < METRICS_BUCKETS && micros > metricsBucketBounds[bucket]) {
+        bucket++;
+    }
+    __atomic_fetch_add(&histogram.counts[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram.sum, micros, __ATOMIC_RELAXED);
+}
+
+// Print one counter or gauge in Prometheus text format
+void metrics_print_value(Print &out, const char *name, const char *type, const char *help, uint32_t value) {
+    out.printf("# HELP %s %s\n# TYPE %s %s\n%s %u\n", name, help, name, type, name, value);
+}
+
+// Print a histogram in Prometheus text format, in seconds
+void metrics_print_histogram(Print &out, const char *name, const char *help, MetricsHistogram &histogram) {
+    out.printf("# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    uint32_t cumulative = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        cumulative += __atomic_load_n(&histogram.counts[i], __ATOMIC_RELAXED);
+        out.printf("%s_bucket{le=\"%g\"} %u\n", name, metricsBucketBounds[i] / 1e6, cumulative);
+    }
+    cumulative += __atomic_load_n(&histogram.counts[METRICS_BUCKETS], __ATOMIC_RELAXED);
+    out.printf("%s_bucket{le=\"+Inf\"} %u\n", name, cumulative);
+    out.printf("%s_sum %g\n", name, __atomic_load_n(&histogram.sum, __ATOMIC_RELAXED) / 1e6);
+    out.printf("%s_count %u\n", name, cumulative);
+}
@@ -0,0 +1,375 @@
+// ==================================================================
+// Code containing the firmware update over HTTP (/update)
+// ==================================================================
+// The image is streamed from the request body into the inactive OTA
+// partition as it arrives: each body chunk goes through one static
+// sector buffer and a SHA-256, so the transfer needs no heap beyond the
+// TCP buffers however large the image is. Flash is erased one sector
+// ahead of the write (OTA_WITH_SEQUENTIAL_WRITES) instead of the whole
+// partition up front, which keeps every flash stall of the LED task and
+// the relay timer to one sector erase.
+// Once the digest and the image check pass, the new partition is set
+// to boot and the device restarts into a trial: the new image has to
+// reach a Wi-Fi connection within OTA_TRIAL_TIMEOUT and
+// OTA_TRIAL_BOOTS boots, otherwise the previous image is booted again.
+// The trial is kept in NVS, so it works with or without the
+// bootloader's own rollback; with it, a crash before setup() rolls
+// back as well.
+
+#include <Preferences.h>
+#include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
+
+#define OTA_SECTOR_SIZE 4096        // flash sector, written in one go
+#define OTA_RESTART_DELAY 1000      // restart this long after a finished update (ms)
+#define OTA_TRIAL_TIMEOUT 120000    // a new image must connect this soon after boot (ms)
+#define OTA_TRIAL_BOOTS 3           // boots a new image may take to connect
+#define OTA_NAMESPACE "ota"
+
+// Upload states
+#define OTA_IDLE 0
+#define OTA_RECEIVING 1
+#define OTA_DONE 2
+#define OTA_FAILED 3
+
+// The running upload, one at a time
+struct OtaUpload {
+    int state;
+    AsyncWebServerRequest *owner;   // request sending the image, NULL if none
+    const esp_partition_t *partition;
+    esp_ota_handle_t handle;
+    bool open;                      // handle not yet ended or aborted
+    mbedtls_sha256_context sha;
+    uint8_t expected[32];           // digest given with the request
+    size_t fill;                    // bytes waiting in otaSector
+    size_t received;
+    uint32_t startedAt;             // millis()
+    uint32_t heapBefore;            // free heap when the upload started
+    uint32_t heapLowest;            // lowest free heap seen during the upload
+    int status;                     // HTTP answer once state is OTA_DONE or OTA_FAILED
+    const char *message;
+};
+
+// Outcome of the last upload, for GET /update and /metrics
+struct OtaStats {
+    const char *result;             // NULL if there was none since boot
+    uint32_t bytes;
+    uint32_t duration;              // ms
+    uint32_t throughput;            // bytes per second
+    uint32_t heapUsed;              // bytes, peak drop of the free heap during the upload
+};
+
+// Trial of a new image, kept in NVS across restarts
+struct OtaTrial {
+    bool valid;
+    char image[17];                 // label of the partition on trial
+    char previous[17];              // label of the partition it replaced
+    uint8_t boots;                  // boots of the new image so far
+};
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+OtaUpload otaUpload;
+uint8_t otaSector[OTA_SECTOR_SIZE];
+OtaStats otaStats;
+OtaTrial otaTrial;
+bool otaTrialRunning = false;       // running image is on trial since this boot
+unsigned long otaRestartAt = 0;     // millis() of a pending restart, 0 if none
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+// Keep the Arduino core from confirming a new image at boot (bootloader
+// rollback builds), ota_confirm() does that once Wi-Fi is up
+extern "C" bool verifyRollbackLater() {
+    return buildOta;
+}
+
+void ota_trial_store() {
+    Preferences prefs;
+    prefs.begin(OTA_NAMESPACE, false);
+    if (otaTrial.valid) {
+        prefs.putBytes("trial", &otaTrial, sizeof(otaTrial));
+    } else {
+        prefs.remove("trial");
+    }
+    prefs.end();
+}
+
+// Boot the image a trial replaced
+void ota_rollback() {
+    const esp_partition_t *previous = esp_partition_find_first(ESP_PARTITION_TYPE_APP,
+                                                               ESP_PARTITION_SUBTYPE_ANY, otaTrial.previous);
+    if (previous == NULL || esp_ota_set_boot_partition(previous) != ESP_OK) {
+        LOG_ERROR("rollback to %s failed, keeping %s", otaTrial.previous, otaTrial.image);
+        otaTrial.valid = false;
+        ota_trial_store();
+        otaTrialRunning = false;
+        return;
+    }
+    LOG_ERROR("image %s did not connect, rolling back to %s", otaTrial.image, otaTrial.previous);
+    otaRestartAt = millis() + OTA_RESTART_DELAY;
+}
+
+// Count a boot of an image on trial, called once from setup()
+void ota_init() {
+    Preferences prefs;
+    prefs.begin(OTA_NAMESPACE, true);
+    otaTrial.valid = prefs.getBytes("trial", &otaTrial, sizeof(otaTrial)) == sizeof(otaTrial) && otaTrial.valid;
+    prefs.end();
+    if (!otaTrial.valid) {
+        return;
+    }
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (strcmp(running->label, otaTrial.image) != 0) {
+        // the bootloader or ota_rollback() went back already
+        LOG_ERROR("update to %s was rolled back, running %s", otaTrial.image, running->label);
+        otaStats.result = "ROLLED BACK";
+        otaTrial.valid = false;
+        ota_trial_store();
+        return;
+    }
+    otaTrial.boots++;
+    ota_trial_store();
+    otaTrialRunning = true;
+    LOG_INFO("image %s on trial, boot %d of %d", otaTrial.image, otaTrial.boots, OTA_TRIAL_BOOTS);
+    if (otaTrial.boots > OTA_TRIAL_BOOTS) {
+        ota_rollback();
+    }
+}
+
+// The running image reached the network, keep it
+void ota_confirm() {
+    if (!otaTrialRunning || otaRestartAt != 0) {
+        return;
+    }
+    esp_ota_mark_app_valid_cancel_rollback();
+    otaTrialRunning = false;
+    otaTrial.valid = false;
+    ota_trial_store();
+    LOG_INFO("image %s confirmed", esp_ota_get_running_partition()->label);
+}
+
+// Trial timeout and pending restart, called from the housekeeping timer
+void ota_housekeeping() {
+    if (otaTrialRunning && otaRestartAt == 0 && millis() > OTA_TRIAL_TIMEOUT) {
+        ota_rollback();
+    }
+    if (otaRestartAt != 0 && (long)(millis() - otaRestartAt) >= 0) {
+        ESP.restart();
+    }
+}
+
+// End the running upload with an HTTP answer, abandoning the partition if it failed
+void ota_upload_finish(int status, const char *message) {
+    if (otaUpload.open) {
+        esp_ota_abort(otaUpload.handle);
+        otaUpload.open = false;
+    }
+    if (otaUpload.state == OTA_RECEIVING) {
+        mbedtls_sha256_free(&otaUpload.sha);
+        uint32_t duration = millis() - otaUpload.startedAt;
+        otaStats.result = message;
+        otaStats.bytes = otaUpload.received;
+        otaStats.duration = duration;
+        otaStats.throughput = duration > 0 ? (uint32_t)((uint64_t)otaUpload.received * 1000 / duration) : 0;
+        otaStats.heapUsed = otaUpload.heapBefore - otaUpload.heapLowest;
+        LOG_INFO("update %s: %u bytes in %u ms (%u bytes/s), heap use %u bytes", message,
+            otaStats.bytes, otaStats.duration, otaStats.throughput, otaStats.heapUsed);
+    }
+    otaUpload.state = status == 200 ? OTA_DONE : OTA_FAILED;
+    otaUpload.status = status;
+    otaUpload.message = message;
+}
+
+// Parse 64 hex digits into digest
+bool ota_parse_digest(const String &text, uint8_t *digest) {
+    if (text.length() != 64) {
+        return false;
+    }
+    for (int i = 0; i < 64; i++) {
+        char c = text[i];
+        int nibble = (c >= '0' && c <= '9') ? c - '0' :
+                     (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                     (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (nibble < 0) return false;
+        digest[i / 2] = (i % 2 == 0) ? nibble << 4 : digest[i / 2] | nibble;
+    }
+    return true;
+}
+
+// Claim the upload for request and open the inactive partition
+// total: image size from Content-Length
+void ota_upload_begin(AsyncWebServerRequest *request, size_t total) {
+    otaUpload.owner = request;
+    otaUpload.state = OTA_IDLE;
+    otaUpload.open = false;
+    if (!request->hasParam("sha256") || !ota_parse_digest(request->getParam("sha256")->value(), otaUpload.expected)) {
+        ota_upload_finish(400, "INVALID SHA256");
+        return;
+    }
+    otaUpload.partition = esp_ota_get_next_update_partition(NULL);
+    if (otaUpload.partition == NULL) {
+        ota_upload_finish(500, "NO OTA PARTITION");
+        return;
+    }
+    if (total > otaUpload.partition->size) {
+        ota_upload_finish(413, "IMAGE TOO LARGE");
+        return;
+    }
+    if (esp_ota_begin(otaUpload.partition, OTA_WITH_SEQUENTIAL_WRITES, &otaUpload.handle) != ESP_OK) {
+        ota_upload_finish(500, "OTA BEGIN FAILED");
+        return;
+    }
+    otaUpload.open = true;
+    mbedtls_sha256_init(&otaUpload.sha);
+    mbedtls_sha256_starts_ret(&otaUpload.sha, 0);
+    otaUpload.state = OTA_RECEIVING;
+    otaUpload.fill = 0;
+    otaUpload.received = 0;
+    otaUpload.startedAt = millis();
+    otaUpload.heapBefore = ESP.getFreeHeap();
+    otaUpload.heapLowest = otaUpload.heapBefore;
+    LOG_INFO("update: receiving %u bytes into %s", (unsigned)total, otaUpload.partition->label);
+}
+
+// Write the buffered sector, or the partial one at the end
+bool ota_upload_flush() {
+    if (otaUpload.fill == 0) {
+        return true;
+    }
+    esp_err_t result = esp_ota_write(otaUpload.handle, otaSector, otaUpload.fill);
+    otaUpload.fill = 0;
+    return result == ESP_OK;
+}
+
+// Feed one body chunk of the running upload
+void ota_upload_write(const uint8_t *data, size_t length) {
+    mbedtls_sha256_update_ret(&otaUpload.sha, data, length);
+    otaUpload.received += length;
+    while (length > 0) {
+        size_t n = min(length, (size_t)(OTA_SECTOR_SIZE - otaUpload.fill));
+        memcpy(otaSector + otaUpload.fill, data, n);
+        otaUpload.fill += n;
+        data += n;
+        length -= n;
+        if (otaUpload.fill == OTA_SECTOR_SIZE && !ota_upload_flush()) {
+            ota_upload_finish(500, "FLASH WRITE FAILED");
+            return;
+        }
+    }
+    uint32_t heap = ESP.getFreeHeap();
+    if (heap < otaUpload.heapLowest) {
+        otaUpload.heapLowest = heap;
+    }
+}
+
+// Whole image received: check it and make it the boot image
+void ota_upload_complete() {
+    if (!ota_upload_flush()) {
+        ota_upload_finish(500, "FLASH WRITE FAILED");
+        return;
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&otaUpload.sha, digest);
+    if (memcmp(digest, otaUpload.expected, sizeof(digest)) != 0) {
+        ota_upload_finish(400, "SHA256 MISMATCH");
+        return;
+    }
+    // esp_ota_end releases the handle whatever it returns
+    esp_err_t result = esp_ota_end(otaUpload.handle);
+    otaUpload.open = false;
+    if (result != ESP_OK) {
+        ota_upload_finish(400, result == ESP_ERR_OTA_VALIDATE_FAILED ? "INVALID IMAGE" : "OTA END FAILED");
+        return;
+    }
+    if (esp_ota_set_boot_partition(otaUpload.partition) != ESP_OK) {
+        ota_upload_finish(500, "SET BOOT PARTITION FAILED");
+        return;
+    }
+    otaTrial.valid = true;
+    snprintf(otaTrial.image, sizeof(otaTrial.image), "%s", otaUpload.partition->label);
+    snprintf(otaTrial.previous, sizeof(otaTrial.previous), "%s", esp_ota_get_running_partition()->label);
+    otaTrial.boots = 0;
+    ota_trial_store();
+    ota_upload_finish(200, "UPDATED, RESTARTING");
+    otaRestartAt = millis() + OTA_RESTART_DELAY;
+}
+
+// The request sending the image went away before it was answered
+void ota_upload_abort(AsyncWebServerRequest *request) {
+    if (otaUpload.owner != request) {
+        return;
+    }
+    if (otaUpload.state == OTA_RECEIVING) {
+        ota_upload_finish(400, "ABORTED");
+    }
+    otaUpload.owner = NULL;
+}
+
+// Firmware update (admin only)
+// POST: the application image as the request body (Content-Type: application/octet-stream)
+//   url parameter "sha256": SHA-256 of the image in hex
+//   answers once the image is written and checked, then restarts into it
+// GET: running and boot partition, trial and the last upload as JSON
+void handleUpdate(AsyncWebServerRequest *request) {
+    if (!request->authenticate("admin", adminPassword)) {
+        return request->requestAuthentication();
+    }
+
+    if (request->method() == HTTP_GET) {
+        char json[384];
+        snprintf(json, sizeof(json),
+            "{\"running\":\"%s\",\"boot\":\"%s\",\"trial\":%s,\"receiving\":%s,"
+            "\"last\":{\"result\":\"%s\",\"bytes\":%u,\"duration_ms\":%u,\"throughput_bytes_per_second\":%u,\"heap_used_bytes\":%u}}",
+            esp_ota_get_running_partition()->label, esp_ota_get_boot_partition()->label,
+            otaTrialRunning ? "true" : "false", otaUpload.state == OTA_RECEIVING ? "true" : "false",
+            otaStats.result != NULL ? otaStats.result : "", otaStats.bytes, otaStats.duration,
+            otaStats.throughput, otaStats.heapUsed);
+        request->send(200, "application/json", json);
+        return;
+    }
+
+    // POST, body streamed by handleUpdateBody
+    if (otaUpload.owner != request) {
+        if (otaUpload.owner != NULL || otaRestartAt != 0) {
+            request->send_P(409, "text/plain", "UPDATE RUNNING");
+        } else {
+            request->send_P(400, "text/plain", "NO IMAGE");
+        }
+        return;
+    }
+    if (otaUpload.state == OTA_RECEIVING) {
+        // request handled before the last chunk arrived
+        ota_upload_finish(400, "INCOMPLETE IMAGE");
+    }
+    request->send_P(otaUpload.status, "text/plain", otaUpload.message);
+    otaUpload.owner = NULL;
+}
+
+// Streams a /update body into flash, runs in the async_tcp task for every chunk
+void handleUpdateBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    if (index == 0) {
+        if (!request->authenticate("admin", adminPassword) || otaUpload.owner != NULL || otaRestartAt != 0) {
+            return;
+        }
+        ota_upload_begin(request, total);
+        request->onDisconnect([request]() { ota_upload_abort(request); });
+    }
+    if (otaUpload.owner != request || otaUpload.state != OTA_RECEIVING) {
+        return;
+    }
+    ota_upload_write(data, len);
+    if (otaUpload.state == OTA_RECEIVING && index + len == total) {
+        ota_upload_complete();
+    }
+}
@@ -0,0 +1,336 @@
+// ==================================================================
+// Code containing the software relays and their pulse scheduler
+// ==================================================================
+// Pulses are started from the web server callbacks and ended by an
+// esp_timer, so a request returns as soon as its pulse is scheduled
+// instead of holding the AsyncTCP task for the whole pulse width.
+// Every channel (relayPins in wireless_config.h) has its own state,
+// pulse queue and timer. Calls take a mask of channels; the edges of
+// all channels switched together are one write to the GPIO output
+// register, and a timer that fires ends every pulse due by then in one
+// write as well. Channels pulsed together share one deadline, so their
+// release edges are one write too: the channels switch within the same
+// register write and there is no skew between them left to measure.
+
+#include "esp_timer.h"
+#include "soc/gpio_struct.h"
+
+// Channels, from relayPins in wireless_config.h
+#define RELAY_CHANNELS ((int)(sizeof(relayPins) / sizeof(relayPins[0])))
+#define RELAY_CHANNEL(ch) (1UL << (ch))
+#define RELAY_ALL_CHANNELS ((uint32_t)((1ULL << RELAY_CHANNELS) - 1))
+
+// Pulse limits (ms)
+#define RELAY_PULSE_MAX_MS 6000
+#define RELAY_PULSE_GAP_MS 100      // release time between two queued pulses
+#define RELAY_PULSE_QUEUE_LENGTH 4  // pulses allowed to wait behind the running one
+
+// Policy for a click that arrives while a pulse is running
+// (single channel only, a click on several channels needs all of them idle)
+#define RELAY_POLICY_EXTEND 0   // restart the running pulse with the new width
+#define RELAY_POLICY_QUEUE 1    // play the new pulse after the running one
+#define RELAY_POLICY_REJECT 2   // refuse the new pulse
+#define RELAY_OVERLAP_POLICY RELAY_POLICY_QUEUE
+
+// Relay states and what the requests do in them, per channel
+//               click                  hold / release
+//   IDLE        start pulse            HELD / no-op
+//   PULSING     queue (or per policy)  HELD / IDLE, queue dropped
+//   GAP         queue                  HELD / IDLE, queue dropped
+//   HELD        busy                   no-op / IDLE
+//   SEQUENCE    busy                   HELD / IDLE, sequence stopped
+#define RELAY_IDLE 0
+#define RELAY_PULSING 1
+#define RELAY_GAP 2
+#define RELAY_HELD 3
+#define RELAY_SEQUENCE 4        // timeline played by the sequencer on channel 0 (sequence_task.h)
+
+// relay_pulse() results
+#define RELAY_PULSE_STARTED 0
+#define RELAY_PULSE_EXTENDED 1
+#define RELAY_PULSE_QUEUED 2
+#define RELAY_PULSE_BUSY 3
+
+struct RelayChannel {
+    uint32_t pinMask;       // bit of the channel's GPIO in the output register
+    int state;
+    esp_timer_handle_t timer;
+    int64_t deadline;       // esp_timer time the armed timer is meant to fire at
+    // Pulse widths waiting behind the running pulse (RELAY_POLICY_QUEUE)
+    // and micros() when each was requested
+    int pending[RELAY_PULSE_QUEUE_LENGTH];
+    uint32_t pendingAt[RELAY_PULSE_QUEUE_LENGTH];
+    int pendingHead;
+    int pendingCount;
+};
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+RelayChannel relayChannels[RELAY_CHANNELS];
+SemaphoreHandle_t xRelayMutex = NULL;
+
+// Cancels a running timeline, defined in sequence_task.h
+void sequence_stop_locked();
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ * All relay_*_locked functions expect xRelayMutex to be held.
+ * LED feedback is always sent after the mutex is released.
+ */
+
+// Set or clear the relays of all channels in the mask with one register write
+void relay_write_locked(uint32_t channels, bool engage) {
+    uint32_t pins = 0;
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        if (channels & RELAY_CHANNEL(ch)) pins |= relayChannels[ch].pinMask;
+    }
+    if (engage) {
+        GPIO.out_w1ts = pins;
+    } else {
+        GPIO.out_w1tc = pins;
+    }
+    TRACE_INSTANT(engage ? "relay on" : "relay off", channels);
+}
+
+// Arm the channel's timer to fire ms after from (esp_timer time)
+// channels armed with the same from and ms end in the same timer callback
+void relay_arm_timer_locked(RelayChannel &channel, int ms, int64_t from) {
+    esp_timer_stop(channel.timer); // returns an error if not running, ignored
+    channel.deadline = from + (int64_t)ms * 1000;
+    int64_t remaining = channel.deadline - esp_timer_get_time();
+    esp_timer_start_once(channel.timer, remaining > 0 ? remaining : 0);
+}
+
+// Start a pulse of width ms on every channel in the mask
+// requestAt: micros() when the pulse was requested
+void relay_begin_pulse_locked(uint32_t channels, int width, uint32_t requestAt) {
+    relay_write_locked(channels, true);
+    metrics_observe(metricsRelayEdgeLatency, micros() - requestAt);
+#ifdef PROFILE_LATENCY
+    LOG_INFO("[PROFILE] >>> relay: request to edge %u us", micros() - requestAt);
+#endif
+    int64_t from = esp_timer_get_time();
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        if (!(channels & RELAY_CHANNEL(ch))) continue;
+        relayChannels[ch].state = RELAY_PULSING;
+        relay_arm_timer_locked(relayChannels[ch], width, from);
+    }
+}
+
+// Cancel queued pulses and a running sequence on every channel in the mask
+void relay_clear_pending_locked(uint32_t channels) {
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        if (!(channels & RELAY_CHANNEL(ch))) continue;
+        RelayChannel &channel = relayChannels[ch];
+        esp_timer_stop(channel.timer);
+        if (channel.state == RELAY_SEQUENCE) sequence_stop_locked();
+        channel.pendingHead = 0;
+        channel.pendingCount = 0;
+    }
+}
+
+// esp_timer callback, runs in the esp_timer task
+// ends every pulse that is due and starts the next queued one after a release gap
+void relay_timer_callback(void * arg) {
+    uint32_t ended = 0;
+    uint32_t started = 0;
+
+    xSemaphoreTake(xRelayMutex, portMAX_DELAY);
+    // read after taking the mutex, timers re-armed meanwhile are not due
+    int64_t now = esp_timer_get_time();
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        RelayChannel &channel = relayChannels[ch];
+        if (channel.deadline > now) continue;
+        if (channel.state == RELAY_PULSING) {
+            ended |= RELAY_CHANNEL(ch);
+        } else if (channel.state == RELAY_GAP) {
+            started |= RELAY_CHANNEL(ch);
+        }
+    }
+    if (ended != 0) {
+        relay_write_locked(ended, false);
+    }
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        RelayChannel &channel = relayChannels[ch];
+        if (ended & RELAY_CHANNEL(ch)) {
+            // the channel's own timer may still fire, it then finds nothing due
+            if (channel.pendingCount > 0) {
+                channel.state = RELAY_GAP;
+                relay_arm_timer_locked(channel, RELAY_PULSE_GAP_MS, now);
+            } else {
+                channel.state = RELAY_IDLE;
+            }
+        } else if (started & RELAY_CHANNEL(ch)) {
+            int width = channel.pending[channel.pendingHead];
+            uint32_t requestAt = channel.pendingAt[channel.pendingHead];
+            channel.pendingHead = (channel.pendingHead + 1) % RELAY_PULSE_QUEUE_LENGTH;
+            channel.pendingCount--;
+            relay_begin_pulse_locked(RELAY_CHANNEL(ch), width, requestAt);
+        }
+    }
+    bool idle = true;
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        if (relayChannels[ch].state != RELAY_IDLE) idle = false;
+    }
+    xSemaphoreGive(xRelayMutex);
+
+    if (ended != 0) {
+        LED_Message_queue_send(LED_LOAD_OUT, 0, 40, 40, false, LED_PRIORITY_ACTUATION, true);
+        // return to normal status indicator
+        if (idle) LED_Message_queue_send(LED_PERSIST_STATUS_2, 100, 20, 0, false);
+    }
+    if (started != 0) {
+        LED_Message_queue_send(LED_CIRCLE_IN, 0, 40, 40, false, LED_PRIORITY_ACTUATION, true);
+    }
+}
+
+// Set up relay pins, lock and pulse timers
+// return false if a pin cannot be driven or a timer could not be created
+bool relay_init() {
+    xRelayMutex = xSemaphoreCreateMutex();
+    if (xRelayMutex == NULL) {
+        return false;
+    }
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        RelayChannel &channel = relayChannels[ch];
+        // all channels share the output register of GPIO 0-31
+        if (relayPins[ch] >= 32) {
+            return false;
+        }
+        pinMode(relayPins[ch], OUTPUT);
+        digitalWrite(relayPins[ch], LOW);
+        channel.pinMask = 1UL << relayPins[ch];
+        channel.state = RELAY_IDLE;
+
+        esp_timer_create_args_t timerArgs;
+        timerArgs.callback = relay_timer_callback;
+        timerArgs.arg = NULL;
+        timerArgs.dispatch_method = ESP_TIMER_TASK;
+        timerArgs.name = "relay_pulse";
+        if (esp_timer_create(&timerArgs, &channel.timer) != ESP_OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Schedule a pulse of width ms on the channels in the mask, returns immediately
+// a pulse on several channels starts only if all of them are idle
+// return one of RELAY_PULSE_* results
+int relay_pulse(uint32_t channels, int width) {
+    int result = RELAY_PULSE_BUSY;
+    uint32_t requestAt = micros();
+    channels &= RELAY_ALL_CHANNELS;
+
+    xSemaphoreTake(xRelayMutex, portMAX_DELAY);
+    bool idle = channels != 0;
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        if ((channels & RELAY_CHANNEL(ch)) && relayChannels[ch].state != RELAY_IDLE) idle = false;
+    }
+    if (idle) {
+        relay_begin_pulse_locked(channels, width, requestAt);
+        result = RELAY_PULSE_STARTED;
+    } else if ((channels & (channels - 1)) == 0 && channels != 0) {
+        RelayChannel &channel = relayChannels[__builtin_ctz(channels)];
+        if (channel.state == RELAY_PULSING || channel.state == RELAY_GAP) {
+#if RELAY_OVERLAP_POLICY == RELAY_POLICY_EXTEND
+            if (channel.state == RELAY_PULSING) {
+                relay_arm_timer_locked(channel, width, esp_timer_get_time());
+                result = RELAY_PULSE_EXTENDED;
+            }
+#elif RELAY_OVERLAP_POLICY == RELAY_POLICY_QUEUE
+            if (channel.pendingCount < RELAY_PULSE_QUEUE_LENGTH) {
+                int slot = (channel.pendingHead + channel.pendingCount) % RELAY_PULSE_QUEUE_LENGTH;
+                channel.pending[slot] = width;
+                channel.pendingAt[slot] = requestAt;
+                channel.pendingCount++;
+                result = RELAY_PULSE_QUEUED;
+            }
+#endif
+        }
+    }
+    xSemaphoreGive(xRelayMutex);
+
+    // Display animation, interrupting whatever is shown so feedback is immediate
+    if (result == RELAY_PULSE_STARTED) LED_Message_queue_send(LED_CIRCLE_IN, 0, 40, 40, false, LED_PRIORITY_ACTUATION, true);
+    return result;
+}
+
+// Relay state of a channel for status reports, read without the lock
+const char *relay_state_name(int channel) {
+    switch (relayChannels[channel].state) {
+        case RELAY_PULSING:  return "pulsing";
+        case RELAY_GAP:      return "gap";
+        case RELAY_HELD:     return "held";
+        case RELAY_SEQUENCE: return "sequence";
+        default:             return "idle";
+    }
+}
+
+// Engage the channels in the mask until relay_release(), cancels their
+// scheduled pulses or sequence
+// return false if all of them were already held (nothing changes then)
+bool relay_hold(uint32_t channels) {
+    uint32_t requestAt = micros();
+    channels &= RELAY_ALL_CHANNELS;
+    xSemaphoreTake(xRelayMutex, portMAX_DELAY);
+    uint32_t changed = 0;
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        if ((channels & RELAY_CHANNEL(ch)) && relayChannels[ch].state != RELAY_HELD) changed |= RELAY_CHANNEL(ch);
+    }
+    if (changed == 0) {
+        xSemaphoreGive(xRelayMutex);
+        return false;
+    }
+    relay_clear_pending_locked(changed);
+    relay_write_locked(changed, true);
+    metrics_observe(metricsRelayEdgeLatency, micros() - requestAt);
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        if (changed & RELAY_CHANNEL(ch)) relayChannels[ch].state = RELAY_HELD;
+    }
+    xSemaphoreGive(xRelayMutex);
+
+    // Display animation
+    LED_Message_queue_send(LED_CIRCLE_IN, 0, 40, 40, false, LED_PRIORITY_ACTUATION, true);
+    return true;
+}
+
+// Disengage the channels in the mask, cancels their scheduled pulses or sequence
+// return false if all of them were already idle (nothing changes then)
+bool relay_release(uint32_t channels) {
+    channels &= RELAY_ALL_CHANNELS;
+    xSemaphoreTake(xRelayMutex, portMAX_DELAY);
+    uint32_t changed = 0;
+    bool idle = true;
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        if (!(channels & RELAY_CHANNEL(ch))) {
+            if (relayChannels[ch].state != RELAY_IDLE) idle = false;
+        } else if (relayChannels[ch].state != RELAY_IDLE) {
+            changed |= RELAY_CHANNEL(ch);
+        }
+    }
+    if (changed == 0) {
+        xSemaphoreGive(xRelayMutex);
+        return false;
+    }
+    relay_clear_pending_locked(changed);
+    relay_write_locked(changed, false);
+    for (int ch = 0; ch < RELAY_CHANNELS; ch++) {
+        if (changed & RELAY_CHANNEL(ch)) relayChannels[ch].state = RELAY_IDLE;
+    }
+    xSemaphoreGive(xRelayMutex);
+
+    // Display animation
+    LED_Message_queue_send(LED_LOAD_OUT, 0, 40, 40, false, LED_PRIORITY_ACTUATION, true);
+    // return to normal status indicator
+    if (idle) LED_Message_queue_send(LED_PERSIST_STATUS_2, 100, 20, 0, false);
+    return true;
+}
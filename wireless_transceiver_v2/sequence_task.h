@@ -0,0 +1,212 @@
+// ==================================================================
+// Code containing the relay sequencer for /control/sequence
+// ==================================================================
+// A whole press/release timeline is validated up front and then played
+// on relay channel 0 by a hardware timer interrupt: every edge is written
+// straight to the GPIO register from the alarm ISR, and the next alarm is
+// set as an absolute counter value so timing errors do not add up.
+// A small task collects the edge timestamps afterwards and reports jitter.
+
+#include "driver/timer.h"
+#include "soc/gpio_struct.h"
+
+// Timeline limits
+#define SEQUENCE_MAX_STEPS 31           // press/release durations per timeline (odd)
+#define SEQUENCE_MAX_TOTAL_MS 30000
+
+// Hardware timer used by the sequencer (group 0 is left to the Arduino timer API)
+#define SEQUENCE_TIMER_GROUP TIMER_GROUP_1
+#define SEQUENCE_TIMER_INDEX TIMER_0
+#define SEQUENCE_TIMER_DIVIDER 80       // 80 MHz APB clock / 80 = 1 us per count
+
+// sequence_validate() results
+#define SEQUENCE_OK 0
+#define SEQUENCE_EMPTY 1
+#define SEQUENCE_TOO_MANY_STEPS 2
+#define SEQUENCE_EVEN_STEPS 3           // a timeline has to start and end with a press
+#define SEQUENCE_STEP_RANGE 4
+#define SEQUENCE_TOO_LONG 5
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+// Timeline being played, written before the timer starts and then only by the ISR
+// edge k is a press for even k and a release for odd k, edge 0 is written when starting
+uint64_t sequenceEdgeAt[SEQUENCE_MAX_STEPS + 1];        // scheduled edge times, us after edge 0
+int64_t sequenceEdgeActual[SEQUENCE_MAX_STEPS + 1];     // esp_timer time each edge was written
+volatile int sequenceEdgeCount = 0;
+volatile int sequenceNextEdge = 0;
+volatile bool sequenceActive = false;   // cleared when a hold or release cancels the run
+// Bumped by every sequence_start(), the ISR's last-edge notify carries it
+// so a notify left over from a cancelled run cannot finish the next one
+volatile uint32_t sequenceGeneration = 0;
+uint32_t sequencePinMask = 0;           // output register bit of channel 0
+
+// Jitter of the last completed run (us)
+uint32_t sequenceLastMaxJitter = 0;
+uint32_t sequenceLastMeanJitter = 0;
+
+TaskHandle_t xSequenceTask = NULL;
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+// Alarm ISR, writes the due edge and arms the next one
+bool IRAM_ATTR sequence_timer_isr(void *arg) {
+    if (!sequenceActive) {
+        return false;
+    }
+    int edge = sequenceNextEdge;
+    if (edge % 2 == 0) {
+        GPIO.out_w1ts = sequencePinMask;
+    } else {
+        GPIO.out_w1tc = sequencePinMask;
+    }
+    sequenceEdgeActual[edge] = esp_timer_get_time();
+    edge++;
+    sequenceNextEdge = edge;
+
+    BaseType_t woken = pdFALSE;
+    if (edge < sequenceEdgeCount) {
+        timer_group_set_alarm_value_in_isr(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX, sequenceEdgeAt[edge]);
+        timer_group_enable_alarm_in_isr(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX);
+    } else {
+        // last edge written, let the sequence task finish up this run
+        xTaskNotifyFromISR(xSequenceTask, sequenceGeneration, eSetValueWithOverwrite, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+// Check a timeline of press/release durations in ms
+// return one of SEQUENCE_* results
+int sequence_validate(const int *steps, int count) {
+    if (count == 0) return SEQUENCE_EMPTY;
+    if (count > SEQUENCE_MAX_STEPS) return SEQUENCE_TOO_MANY_STEPS;
+    if (count % 2 == 0) return SEQUENCE_EVEN_STEPS;
+    long total = 0;
+    for (int i = 0; i < count; i++) {
+        if (steps[i] < 1 || steps[i] > RELAY_PULSE_MAX_MS) return SEQUENCE_STEP_RANGE;
+        total += steps[i];
+    }
+    if (total > SEQUENCE_MAX_TOTAL_MS) return SEQUENCE_TOO_LONG;
+    return SEQUENCE_OK;
+}
+
+// Stop a running timeline, the caller sets the relay level and state
+// expects xRelayMutex to be held
+void sequence_stop_locked() {
+    sequenceActive = false;
+    timer_pause(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX);
+    timer_set_alarm(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX, TIMER_ALARM_DIS);
+}
+
+// Play a validated timeline on channel 0, returns immediately
+// return false if the relay is busy
+bool sequence_start(const int *steps, int count) {
+    RelayChannel &channel = relayChannels[0];
+    xSemaphoreTake(xRelayMutex, portMAX_DELAY);
+    if (channel.state != RELAY_IDLE) {
+        xSemaphoreGive(xRelayMutex);
+        return false;
+    }
+    sequenceEdgeAt[0] = 0;
+    for (int i = 0; i < count; i++) {
+        sequenceEdgeAt[i + 1] = sequenceEdgeAt[i] + (uint64_t)steps[i] * 1000;
+    }
+    sequenceEdgeCount = count + 1;
+    sequenceNextEdge = 1;
+    sequencePinMask = channel.pinMask;
+    sequenceGeneration++;
+    sequenceActive = true;
+    channel.state = RELAY_SEQUENCE;
+
+    timer_pause(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX);
+    timer_set_counter_value(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX, 0);
+    timer_set_alarm_value(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX, sequenceEdgeAt[1]);
+    timer_set_alarm(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX, TIMER_ALARM_EN);
+    // first press
+    GPIO.out_w1ts = sequencePinMask;
+    sequenceEdgeActual[0] = esp_timer_get_time();
+    timer_start(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX);
+    xSemaphoreGive(xRelayMutex);
+
+    // Display animation
+    LED_Message_queue_send(LED_CIRCLE_IN, 0, 40, 40, false, LED_PRIORITY_ACTUATION, true);
+    return true;
+}
+
+/*
+ * =======================================================
+ * Sequence Task loop
+ * =======================================================
+ * - Wait for the ISR to report the last edge
+ * - Ignore the report if it belongs to an earlier, cancelled run
+ * - Release the relay state and report per-edge jitter
+ *   (actual edge time against edge 0 plus the scheduled offset)
+ */
+void sequence_task(void * parameter) {
+    for(;;){
+        uint32_t generation;
+        xTaskNotifyWait(0, 0, &generation, portMAX_DELAY);
+
+        xSemaphoreTake(xRelayMutex, portMAX_DELAY);
+        bool finished = (relayChannels[0].state == RELAY_SEQUENCE && generation == sequenceGeneration);
+        if (finished) {
+            sequence_stop_locked();
+            relayChannels[0].state = RELAY_IDLE;
+        }
+        int edges = sequenceEdgeCount;
+        xSemaphoreGive(xRelayMutex);
+        if (!finished) {
+            // cancelled by a hold or release meanwhile, maybe followed by a new run
+            continue;
+        }
+
+        uint32_t maxJitter = 0;
+        uint64_t totalJitter = 0;
+        for (int i = 1; i < edges; i++) {
+            int64_t error = sequenceEdgeActual[i] - (sequenceEdgeActual[0] + (int64_t)sequenceEdgeAt[i]);
+            uint32_t jitter = (uint32_t)(error < 0 ? -error : error);
+            metrics_observe(metricsSequenceJitter, jitter);
+            totalJitter += jitter;
+            if (jitter > maxJitter) maxJitter = jitter;
+        }
+        sequenceLastMaxJitter = maxJitter;
+        sequenceLastMeanJitter = (edges > 1) ? totalJitter / (edges - 1) : 0;
+        LOG_INFO("[SEQUENCE] >>> %d edges, jitter max %u us, mean %u us",
+            edges, sequenceLastMaxJitter, sequenceLastMeanJitter);
+
+        // Display animation
+        LED_Message_queue_send(LED_LOAD_OUT, 0, 40, 40, false, LED_PRIORITY_ACTUATION, true);
+        // return to normal status indicator
+        LED_Message_queue_send(LED_PERSIST_STATUS_2, 100, 20, 0, false);
+    }
+}
+
+// Set up the sequencer timer, its ISR and task
+// return false if the timer could not be set up
+bool sequence_init() {
+    timer_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.divider = SEQUENCE_TIMER_DIVIDER;
+    config.counter_dir = TIMER_COUNT_UP;
+    config.counter_en = TIMER_PAUSE;
+    config.alarm_en = TIMER_ALARM_DIS;
+    config.auto_reload = TIMER_AUTORELOAD_DIS;
+    if (timer_init(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX, &config) != ESP_OK) {
+        return false;
+    }
+    timer_enable_intr(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX);
+    if (timer_isr_callback_add(SEQUENCE_TIMER_GROUP, SEQUENCE_TIMER_INDEX, sequence_timer_isr, NULL, ESP_INTR_FLAG_IRAM) != ESP_OK) {
+        return false;
+    }
+    return task_create(TASK_SEQUENCE, sequence_task, NULL, &xSequenceTask);
+}
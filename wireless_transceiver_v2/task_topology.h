@@ -0,0 +1,99 @@
+// ==================================================================
+// Code containing the task topology: core, priority and stack per task
+// ==================================================================
+// Every firmware task is created through task_create() from the table
+// below, so placement and sizes are reviewed in one place. Core 0 runs
+// the Wi-Fi driver, lwIP and the esp_timer task, so the tasks talking to
+// the network go there; LED rendering and the other local work go to
+// core 1, next to the Arduino setup task.
+// Stack sizes are in bytes (the ESP-IDF xTaskCreate counts bytes, not
+// words). /debug/memory reports each task's peak use since boot and a
+// suggested size, peak plus TASK_STACK_MARGIN; take the table values
+// from there after a soak with every feature in use.
+
+#define TASK_CORE_NETWORK 0     // PRO_CPU: Wi-Fi, lwIP, esp_timer
+#define TASK_CORE_APP 1         // APP_CPU: Arduino setup, rendering
+
+// Headroom added to a measured peak for the suggested size (bytes)
+#define TASK_STACK_MARGIN 512
+// Tasks with less headroom than this are flagged in /debug/memory (bytes)
+#define TASK_STACK_LOW 256
+
+// Task ids, index into taskTopology
+#define TASK_LOG_DRAIN 0
+#define TASK_LED_RING 1
+#define TASK_SEQUENCE 2
+#define TASK_UDP_CONTROL 3
+#define TASK_WIFI_SUPERVISOR 4
+#define TASK_COUNT 5
+
+struct TaskSpec {
+    const char *name;
+    uint32_t stackBytes;
+    UBaseType_t priority;
+    BaseType_t core;
+};
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+// LED_Ring has no /debug/memory figure from a board yet. Its estimate:
+// - the frame path is ~1 KB per gcc -fstack-usage on the host build
+//   (the LEDAnimation locals hold a 512 byte program);
+// - a LOG_* call formats with vsnprintf, ~1.5 KB with newlib on Xtensa;
+// - an interrupt frame lands on the task stack as well.
+// That makes ~3 KB. 6144 keeps 3 KB spare until a measured peak
+// replaces it.
+const TaskSpec taskTopology[TASK_COUNT] = {
+    // name                 stack   priority    core
+    { "Log_Drain",          2048,   0,          TASK_CORE_APP },        // below everything else
+    { "LED_Ring",           6144,   1,          TASK_CORE_APP },        // was 10000, estimate above, off the network core
+    { "Sequence",           2048,   2,          TASK_CORE_APP },        // same core as the sequencer ISR
+    { "UDP_Control",        3072,   2,          TASK_CORE_NETWORK },
+    { "WiFi_Supervisor",    4096,   1,          TASK_CORE_NETWORK },
+};
+
+// Handles of the running tasks, NULL until started and after task_exit()
+TaskHandle_t taskHandles[TASK_COUNT] = {};
+
+// Other tasks reported by /debug/memory, their stack sizes are set by the core
+const char *taskSystemNames[] = { "async_tcp", "arduino_events", "tiT", "wifi", "esp_timer", "sys_evt" };
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+// Create task id of taskTopology, pinned to its core
+// handle: also receives the task handle, may be NULL
+// return false if the task could not be created
+bool task_create(int id, TaskFunction_t function, void *parameter = NULL, TaskHandle_t *handle = NULL) {
+    const TaskSpec &spec = taskTopology[id];
+    if (xTaskCreatePinnedToCore(function, spec.name, spec.stackBytes, parameter,
+                                spec.priority, &taskHandles[id], spec.core) != pdPASS) {
+        return false;
+    }
+    if (handle != NULL) *handle = taskHandles[id];
+    return true;
+}
+
+// End the calling task, which is task id of taskTopology
+// the handle is cleared first so /debug/memory and the tracer never look at
+// the freed task; its memory is reclaimed by the idle task of its core, which
+// cannot run while a reader between taking the handle and using it is running
+// on that core (the readers do not block there)
+void task_exit(int id) {
+    __atomic_store_n(&taskHandles[id], (TaskHandle_t)NULL, __ATOMIC_RELAXED);
+    vTaskDelete(NULL);
+}
+
+// Stack size to configure for a measured peak use (bytes)
+uint32_t task_suggested_stack(uint32_t peak) {
+    return (peak + TASK_STACK_MARGIN + 255) / 256 * 256;
+}
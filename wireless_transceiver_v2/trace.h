@@ -0,0 +1,273 @@
+// ==================================================================
+// Code containing the event tracer for /debug/trace
+// ==================================================================
+// Build with TRACE_ENABLED defined to record begin/end/instant events
+// at the handler, LED queue, pattern and frame output boundaries; the
+// TRACE_* macros compile to nothing otherwise, and so does the rest of
+// this file.
+// Events carry an esp_timer timestamp and the current task, and go into
+// a fixed ring per core that keeps the newest TRACE_EVENTS events. A
+// writer claims its slot with one atomic add and stamps the slot once
+// written, so recording never blocks or allocates.
+// /debug/trace streams the rings as Chrome trace JSON, open it in
+// chrome://tracing or ui.perfetto.dev. Recording pauses while it runs.
+// Event names have to be string literals, only the pointer is kept.
+
+#ifdef TRACE_ENABLED
+
+#include "esp_timer.h"
+
+#define TRACE_EVENTS 256        // events kept per core
+#define TRACE_MAX_TASKS 16      // tasks named in a dump, others share one track
+#define TRACE_RECORD_BYTES 192  // longest JSON record of a dump
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_BEGIN(name) trace_record('B', name, 0)
+#define TRACE_END(name) trace_record('E', name, 0)
+#define TRACE_INSTANT(name, value) trace_record('i', name, value)
+// Begin now, end when the enclosing block is left
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#else
+
+#define TRACE_BEGIN(name) do {} while (0)
+#define TRACE_END(name) do {} while (0)
+#define TRACE_INSTANT(name, value) do {} while (0)
+#define TRACE_SCOPE(name) do {} while (0)
+
+#endif
+
+#ifdef TRACE_ENABLED
+
+struct TraceEvent {
+    uint32_t sequence;      // event index + 1 once written, 0 while being written
+    char phase;             // 'B', 'E' or 'i'
+    const char *name;
+    TaskHandle_t task;
+    int64_t at;             // esp_timer time (us)
+    int32_t value;          // shown for instant events
+};
+
+// Progress of the running dump, kept between the response chunks
+struct TraceDump {
+    int stage;
+    int core;
+    uint32_t index;         // next event of the current core
+    uint32_t end;
+    bool first;             // nothing written to the current JSON array yet
+    TaskHandle_t tasks[TRACE_MAX_TASKS];    // tid is the index into this
+    int taskCount;
+    bool taskOverflow;      // more tasks than TRACE_MAX_TASKS, the rest are on track TRACE_MAX_TASKS
+    int nextTask;           // next thread name to write
+    // Record being sent, continued in the next chunk when it did not fit
+    char record[TRACE_RECORD_BYTES];
+    size_t recordLength;
+    size_t recordSent;
+};
+
+#define TRACE_STAGE_HEADER 0
+#define TRACE_STAGE_EVENTS 1
+#define TRACE_STAGE_NAMES 2
+#define TRACE_STAGE_FOOTER 3
+#define TRACE_STAGE_DONE 4
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+TraceEvent traceEvents[portNUM_PROCESSORS][TRACE_EVENTS];
+uint32_t traceHead[portNUM_PROCESSORS] = {};
+bool traceDumping = false;      // recording paused while a dump runs
+TraceDump traceDump;
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+// Record one event, use the TRACE_* macros so disabled builds compile it away
+// not for interrupt handlers
+void trace_record(char phase, const char *name, int32_t value) {
+    if (__atomic_load_n(&traceDumping, __ATOMIC_RELAXED)) {
+        return;
+    }
+    int core = xPortGetCoreID();
+    uint32_t index = __atomic_fetch_add(&traceHead[core], 1, __ATOMIC_RELAXED);
+    TraceEvent &event = traceEvents[core][index % TRACE_EVENTS];
+    __atomic_store_n(&event.sequence, 0, __ATOMIC_RELAXED);
+    event.phase = phase;
+    event.name = name;
+    event.task = xTaskGetCurrentTaskHandle();
+    event.at = esp_timer_get_time();
+    event.value = value;
+    __atomic_store_n(&event.sequence, index + 1, __ATOMIC_RELEASE);
+}
+
+struct TraceScope {
+    const char *name;
+    TraceScope(const char *name) : name(name) { trace_record('B', name, 0); }
+    ~TraceScope() { trace_record('E', name, 0); }
+};
+
+// Name of a traced task for the dump, from task_topology.h where known
+// return NULL for other tasks, which may have been deleted since
+const char *trace_task_name(TaskHandle_t task) {
+    for (int id = 0; id < TASK_COUNT; id++) {
+        if (taskHandles[id] == task) return taskTopology[id].name;
+    }
+    for (size_t i = 0; i < sizeof(taskSystemNames) / sizeof(taskSystemNames[0]); i++) {
+        if (xTaskGetHandle(taskSystemNames[i]) == task) return taskSystemNames[i];
+    }
+    return NULL;
+}
+
+// Track of a task in the dump
+int trace_task_id(TaskHandle_t task) {
+    for (int i = 0; i < traceDump.taskCount; i++) {
+        if (traceDump.tasks[i] == task) return i;
+    }
+    if (traceDump.taskCount == TRACE_MAX_TASKS) {
+        traceDump.taskOverflow = true;
+        return TRACE_MAX_TASKS;
+    }
+    traceDump.tasks[traceDump.taskCount] = task;
+    return traceDump.taskCount++;
+}
+
+// Start the events of a core, oldest first
+void trace_dump_core(int core) {
+    traceDump.core = core;
+    traceDump.end = __atomic_load_n(&traceHead[core], __ATOMIC_ACQUIRE);
+    traceDump.index = traceDump.end > TRACE_EVENTS ? traceDump.end - TRACE_EVENTS : 0;
+}
+
+// Pause recording and start a dump
+// return false if another dump is running
+bool trace_dump_begin() {
+    if (__atomic_exchange_n(&traceDumping, true, __ATOMIC_ACQ_REL)) {
+        return false;
+    }
+    traceDump.stage = TRACE_STAGE_HEADER;
+    traceDump.first = true;
+    traceDump.taskCount = 0;
+    traceDump.taskOverflow = false;
+    traceDump.nextTask = 0;
+    traceDump.recordLength = 0;
+    traceDump.recordSent = 0;
+    trace_dump_core(0);
+    return true;
+}
+
+// Resume recording, safe to call more than once
+void trace_dump_end() {
+    __atomic_store_n(&traceDumping, false, __ATOMIC_RELEASE);
+}
+
+// Copy the next event of the running dump, false once the current core has none left
+// events overwritten or still being written are skipped
+bool trace_dump_next(TraceEvent &event) {
+    while (traceDump.index != traceDump.end) {
+        uint32_t index = traceDump.index;
+        TraceEvent &slot = traceEvents[traceDump.core][index % TRACE_EVENTS];
+        uint32_t before = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE);
+        event = slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint32_t after = __atomic_load_n(&slot.sequence, __ATOMIC_RELAXED);
+        if (before == index + 1 && after == before) {
+            return true;
+        }
+        traceDump.index++;
+    }
+    return false;
+}
+
+// Format the next JSON record of the dump into traceDump.record
+// return false once the dump is complete
+bool trace_dump_format() {
+    char *line = traceDump.record;
+    size_t size = sizeof(traceDump.record);
+    int n = -1;
+    while (n < 0 && traceDump.stage != TRACE_STAGE_DONE) {
+        if (traceDump.stage == TRACE_STAGE_HEADER) {
+            n = snprintf(line, size, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+            traceDump.stage = TRACE_STAGE_EVENTS;
+        } else if (traceDump.stage == TRACE_STAGE_EVENTS) {
+            TraceEvent event;
+            if (!trace_dump_next(event)) {
+                if (traceDump.core + 1 < portNUM_PROCESSORS) {
+                    trace_dump_core(traceDump.core + 1);
+                } else {
+                    traceDump.stage = TRACE_STAGE_NAMES;
+                }
+                continue;
+            }
+            int tid = trace_task_id(event.task);
+            if (event.phase == 'i') {
+                n = snprintf(line, size,
+                    "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lld,\"pid\":0,\"tid\":%d,\"args\":{\"core\":%d,\"value\":%d}}",
+                    traceDump.first ? "" : ",", event.name, (long long)event.at, tid, traceDump.core, event.value);
+            } else {
+                n = snprintf(line, size,
+                    "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":0,\"tid\":%d,\"args\":{\"core\":%d}}",
+                    traceDump.first ? "" : ",", event.name, event.phase, (long long)event.at, tid, traceDump.core);
+            }
+            traceDump.index++;
+            traceDump.first = false;
+        } else if (traceDump.stage == TRACE_STAGE_NAMES) {
+            if (traceDump.nextTask > traceDump.taskCount ||
+                (traceDump.nextTask == traceDump.taskCount && !traceDump.taskOverflow)) {
+                traceDump.stage = TRACE_STAGE_FOOTER;
+                continue;
+            }
+            const char *name = traceDump.nextTask < traceDump.taskCount ?
+                trace_task_name(traceDump.tasks[traceDump.nextTask]) : "other tasks";
+            char unnamed[16];
+            if (name == NULL) {
+                snprintf(unnamed, sizeof(unnamed), "task %d", traceDump.nextTask);
+                name = unnamed;
+            }
+            n = snprintf(line, size, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                traceDump.first ? "" : ",", traceDump.nextTask, name);
+            traceDump.nextTask++;
+            traceDump.first = false;
+        } else {
+            n = snprintf(line, size, "]}\n");
+            traceDump.stage = TRACE_STAGE_DONE;
+        }
+    }
+    if (n < 0) {
+        return false;
+    }
+    traceDump.recordLength = min((size_t)n, size - 1);
+    traceDump.recordSent = 0;
+    return true;
+}
+
+// Fill buffer with the next part of the Chrome trace JSON; a record that
+// does not fit is split and continued in the next call, so any buffer size
+// makes progress
+// return the bytes written, 0 only once the dump is complete (recording resumes then)
+size_t trace_dump_fill(char *buffer, size_t length) {
+    size_t used = 0;
+    while (used < length) {
+        if (traceDump.recordSent == traceDump.recordLength && !trace_dump_format()) {
+            break;
+        }
+        size_t n = min(traceDump.recordLength - traceDump.recordSent, length - used);
+        memcpy(buffer + used, traceDump.record + traceDump.recordSent, n);
+        traceDump.recordSent += n;
+        used += n;
+    }
+    if (used == 0) {
+        trace_dump_end();
+    }
+    return used;
+}
+
+#endif
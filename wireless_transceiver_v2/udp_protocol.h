@@ -0,0 +1,304 @@
+// ==================================================================
+// Code containing the binary UDP control protocol
+// ==================================================================
+// Plain C++ without Arduino dependencies, shared by the firmware
+// (udp_task.h) and the host client (tools/udp_client).
+//
+// Every packet is UDP_PACKET_BYTES long, little endian:
+//   0  u8   magic UDP_MAGIC
+//   1  u8   version UDP_VERSION
+//   2  u8   type: UDP_CMD_* for requests, UDP_ACK | command for acks
+//   3  u8   reserved, 0
+//   4  u32  epoch: random per device boot, requests have to carry it
+//   8  u32  sender: random per client session
+//  12  u32  sequence: starts at 1 and increases with every new command
+//  16  u16  argument: click width in ms for requests, UDP_STATUS_* for acks
+//  18  u16  reserved, 0
+//  20  u64  SipHash-2-4 of bytes 0 - 19 with the shared 128-bit key
+//
+// Replay protection:
+// - packets with a wrong MAC are dropped without an answer
+// - a request with a stale epoch is not executed, the ack carries the
+//   current epoch (UDP_STATUS_EPOCH) and the client resends with it,
+//   so packets recorded before a reboot are useless afterwards
+// - per sender only increasing sequence numbers are executed; a resent
+//   request (lost ack) gets the stored ack again without running twice
+// Packets are sent on the sender's initiative only, acks go back to the
+// source address of the request.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define UDP_MAGIC 0xA5
+#define UDP_VERSION 1
+#define UDP_PACKET_BYTES 28
+#define UDP_MAC_OFFSET 20
+
+// Request types
+#define UDP_CMD_CLICK 1         // argument: pulse width in ms
+#define UDP_CMD_PRESS 2
+#define UDP_CMD_RELEASE 3
+#define UDP_CMD_PING 4          // no action, for epoch discovery and round trips
+#define UDP_ACK 0x80
+
+// Ack status
+#define UDP_STATUS_OK 0
+#define UDP_STATUS_BUSY 1
+#define UDP_STATUS_INVALID 2
+#define UDP_STATUS_STALE 3      // sequence number too old, not executed
+#define UDP_STATUS_EPOCH 4      // wrong epoch, resend with the one in this ack
+
+// Senders tracked per epoch, a new sender beyond this starts a new epoch
+#define UDP_SENDERS 8
+// Acks kept per sender for resent requests
+#define UDP_WINDOW 32
+
+
+// Decoded packet
+struct UdpPacket {
+    uint8_t type;
+    uint32_t epoch;
+    uint32_t sender;
+    uint32_t sequence;
+    uint16_t argument;
+};
+
+struct UdpSender {
+    uint32_t id;                    // 0 if the slot is free
+    uint32_t highest;               // highest sequence number executed
+    uint32_t seen;                  // bit d: highest - d was executed
+    uint8_t status[UDP_WINDOW];     // ack status by sequence % UDP_WINDOW
+};
+
+// Device side protocol state
+struct UdpServer {
+    uint8_t key[16];
+    uint32_t epoch;
+    uint32_t (*epochSource)();      // random numbers for new epochs
+    // runs a command, returns a UDP_STATUS_* value
+    int (*execute)(int type, int argument);
+    UdpSender senders[UDP_SENDERS];
+    // counters
+    uint32_t received;
+    uint32_t dropped;               // malformed or wrong MAC
+    uint32_t resent;                // duplicates answered from the stored ack
+    uint32_t stale;
+};
+
+
+/*
+ * =======================================================
+ * SipHash-2-4
+ * =======================================================
+ */
+
+inline uint64_t udp_load64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+inline void udp_store64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = v >> (8 * i);
+}
+
+#define UDP_ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+#define UDP_SIPROUND                                                    \
+    do {                                                                \
+        v0 += v1; v1 = UDP_ROTL(v1, 13); v1 ^= v0; v0 = UDP_ROTL(v0, 32); \
+        v2 += v3; v3 = UDP_ROTL(v3, 16); v3 ^= v2;                      \
+        v0 += v3; v3 = UDP_ROTL(v3, 21); v3 ^= v0;                      \
+        v2 += v1; v1 = UDP_ROTL(v1, 17); v1 ^= v2; v2 = UDP_ROTL(v2, 32); \
+    } while (0)
+
+uint64_t udp_siphash24(const uint8_t key[16], const uint8_t *in, size_t length) {
+    uint64_t k0 = udp_load64(key);
+    uint64_t k1 = udp_load64(key + 8);
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+    size_t whole = length - (length % 8);
+    for (size_t i = 0; i < whole; i += 8) {
+        uint64_t m = udp_load64(in + i);
+        v3 ^= m;
+        UDP_SIPROUND;
+        UDP_SIPROUND;
+        v0 ^= m;
+    }
+    uint64_t b = (uint64_t)length << 56;
+    for (size_t i = whole; i < length; i++) {
+        b |= (uint64_t)in[i] << (8 * (i - whole));
+    }
+    v3 ^= b;
+    UDP_SIPROUND;
+    UDP_SIPROUND;
+    v0 ^= b;
+    v2 ^= 0xff;
+    UDP_SIPROUND;
+    UDP_SIPROUND;
+    UDP_SIPROUND;
+    UDP_SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+
+/*
+ * =======================================================
+ * Packets
+ * =======================================================
+ */
+
+// Write a signed packet into out (UDP_PACKET_BYTES)
+void udp_encode(const uint8_t key[16], const UdpPacket &packet, uint8_t *out) {
+    memset(out, 0, UDP_PACKET_BYTES);
+    out[0] = UDP_MAGIC;
+    out[1] = UDP_VERSION;
+    out[2] = packet.type;
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = packet.epoch >> (8 * i);
+        out[8 + i] = packet.sender >> (8 * i);
+        out[12 + i] = packet.sequence >> (8 * i);
+    }
+    out[16] = packet.argument & 0xff;
+    out[17] = packet.argument >> 8;
+    udp_store64(out + UDP_MAC_OFFSET, udp_siphash24(key, out, UDP_MAC_OFFSET));
+}
+
+// Check and read a packet
+// return false if it is malformed or the MAC does not match
+bool udp_decode(const uint8_t key[16], const uint8_t *in, size_t length, UdpPacket &packet) {
+    if (length != UDP_PACKET_BYTES || in[0] != UDP_MAGIC || in[1] != UDP_VERSION) {
+        return false;
+    }
+    uint8_t mac[8];
+    udp_store64(mac, udp_siphash24(key, in, UDP_MAC_OFFSET));
+    // compare in constant time
+    uint8_t diff = 0;
+    for (int i = 0; i < 8; i++) diff |= mac[i] ^ in[UDP_MAC_OFFSET + i];
+    if (diff != 0) {
+        return false;
+    }
+    packet.type = in[2];
+    packet.epoch = 0;
+    packet.sender = 0;
+    packet.sequence = 0;
+    for (int i = 3; i >= 0; i--) {
+        packet.epoch = (packet.epoch << 8) | in[4 + i];
+        packet.sender = (packet.sender << 8) | in[8 + i];
+        packet.sequence = (packet.sequence << 8) | in[12 + i];
+    }
+    packet.argument = in[16] | (in[17] << 8);
+    return true;
+}
+
+
+/*
+ * =======================================================
+ * Device Side
+ * =======================================================
+ */
+
+void udp_server_init(UdpServer &server, const uint8_t key[16], uint32_t (*epochSource)(),
+                     int (*execute)(int type, int argument)) {
+    memset(&server, 0, sizeof(server));
+    memcpy(server.key, key, sizeof(server.key));
+    server.epochSource = epochSource;
+    server.execute = execute;
+    // 0 is what a client sends before it knows the epoch
+    do {
+        server.epoch = epochSource();
+    } while (server.epoch == 0);
+}
+
+// Start a new epoch, every client has to learn it again
+void udp_server_new_epoch(UdpServer &server) {
+    uint32_t previous = server.epoch;
+    do {
+        server.epoch = server.epochSource();
+    } while (server.epoch == 0 || server.epoch == previous);
+    memset(server.senders, 0, sizeof(server.senders));
+}
+
+// Handle one received datagram
+// return the length of the ack written to ack (UDP_PACKET_BYTES), 0 to send nothing
+size_t udp_server_handle(UdpServer &server, const uint8_t *in, size_t length, uint8_t *ack) {
+    UdpPacket request;
+    server.received++;
+    if (!udp_decode(server.key, in, length, request) || (request.type & UDP_ACK)) {
+        server.dropped++;
+        return 0;
+    }
+
+    UdpPacket reply = request;
+    reply.type = UDP_ACK | request.type;
+    reply.epoch = server.epoch;
+
+    if (request.epoch != server.epoch) {
+        reply.argument = UDP_STATUS_EPOCH;
+    } else if (request.sequence == 0 || request.sender == 0 ||
+               request.type < UDP_CMD_CLICK || request.type > UDP_CMD_PING) {
+        reply.argument = UDP_STATUS_INVALID;
+    } else {
+        UdpSender *sender = NULL;
+        UdpSender *empty = NULL;
+        for (int i = 0; i < UDP_SENDERS; i++) {
+            if (server.senders[i].id == request.sender) sender = &server.senders[i];
+            if (empty == NULL && server.senders[i].id == 0) empty = &server.senders[i];
+        }
+        if (sender == NULL && empty == NULL) {
+            // forgetting a sender would let its old packets run again
+            udp_server_new_epoch(server);
+            reply.epoch = server.epoch;
+            reply.argument = UDP_STATUS_EPOCH;
+            udp_encode(server.key, reply, ack);
+            return UDP_PACKET_BYTES;
+        }
+        if (sender == NULL) {
+            sender = empty;
+            sender->id = request.sender;
+        }
+
+        if (request.sequence > sender->highest) {
+            uint32_t shift = request.sequence - sender->highest;
+            sender->seen = (shift >= 32) ? 0 : sender->seen << shift;
+            sender->seen |= 1;
+            sender->highest = request.sequence;
+            reply.argument = server.execute(request.type, request.argument);
+            sender->status[request.sequence % UDP_WINDOW] = reply.argument;
+        } else {
+            uint32_t age = sender->highest - request.sequence;
+            if (age < UDP_WINDOW && (sender->seen & (1UL << age))) {
+                // resent request, its ack got lost
+                server.resent++;
+                reply.argument = sender->status[request.sequence % UDP_WINDOW];
+            } else {
+                server.stale++;
+                reply.argument = UDP_STATUS_STALE;
+            }
+        }
+    }
+    udp_encode(server.key, reply, ack);
+    return UDP_PACKET_BYTES;
+}
+
+// Parse a 32 hex digit key
+// return false if text is not exactly that
+bool udp_parse_key(const char *text, uint8_t key[16]) {
+    if (strlen(text) != 32) {
+        return false;
+    }
+    for (int i = 0; i < 32; i++) {
+        char c = text[i];
+        int nibble;
+        if (c >= '0' && c <= '9') nibble = c - '0';
+        else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+        else return false;
+        if (i % 2 == 0) key[i / 2] = nibble << 4;
+        else key[i / 2] |= nibble;
+    }
+    return true;
+}
@@ -0,0 +1,97 @@
+// ==================================================================
+// Code containing the UDP control task
+// ==================================================================
+// Binary command channel next to HTTP for integrations on the local
+// network (protocol in udp_protocol.h). A dedicated task blocks on the
+// socket, so a command costs one datagram in and one ack out, with no
+// URL parsing and no per-request heap use. Commands go to the same
+// relay scheduler as /control/click, activate and deactivate (channel 0).
+
+#include "lwip/sockets.h"
+#include "udp_protocol.h"
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+UdpServer udpServer;
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+uint32_t udp_epoch_source() {
+    return esp_random();
+}
+
+// Run a verified command, called from udp_server_handle
+int udp_execute(int type, int argument) {
+    switch (type) {
+        case UDP_CMD_CLICK:
+            if (argument > RELAY_PULSE_MAX_MS) return UDP_STATUS_INVALID;
+            return relay_pulse(RELAY_CHANNEL(0), argument) == RELAY_PULSE_BUSY ? UDP_STATUS_BUSY : UDP_STATUS_OK;
+        case UDP_CMD_PRESS:
+            relay_hold(RELAY_CHANNEL(0));
+            return UDP_STATUS_OK;
+        case UDP_CMD_RELEASE:
+            relay_release(RELAY_CHANNEL(0));
+            return UDP_STATUS_OK;
+        default:
+            return UDP_STATUS_OK;
+    }
+}
+
+/*
+ * =======================================================
+ * UDP Control Task loop
+ * =======================================================
+ * - Bind udpControlPort on every interface (station and soft-AP)
+ * - Wait for a datagram, verify and run it, send the ack back
+ */
+void udp_control_task(void * parameter) {
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(udpControlPort);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        LOG_ERROR("UDP control socket failed to open");
+        if (sock >= 0) close(sock);
+        task_exit(TASK_UDP_CONTROL);
+        return;
+    }
+    LOG_INFO("UDP control on port %u", udpControlPort);
+
+    uint8_t packet[UDP_PACKET_BYTES + 1];   // one spare byte to notice oversized datagrams
+    uint8_t ack[UDP_PACKET_BYTES];
+    for(;;){
+        struct sockaddr_in source;
+        socklen_t sourceLength = sizeof(source);
+        int length = recvfrom(sock, packet, sizeof(packet), 0, (struct sockaddr *)&source, &sourceLength);
+        if (length <= 0) {
+            continue;
+        }
+        size_t ackLength = udp_server_handle(udpServer, packet, length, ack);
+        if (ackLength > 0) {
+            sendto(sock, ack, ackLength, 0, (struct sockaddr *)&source, sourceLength);
+        }
+    }
+}
+
+// Parse the key and start the task
+// return false if the key in wireless_config.h is not set
+bool udp_control_init() {
+    uint8_t key[16];
+    if (!udp_parse_key(udpControlKey, key)) {
+        return false;
+    }
+    udp_server_init(udpServer, key, udp_epoch_source, udp_execute);
+    return task_create(TASK_UDP_CONTROL, udp_control_task);
+}
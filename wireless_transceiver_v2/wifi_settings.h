@@ -0,0 +1,124 @@
+// ==================================================================
+// Code containing Wi-Fi settings and the fast-reconnect cache in NVS
+// ==================================================================
+// - Settings (network, credentials, host name) start from the defaults in
+//   wireless_config.h and can be changed at runtime through /config/wifi.
+//   Saved settings take over from the defaults without a reflash.
+// - The cache keeps the BSSID and channel of the last good connection so
+//   the next attempt can skip the scan. The address always comes from
+//   DHCP, a remembered lease would outlive its expiry and is dropped by
+//   networks with DHCP snooping (eduroam).
+
+#include <Preferences.h>
+
+// NVS namespaces
+#define WIFI_SETTINGS_NAMESPACE "wifi_cfg"
+#define WIFI_CACHE_NAMESPACE "wifi_cache"
+
+
+// Runtime Wi-Fi settings
+struct WifiSettings {
+    bool enterprise;        // WPA2 Enterprise (eduroam) instead of WPA2 Personal
+    char ssid[33];
+    char password[65];      // WPA2 Personal passphrase
+    char eapIdentity[65];
+    char eapPassword[65];
+    char hostname[33];      // also the mDNS name and the soft-AP name
+};
+
+// Last good connection
+struct WifiCache {
+    bool valid;
+    uint8_t bssid[6];
+    uint8_t channel;
+};
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+WifiSettings wifiSettings;
+WifiCache wifiCache;
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+void wifi_copy_setting(char *dest, size_t size, const char *value) {
+    strncpy(dest, value, size - 1);
+    dest[size - 1] = '\0';
+}
+
+// Load settings saved through /config/wifi, or the compile-time defaults
+void wifi_settings_load() {
+    Preferences prefs;
+    prefs.begin(WIFI_SETTINGS_NAMESPACE, true);
+    wifiSettings.enterprise = buildWifiEnterprise && prefs.getBool("enterprise", UseWAPEnterprise);
+    wifi_copy_setting(wifiSettings.ssid, sizeof(wifiSettings.ssid),
+        prefs.getString("ssid", buildWifiEnterprise && UseWAPEnterprise ? WAP2_SSID : ssid).c_str());
+    wifi_copy_setting(wifiSettings.password, sizeof(wifiSettings.password),
+        prefs.getString("password", password).c_str());
+    wifi_copy_setting(wifiSettings.eapIdentity, sizeof(wifiSettings.eapIdentity),
+        prefs.getString("eap_id", EAP_IDENTITY).c_str());
+    wifi_copy_setting(wifiSettings.eapPassword, sizeof(wifiSettings.eapPassword),
+        prefs.getString("eap_pass", EAP_PASSWORD).c_str());
+    wifi_copy_setting(wifiSettings.hostname, sizeof(wifiSettings.hostname),
+        prefs.getString("hostname", domainName).c_str());
+    prefs.end();
+}
+
+// Persist the current settings, they are used from the next boot on
+void wifi_settings_save() {
+    Preferences prefs;
+    prefs.begin(WIFI_SETTINGS_NAMESPACE, false);
+    prefs.putBool("enterprise", wifiSettings.enterprise);
+    prefs.putString("ssid", wifiSettings.ssid);
+    prefs.putString("password", wifiSettings.password);
+    prefs.putString("eap_id", wifiSettings.eapIdentity);
+    prefs.putString("eap_pass", wifiSettings.eapPassword);
+    prefs.putString("hostname", wifiSettings.hostname);
+    prefs.end();
+}
+
+void wifi_cache_load() {
+    Preferences prefs;
+    prefs.begin(WIFI_CACHE_NAMESPACE, true);
+    wifiCache.valid = prefs.getBytes("cache", &wifiCache, sizeof(wifiCache)) == sizeof(wifiCache) && wifiCache.valid;
+    prefs.end();
+}
+
+// Drop the cache, e.g. after the network settings changed or the cached
+// AP stopped answering
+void wifi_cache_clear() {
+    if (!wifiCache.valid) {
+        return;
+    }
+    wifiCache.valid = false;
+    Preferences prefs;
+    prefs.begin(WIFI_CACHE_NAMESPACE, false);
+    prefs.clear();
+    prefs.end();
+}
+
+// Remember the current connection, only written when it changed (flash wear)
+void wifi_cache_store() {
+    WifiCache current;
+    memset(&current, 0, sizeof(current));
+    current.valid = true;
+    memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+    current.channel = WiFi.channel();
+    if (memcmp(&current, &wifiCache, sizeof(current)) == 0) {
+        return;
+    }
+    wifiCache = current;
+    Preferences prefs;
+    prefs.begin(WIFI_CACHE_NAMESPACE, false);
+    prefs.putBytes("cache", &wifiCache, sizeof(wifiCache));
+    prefs.end();
+}
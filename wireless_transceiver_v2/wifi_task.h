@@ -0,0 +1,272 @@
+// ==================================================================
+// Code containing the Wi-Fi connection supervisor task
+// ==================================================================
+// Connection attempts no longer block setup(). WiFi.onEvent reports
+// connect/disconnect to a supervisor task, which retries with backoff
+// and, after repeated failures, opens a local soft-AP so the control
+// page stays reachable while it keeps retrying the configured network.
+// Attempts try the cached AP/channel first (wifi_settings.h) and fall
+// back to a full scan. Both paths get their address from DHCP.
+
+#include "freertos/event_groups.h"
+
+// Supervisor timing (ms)
+#define WIFI_CONNECT_TIMEOUT 30000      // give up on one attempt after this long
+#define WIFI_CACHED_CONNECT_TIMEOUT 5000 // same for a directed connect to the cached AP
+#define WIFI_DISCONNECT_TIMEOUT 1000    // wait for the event of a disconnect we started
+#define WIFI_BACKOFF_MIN 1000           // first retry delay, doubled after every failure
+#define WIFI_BACKOFF_MAX 60000
+#define WIFI_FAILURES_BEFORE_AP 2       // failed attempts before the soft-AP is opened
+#define WIFI_MDNS_REFRESH 1000          // interval of relay state updates in the TXT record
+
+// Features advertised in the mDNS TXT record "caps", the optional ones
+// (build_profile.h) are added by wifi_mdns_start()
+#define WIFI_MDNS_CAPABILITIES "click,hold,channels"
+
+// Event group bits set from the WiFi event callback
+#define WIFI_CONNECTED_BIT BIT0
+#define WIFI_DISCONNECTED_BIT BIT1
+
+
+/*
+ * =======================================================
+ * Global Variables
+ * =======================================================
+ */
+
+EventGroupHandle_t xWifiEvents = NULL;
+bool wifiSoftAPStarted = false;
+uint32_t wifiReadyAt = 0;   // millis() when the device could first take an actuation
+// Duration of the last successful attempt (ms) per connect path, 0 if never used
+uint32_t wifiConnectCachedTime = 0;
+uint32_t wifiConnectScanTime = 0;
+bool wifiMdnsStarted = false;
+const char *wifiMdnsRelayState = NULL;  // relay state last published over mDNS
+
+
+/*
+ * =======================================================
+ * Functions
+ * =======================================================
+ */
+
+// Runs in the WiFi event task, must not block
+void wifi_event_callback(WiFiEvent_t event, WiFiEventInfo_t info) {
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        xEventGroupSetBits(xWifiEvents, WIFI_CONNECTED_BIT);
+    } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+        xEventGroupSetBits(xWifiEvents, WIFI_DISCONNECTED_BIT);
+    }
+}
+
+// Record the first moment the control page can be reached
+void wifi_mark_ready(const char *how) {
+    if (wifiReadyAt != 0) {
+        return;
+    }
+    wifiReadyAt = millis();
+    LOG_INFO("[BOOT] >>> ready for actuation via %s after %u ms", how, wifiReadyAt);
+}
+
+// Station mode, host name and enterprise credentials
+// called once from setup() before the web server starts
+void wifi_init() {
+    wifi_settings_load();
+    wifi_cache_load();
+    xWifiEvents = xEventGroupCreate();
+    WiFi.onEvent(wifi_event_callback);
+    WiFi.setHostname(wifiSettings.hostname); // has to be set before the station starts
+    WiFi.mode(WIFI_MODE_STA);
+    // the supervisor owns reconnects
+    WiFi.setAutoReconnect(false);
+    // modem sleep: the radio wakes for every DTIM beacon, buffered frames arrive then
+    WiFi.setSleep(wifiPowerSave ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+    // Change mac address if needed
+    //esp_wifi_set_mac(WIFI_IF_STA, &newMACAddress[0]);
+    if (buildWifiEnterprise && wifiSettings.enterprise) {
+        // Configure enterprise network
+        esp_wifi_sta_wpa2_ent_set_identity((uint8_t *)wifiSettings.eapIdentity, strlen(wifiSettings.eapIdentity));
+        esp_wifi_sta_wpa2_ent_set_username((uint8_t *)wifiSettings.eapIdentity, strlen(wifiSettings.eapIdentity));
+        esp_wifi_sta_wpa2_ent_set_password((uint8_t *)wifiSettings.eapPassword, strlen(wifiSettings.eapPassword));
+        esp_wifi_sta_wpa2_ent_enable();
+    }
+}
+
+// End an attempt and wait for its disconnect event, so the event cannot
+// arrive after the next wifi_begin() and end that attempt at once
+// (no event comes if the station was not associated, hence the timeout)
+void wifi_disconnect() {
+    WiFi.disconnect();
+    xEventGroupWaitBits(xWifiEvents, WIFI_DISCONNECTED_BIT, pdTRUE, pdFALSE,
+                        WIFI_DISCONNECT_TIMEOUT / portTICK_PERIOD_MS);
+}
+
+// Start one connection attempt, returns immediately
+// useCache: directed connect to the cached AP and channel
+void wifi_begin(bool useCache) {
+    xEventGroupClearBits(xWifiEvents, WIFI_CONNECTED_BIT | WIFI_DISCONNECTED_BIT);
+    const char *passphrase = buildWifiEnterprise && wifiSettings.enterprise ? NULL : wifiSettings.password;
+    if (useCache) {
+        WiFi.begin(wifiSettings.ssid, passphrase, wifiCache.channel, wifiCache.bssid);
+    } else {
+        WiFi.begin(wifiSettings.ssid, passphrase);
+    }
+}
+
+// Local access point serving the same control page (http://192.168.4.1)
+void wifi_start_soft_ap() {
+    WiFi.mode(WIFI_MODE_APSTA);
+    if (WiFi.softAP(wifiSettings.hostname, softAPPassword)) {
+        wifiSoftAPStarted = true;
+        LOG_INFO("Soft-AP started: %s at %s", wifiSettings.hostname, WiFi.softAPIP().toString().c_str());
+        wifi_mark_ready("soft-AP");
+    } else {
+        LOG_ERROR("soft-AP failed to start");
+    }
+}
+
+// Advertise the control page with TXT records for fleet tools (tools/fleet):
+// id (station MAC), fw, relay state (channel 0), channel count, caps and the UDP control port
+void wifi_mdns_start() {
+    // Setup Local DNS - domain name
+    if ( !MDNS.begin(wifiSettings.hostname) ) {
+        LOG_ERROR("Error setting up mDNS responder!");
+        return;
+    }
+    LOG_INFO("mDNS responder started");
+    MDNS.addService("http", "tcp", 80);
+    String id = WiFi.macAddress();
+    id.replace(":", "");
+    id.toLowerCase();
+    MDNS.addServiceTxt("http", "tcp", "id", id);
+    MDNS.addServiceTxt("http", "tcp", "fw", FIRMWARE_VERSION);
+    String caps = WIFI_MDNS_CAPABILITIES;
+    if (buildSequence) caps += ",sequence";
+    if (buildWebSocket) caps += ",ws";
+    if (buildUdpControl) caps += ",udp";
+    if (buildLedUploads) caps += ",led-pattern";
+    if (buildMetrics) caps += ",metrics";
+    if (buildOta) caps += ",ota";
+    MDNS.addServiceTxt("http", "tcp", "caps", caps);
+    if (buildUdpControl) MDNS.addServiceTxt("http", "tcp", "udp", String(udpControlPort));
+    MDNS.addServiceTxt("http", "tcp", "channels", String(RELAY_CHANNELS));
+    wifiMdnsRelayState = relay_state_name(0);
+    MDNS.addServiceTxt("http", "tcp", "relay", wifiMdnsRelayState);
+    wifiMdnsStarted = true;
+}
+
+// Republish the relay state if it changed since the last call
+void wifi_mdns_update() {
+    const char *state = relay_state_name(0);
+    if (!wifiMdnsStarted || state == wifiMdnsRelayState) {
+        return;
+    }
+    wifiMdnsRelayState = state;
+    MDNS.addServiceTxt("http", "tcp", "relay", state);
+}
+
+// Close the fallback access point once the station is back, it would
+// otherwise stay open on the host name SSID
+void wifi_stop_soft_ap() {
+    if (!wifiSoftAPStarted) {
+        return;
+    }
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_MODE_STA);
+    wifiSoftAPStarted = false;
+    LOG_INFO("Soft-AP stopped");
+}
+
+// attemptTime: ms from the start of the successful attempt
+void wifi_on_connected(bool usedCache, uint32_t attemptTime) {
+    LOG_INFO("Connected to the WiFi network");
+    LOG_INFO("IP address: %s", WiFi.localIP().toString().c_str());
+    LOG_INFO("Host Name >> %s", WiFi.getHostname());
+    LOG_INFO("[BOOT] >>> connected %u ms after boot, attempt took %u ms (%s)",
+        millis(), attemptTime, usedCache ? "cached AP" : "scan");
+    if (usedCache) {
+        wifiConnectCachedTime = attemptTime;
+    } else {
+        wifiConnectScanTime = attemptTime;
+    }
+    wifi_cache_store();
+    wifi_stop_soft_ap();
+
+    if (!wifiMdnsStarted) {
+        wifi_mdns_start();
+    }
+    wifi_mark_ready("station");
+    // an updated image that got this far is kept
+    if (buildOta) ota_confirm();
+
+    // setup complete animation
+    LED_Message_queue_send(LED_LOAD_IN, 0, 80, 0, false, LED_PRIORITY_ACTUATION);
+    LED_Message_queue_send(LED_LOAD_OUT, 0, 80, 0, false, LED_PRIORITY_ACTUATION);
+    // Turn on normal status indicator
+    LED_Message_queue_send(LED_PERSIST_STATUS_2, 100, 20, 0, false);
+}
+
+/*
+ * =======================================================
+ * Wi-Fi Supervisor Task loop
+ * =======================================================
+ * - Start a connection attempt and wait for GOT_IP, a disconnect or the timeout
+ *   (the first attempt after boot uses the cache, if any)
+ * - Connected: show the connected animation and wait until the link drops,
+ *   keeping the relay state in the mDNS TXT record current meanwhile;
+ *   the cache is kept, so the reconnect goes to the same AP and channel
+ * - A failed cached attempt clears the cache, the next attempt scans
+ *   and the cache is written again once that connects
+ * - Failed: back off (doubling up to WIFI_BACKOFF_MAX) and retry,
+ *   opening the soft-AP after WIFI_FAILURES_BEFORE_AP failures; it is
+ *   closed again as soon as the station connects
+ */
+void wifi_supervisor_task(void * parameter) {
+    int failures = 0;
+    uint32_t backoff = WIFI_BACKOFF_MIN;
+
+    for(;;){
+        bool useCache = wifiCache.valid;
+        LOG_INFO("%s", useCache ? "Connecting to cached WiFi AP..." : "Connecting to WiFi...");
+        uint32_t attemptStart = millis();
+        wifi_begin(useCache);
+        EventBits_t bits = xEventGroupWaitBits(xWifiEvents, WIFI_CONNECTED_BIT | WIFI_DISCONNECTED_BIT,
+                                               pdTRUE, pdFALSE,
+                                               (useCache ? WIFI_CACHED_CONNECT_TIMEOUT : WIFI_CONNECT_TIMEOUT) / portTICK_PERIOD_MS);
+
+        if (bits & WIFI_CONNECTED_BIT) {
+            failures = 0;
+            backoff = WIFI_BACKOFF_MIN;
+            wifi_on_connected(useCache, millis() - attemptStart);
+            // wait for the link to drop
+            while (!(xEventGroupWaitBits(xWifiEvents, WIFI_DISCONNECTED_BIT, pdTRUE, pdFALSE,
+                                         WIFI_MDNS_REFRESH / portTICK_PERIOD_MS) & WIFI_DISCONNECTED_BIT)) {
+                wifi_mdns_update();
+            }
+            LOG_ERROR("WiFi connection lost");
+            LED_Message_queue_send(LED_LOADING, 100, 80, 0, true);
+            continue;
+        }
+
+        if (useCache) {
+            // the cached AP did not answer, scan straight away
+            LOG_ERROR("cached WiFi AP failed, scanning");
+            wifi_disconnect();
+            wifi_cache_clear();
+            continue;
+        }
+
+        // connection unsuccessful,
+        failures++;
+        LOG_ERROR("Failed to establish wireless connection (attempt %d), retry in %u ms", failures, backoff);
+        wifi_disconnect();
+        if (failures == WIFI_FAILURES_BEFORE_AP && !wifiSoftAPStarted) {
+            wifi_start_soft_ap();
+            // Display error animation
+            LED_Message_queue_send(LED_FADEIN, 80, 0, 0, false, LED_PRIORITY_ERROR);
+            LED_Message_queue_send(LED_BREATHE, 80, 0, 0, true, LED_PRIORITY_ERROR);
+        }
+        vTaskDelay(backoff / portTICK_PERIOD_MS);
+        backoff = min(backoff * 2, (uint32_t)WIFI_BACKOFF_MAX);
+    }
+}
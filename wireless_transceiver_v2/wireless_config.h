@@ -12,7 +12,8 @@ const char* password = "ENTER YOUR WIFI PASSWORD HERE";
 // WiFi - WAP2 Enterprise Configuration
 // set this to true if you want to connect to eduroam
 // set this to false if you want to connect to other Wi-Fi
-bool UseWAPEnterprise = true;
+// ignored when buildWifiEnterprise (build_profile.h) is off
+const bool UseWAPEnterprise = true;
 //===================================================
 const char* WAP2_SSID = "eduroam";
 const char* EAP_IDENTITY = "ENTER YOUR EDUROAM USERNAME WITH @BC.EDU";
@@ -24,6 +25,46 @@ const char* EAP_PASSWORD = "ENTER YOUR EDUROAM PASSWORD";
 // !!Becareful with reuse this code and cause duplicated Mac Address!!
 uint8_t newMACAddress[] = {0x32, 0xAE, 0xA4, 0x07, 0x0D, 0x66};
 
+// The Wi-Fi settings above (and domainName below) are defaults, settings
+// saved at runtime through /config/wifi take precedence over them
+
+// Admin password for /config/* (user name "admin")
+const char* adminPassword = "ENTER AN ADMIN PASSWORD HERE";
+//===================================================
+
+// Soft-AP fallback - Configuration
+// opened (named after domainName) when the Wi-Fi above cannot be reached
+// must be at least 8 characters
+const char* softAPPassword = "ENTER A SOFT-AP PASSWORD HERE";
+//===================================================
+
+// UDP control - Configuration (tools/udp_client)
+// shared key as 32 hex digits, e.g. from: openssl rand -hex 16
+// UDP control stays off while this is not a valid key
+const char* udpControlKey = "ENTER A 32 HEX DIGIT UDP KEY";
+const uint16_t udpControlPort = 4210;
+//===================================================
+
+// Relay channels - Configuration
+// GPIO of each switch jack, channel 0 first (/control/0/click, /control/1/click, ...)
+// GPIO 0-31 only, all channels are switched through one output register;
+// /control/click, /control/sequence, WebSocket and UDP drive channel 0
+const uint8_t relayPins[] = {27};
+//===================================================
+
+// Idle power - Configuration
+// Battery profile: set to true on battery-powered units to turn on both
+// settings below. Off, the status ring stays lit and every actuation is
+// answered without waiting for the radio to wake up.
+const bool batteryPowered = false;
+// LED ring switches off after this long without a new LED message (ms),
+// 0 keeps the last pattern on (and replaying) forever
+const uint32_t ledIdleTimeout = batteryPowered ? 600000 : 0;
+// Wi-Fi modem sleep between DTIM beacons while connected; saves most of the
+// radio current but requests wait up to one DTIM interval (~100-300 ms)
+const bool wifiPowerSave = batteryPowered;
+//===================================================
+
 // Server Configuration
 // Once domain/Host name is changed, wait sometime for it to propagate (1-2h)
 const char* domainName = "wifiswitch01";
@@ -7,11 +7,14 @@
  *    - LED Pin 32
  *    - num-Pixels 7
  * - Software Switch Relay
- *    - Pin 27
+ *    - Pin 27 (more channels: relayPins in wireless_config.h)
  * =======================================================================
  * =======================================================================
  */
 
+// Firmware version, advertised over mDNS (TXT "fw")
+#define FIRMWARE_VERSION "2.1.0"
+
 // Import WiFi Libraries
 #include <WiFi.h>
 #include <esp_wpa2.h>
@@ -29,18 +32,40 @@
 // Other Libraries
 #include <time.h>
 #include <stdlib.h>
+#include <esp_heap_caps.h>
 
-// Include html files
+// Include html files (generated from wireless_transceiver_webpage_v2)
 #include "index_html.h"
 
 // Import wireless configurations
 #include "wireless_config.h"
+// Import features and LED patterns of this build
+#include "build_profile.h"
+// Import runtime metrics
+#include "metrics.h"
+// Import task placement and stack sizes
+#include "task_topology.h"
+// Import event tracer (build with TRACE_ENABLED)
+#include "trace.h"
+// Import deferred logging
+#include "log.h"
 // Import LED tasks
 #include "led_task.h"
-
-
-// Software Switch Relay Setup
-#define SOFT_RELAY_PIN 27
+// Import relay control
+#include "relay_task.h"
+// Import relay sequencer
+#include "sequence_task.h"
+// Import rate limiting for /control/*
+#include "admission.h"
+// Import control page and /control/* handlers
+#include "control_handlers.h"
+// Firmware update over HTTP with rollback
+#include "ota_update.h"
+// Import UDP control channel
+#include "udp_task.h"
+// Import Wi-Fi settings and connection supervisor
+#include "wifi_settings.h"
+#include "wifi_task.h"
 
 /*
  * =======================================================
@@ -50,6 +75,14 @@
 
 // Create AsyncWebServer object on port 80
 AsyncWebServer server(80);
+// WebSocket control channel on the same server, created on first use so a
+// build without it (buildWebSocket) links none of it
+AsyncWebSocket &websocket() {
+    static AsyncWebSocket ws("/ws");
+    return ws;
+}
+// Routes for /control/{ch}/click, activate and deactivate
+ControlChannelHandler controlChannelHandler;
 
 
 /*
@@ -58,6 +91,15 @@ AsyncWebServer server(80);
  * =======================================================
  */
 
+// Longest WebSocket command accepted, e.g. "4294967295 c 6000 rtt_us=10000000 key=<32 characters>"
+#define WS_COMMAND_MAX_LENGTH 80
+// Interval of the housekeeping timer: WebSocket client cleanup, pending restart (ms)
+#define HOUSEKEEPING_INTERVAL 1000
+esp_timer_handle_t housekeepingTimer = NULL;
+
+// Delay before restarting after new Wi-Fi settings were saved (ms)
+#define CONFIG_RESTART_DELAY 1000
+unsigned long restartAt = 0;    // millis() of a pending restart, 0 if none
 
 
 /*
@@ -65,176 +107,465 @@ AsyncWebServer server(80);
  * Callback Functions
  * =======================================================
  */
-void handleRoot(AsyncWebServerRequest *request) {
-    request->send_P(200, "text/html", INDEX_HTML);
+// Play a press/release timeline in one request
+// url parameter "steps": durations in ms, alternating press and release,
+// starting and ending with a press, e.g. steps=200,100,200 for a double press
+void handleSequence (AsyncWebServerRequest *request) {
+    TRACE_SCOPE("http sequence");
+    uint32_t keyHash;
+    if (control_admit(request, keyHash)) {
+        return;
+    }
+    if (!request->hasParam("steps")) {
+        LOG_ERROR("handleSequence: no url Param - steps");
+        control_reply(request, keyHash, 400, "MISSING STEPS");
+        return;
+    }
+    String value = request->getParam("steps")->value();
+    int steps[SEQUENCE_MAX_STEPS + 1];
+    int count = 0;
+    int start = 0;
+    while (start <= (int)value.length() && count <= SEQUENCE_MAX_STEPS) {
+        int end = value.indexOf(',', start);
+        if (end < 0) end = value.length();
+        String step = value.substring(start, end);
+        step.trim();
+        // toInt() reads garbage as 0, which the range check rejects
+        steps[count++] = step.toInt();
+        start = end + 1;
+    }
+    if (value.length() == 0) count = 0;
+
+    switch (sequence_validate(steps, count)) {
+        case SEQUENCE_EMPTY:
+            control_reply(request, keyHash, 400, "MISSING STEPS");
+            return;
+        case SEQUENCE_TOO_MANY_STEPS:
+            control_reply(request, keyHash, 400, "TOO MANY STEPS");
+            return;
+        case SEQUENCE_EVEN_STEPS:
+            control_reply(request, keyHash, 400, "STEPS MUST START AND END WITH A PRESS");
+            return;
+        case SEQUENCE_STEP_RANGE:
+            control_reply(request, keyHash, 400, "INVALID STEP (1-6000ms)");
+            return;
+        case SEQUENCE_TOO_LONG:
+            control_reply(request, keyHash, 400, "SEQUENCE TOO LONG");
+            return;
+    }
+
+    if (!sequence_start(steps, count)) {
+        control_reply(request, keyHash, 409, "BUSY");
+        return;
+    }
+    // Acknowledge with 200 response, edge jitter is reported once the run ends
+    control_reply(request, keyHash, 200, "OK");
 }
 
-void handleClick (AsyncWebServerRequest *request) {
-    int paramValue; // url parameter named "interval" ranging between 0 to 6000ms
-    if (request->hasParam("interval") ) {
-        paramValue = request->getParam("interval")->value().toInt();
-        Serial.println("Get Parameter: "+paramValue);
-    }else{
-        Serial.println("[ERROR] >>> handleClick: no url Param - interval");
+// Write text as a quoted JSON string, escaping quotes, backslashes and control characters
+void print_json_string(Print &out, const char *text) {
+    out.print('"');
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            out.print('\\');
+            out.print(*c);
+        } else if ((uint8_t)*c < 0x20) {
+            out.printf("\\u%04x", (uint8_t)*c);
+        } else {
+            out.print(*c);
+        }
     }
-    
-    if (paramValue > 6000 && paramValue < 0) {
-        Serial.println("[ERROR] >>> handleClick: invalid parameter range (0-6000ms)");
+    out.print('"');
+}
+
+// Wi-Fi settings (admin only)
+// GET returns the current settings without secrets
+// POST with any of ssid, password, enterprise (0/1), identity, eap_password, hostname
+// saves them to NVS and restarts so they take effect
+void handleWifiConfig(AsyncWebServerRequest *request) {
+    if (!request->authenticate("admin", adminPassword)) {
+        return request->requestAuthentication();
+    }
+    if (request->method() == HTTP_GET) {
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        // ssid, identity and hostname are user input
+        response->printf("{\"enterprise\":%s,\"ssid\":", wifiSettings.enterprise ? "true" : "false");
+        print_json_string(*response, wifiSettings.ssid);
+        response->print(",\"identity\":");
+        print_json_string(*response, wifiSettings.eapIdentity);
+        response->print(",\"hostname\":");
+        print_json_string(*response, wifiSettings.hostname);
+        response->printf(",\"cached_ap\":%s}", wifiCache.valid ? "true" : "false");
+        request->send(response);
         return;
     }
-    
-    // Display animation
-    LED_Message_queue_send(LED_CIRCLE_IN, 0, 40, 40, false);
-    
-    // Engage Switch for defined periods
-    digitalWrite(SOFT_RELAY_PIN, HIGH);
-    delay(paramValue);
-    digitalWrite(SOFT_RELAY_PIN, LOW);
 
-    // Display animation
-    LED_Message_queue_send(LED_LOAD_OUT, 0, 40, 40, false);
+    if (buildWifiEnterprise && request->hasParam("enterprise", true)) {
+        wifiSettings.enterprise = request->getParam("enterprise", true)->value().toInt() != 0;
+    }
+    if (request->hasParam("ssid", true)) {
+        wifi_copy_setting(wifiSettings.ssid, sizeof(wifiSettings.ssid), request->getParam("ssid", true)->value().c_str());
+    }
+    if (request->hasParam("password", true)) {
+        wifi_copy_setting(wifiSettings.password, sizeof(wifiSettings.password), request->getParam("password", true)->value().c_str());
+    }
+    if (request->hasParam("identity", true)) {
+        wifi_copy_setting(wifiSettings.eapIdentity, sizeof(wifiSettings.eapIdentity), request->getParam("identity", true)->value().c_str());
+    }
+    if (request->hasParam("eap_password", true)) {
+        wifi_copy_setting(wifiSettings.eapPassword, sizeof(wifiSettings.eapPassword), request->getParam("eap_password", true)->value().c_str());
+    }
+    if (request->hasParam("hostname", true)) {
+        wifi_copy_setting(wifiSettings.hostname, sizeof(wifiSettings.hostname), request->getParam("hostname", true)->value().c_str());
+    }
+    if (wifiSettings.ssid[0] == '\0' || wifiSettings.hostname[0] == '\0') {
+        request->send_P(400, "text/plain", "SSID AND HOSTNAME REQUIRED");
+        // back to what is stored
+        wifi_settings_load();
+        return;
+    }
+    wifi_settings_save();
+    // the cached AP belongs to the old settings
+    wifi_cache_clear();
+    request->send_P(200, "text/plain", "SAVED, RESTARTING");
+    restartAt = millis() + CONFIG_RESTART_DELAY;
+}
 
-    // Acknowledge with 200 response
-    request->send_P(200, "text/plain", "OK");
+// LED pattern programs (admin only), format in led_patterns.h
+// url parameter "code": pattern code, a built-in code replaces that pattern
+// GET returns the program in use, POST stores the request body
+// (Content-Type: application/octet-stream), DELETE drops an upload
+void handleLedPattern(AsyncWebServerRequest *request) {
+    if (!request->authenticate("admin", adminPassword)) {
+        return request->requestAuthentication();
+    }
+    int code = request->hasParam("code") ? request->getParam("code")->value().toInt() : 0;
+    if (code < 1 || code > 0xffff) {
+        request->send_P(400, "text/plain", "INVALID CODE");
+        return;
+    }
 
-    // return to normal status indicator
-    LED_Message_queue_send(LED_PERSIST_STATUS_2, 100, 20, 0, false);
-}
+    if (request->method() == HTTP_GET) {
+        uint8_t program[LED_PROGRAM_MAX_BYTES];
+        size_t length = led_program_load(code, program);
+        if (length == 0) {
+            request->send_P(404, "text/plain", "UNKNOWN PATTERN");
+            return;
+        }
+        AsyncResponseStream *response = request->beginResponseStream("application/octet-stream");
+        response->write(program, length);
+        request->send(response);
+        return;
+    }
+    if (request->method() == HTTP_DELETE) {
+        if (!led_patterns_remove(code)) {
+            request->send_P(404, "text/plain", "NO UPLOADED PATTERN");
+            return;
+        }
+        request->send_P(200, "text/plain", "OK");
+        return;
+    }
 
-void handleActivation (AsyncWebServerRequest *request) {
-    // Display animation
-    LED_Message_queue_send(LED_CIRCLE_IN, 0, 40, 40, false);
-    // Engage Switch
-    digitalWrite(SOFT_RELAY_PIN, HIGH);
-    // Acknowledge with 200 response
+    // POST, body collected by handleLedPatternBody
+    size_t length = request->contentLength();
+    if (length > LED_PROGRAM_MAX_BYTES) {
+        request->send_P(413, "text/plain", "PATTERN TOO LARGE");
+        return;
+    }
+    if (request->_tempObject == NULL || !led_program_validate((uint8_t *)request->_tempObject, length)) {
+        request->send_P(400, "text/plain", "INVALID PATTERN");
+        return;
+    }
+    if (!led_patterns_store(code, (uint8_t *)request->_tempObject, length)) {
+        request->send_P(507, "text/plain", "NO FREE PATTERN SLOT");
+        return;
+    }
     request->send_P(200, "text/plain", "OK");
 }
 
-void handleDeactivation (AsyncWebServerRequest *request) {
-    // Display animation
-    LED_Message_queue_send(LED_LOAD_OUT, 0, 40, 40, false);
-    // Disengage Switch
-    digitalWrite(SOFT_RELAY_PIN, LOW);
-    // Acknowledge with 200 response
-    request->send_P(200, "text/plain", "OK");
-    // return to normal status indicator
-    LED_Message_queue_send(LED_PERSIST_STATUS_2, 100, 20, 0, false);
+// Collects a /led/pattern upload, freed with the request
+void handleLedPatternBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    if (total > LED_PROGRAM_MAX_BYTES) {
+        return;
+    }
+    if (index == 0) {
+        request->_tempObject = malloc(total);
+    }
+    if (request->_tempObject != NULL) {
+        memcpy((uint8_t *)request->_tempObject + index, data, len);
+    }
 }
 
-/*
- * =======================================================
- * Functions
- * =======================================================
- */
-
+// Prometheus text exposition of the runtime metrics
+void handleMetrics(AsyncWebServerRequest *request) {
+    TRACE_SCOPE("http metrics");
+    AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4");
+    metrics_print_histogram(*response, "switch_relay_edge_latency_seconds",
+        "Time from a relay request to the relay edge", metricsRelayEdgeLatency);
+    metrics_print_histogram(*response, "switch_led_queue_wait_seconds",
+        "Time an LED message waited before its pattern started", metricsLedQueueWait);
+    if (buildSequence) {
+        metrics_print_histogram(*response, "switch_sequence_edge_jitter_seconds",
+            "Deviation of sequence edges from their scheduled time", metricsSequenceJitter);
+        metrics_print_value(*response, "switch_sequence_last_max_jitter_microseconds", "gauge",
+            "Largest edge deviation of the last completed sequence", sequenceLastMaxJitter);
+        metrics_print_value(*response, "switch_sequence_last_mean_jitter_microseconds", "gauge",
+            "Mean edge deviation of the last completed sequence", sequenceLastMeanJitter);
+    }
+    if (buildWebSocket) {
+        metrics_print_histogram(*response, "switch_control_ws_round_trip_seconds",
+            "WebSocket command to its ok acknowledgement, measured by the control page", metricsControlRoundTripWs);
+    }
+    metrics_print_histogram(*response, "switch_control_http_round_trip_seconds",
+        "HTTP control request to its 200 answer, measured by the control page", metricsControlRoundTripHttp);
+    metrics_print_value(*response, "switch_relay_channels", "gauge",
+        "Relay channels configured", RELAY_CHANNELS);
+    metrics_print_value(*response, "switch_led_frames_rendered_total", "counter",
+        "LED frames drawn", metricsLedFramesRendered);
+    metrics_print_value(*response, "switch_led_frames_late_total", "counter",
+        "LED frames drawn at least one tick late", metricsLedFramesLate);
+    metrics_print_value(*response, "switch_led_frames_sent_total", "counter",
+        "LED frames sent to the ring", metricsLedFramesSent);
+    metrics_print_value(*response, "switch_led_frames_skipped_total", "counter",
+        "LED frames replaced by a newer frame before the next refresh", metricsLedFramesSkipped);
+    metrics_print_value(*response, "switch_led_messages_dropped_total", "counter",
+        "LED messages dropped because the queue was full", metricsLedMessagesDropped);
+    metrics_print_value(*response, "switch_led_messages_coalesced_total", "counter",
+        "Waiting LED status messages replaced by a newer message", metricsLedMessagesCoalesced);
+    metrics_print_value(*response, "switch_led_queue_high_water", "gauge",
+        "Most LED messages waiting at once", metricsLedQueueHighWater);
+    metrics_print_value(*response, "switch_led_queue_depth", "gauge",
+        "LED messages waiting now", led_queue_depth());
+    if (buildUdpControl) {
+        metrics_print_value(*response, "switch_udp_packets_total", "counter",
+            "UDP control datagrams received", udpServer.received);
+        metrics_print_value(*response, "switch_udp_dropped_total", "counter",
+            "UDP control datagrams dropped (malformed or wrong MAC)", udpServer.dropped);
+        metrics_print_value(*response, "switch_udp_resent_total", "counter",
+            "Repeated UDP commands answered without running them again", udpServer.resent);
+        metrics_print_value(*response, "switch_udp_stale_total", "counter",
+            "UDP commands refused for an old sequence number", udpServer.stale);
+    }
+    metrics_print_value(*response, "switch_control_rejected_client_total", "counter",
+        "Control requests refused with 429 by the per-client limit", metricsAdmissionRejectedClient);
+    metrics_print_value(*response, "switch_control_rejected_global_total", "counter",
+        "Control requests refused with 429 by the global limit", metricsAdmissionRejectedGlobal);
+    metrics_print_value(*response, "switch_control_conflicts_total", "counter",
+        "Control requests refused with 409 by the relay state", metricsAdmissionConflicts);
+    metrics_print_value(*response, "switch_control_replays_total", "counter",
+        "Control requests answered from a stored idempotency key", metricsAdmissionReplays);
+    metrics_print_value(*response, "switch_led_task_wakeups_total", "counter",
+        "LED task loop passes", metricsLedTaskWakeups);
+    metrics_print_value(*response, "switch_led_refresh_wakeups_total", "counter",
+        "LED refresh timer ticks", metricsLedRefreshWakeups);
+    metrics_print_value(*response, "switch_housekeeping_wakeups_total", "counter",
+        "Housekeeping timer ticks", metricsHousekeepingWakeups);
+    metrics_print_value(*response, "switch_log_dropped_total", "counter",
+        "Log lines dropped because the log ring was full", metricsLogDropped);
+    metrics_print_value(*response, "switch_wifi_power_save", "gauge",
+        "1 while Wi-Fi modem sleep is enabled", WiFi.getSleep() ? 1 : 0);
+    metrics_print_value(*response, "switch_heap_free_bytes", "gauge",
+        "Free heap", ESP.getFreeHeap());
+    metrics_print_value(*response, "switch_heap_min_free_bytes", "gauge",
+        "Lowest free heap since boot", ESP.getMinFreeHeap());
+    metrics_print_value(*response, "switch_heap_largest_free_block_bytes", "gauge",
+        "Largest free block of internal heap", heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    if (buildOta) {
+        metrics_print_value(*response, "switch_ota_last_bytes", "gauge",
+            "Size of the last firmware upload", otaStats.bytes);
+        metrics_print_value(*response, "switch_ota_last_duration_milliseconds", "gauge",
+            "Duration of the last firmware upload", otaStats.duration);
+        metrics_print_value(*response, "switch_ota_last_throughput_bytes_per_second", "gauge",
+            "Throughput of the last firmware upload into flash", otaStats.throughput);
+        metrics_print_value(*response, "switch_ota_last_heap_used_bytes", "gauge",
+            "Largest drop of the free heap during the last firmware upload", otaStats.heapUsed);
+        metrics_print_value(*response, "switch_ota_trial", "gauge",
+            "1 while the running image waits for Wi-Fi to be confirmed", otaTrialRunning ? 1 : 0);
+    }
+    metrics_print_value(*response, "switch_boot_ready_milliseconds", "gauge",
+        "Time from boot until the control page was reachable (0 while not yet)", wifiReadyAt);
+    metrics_print_value(*response, "switch_wifi_connect_cached_milliseconds", "gauge",
+        "Duration of the last connect to the cached AP (0 if never used)", wifiConnectCachedTime);
+    metrics_print_value(*response, "switch_wifi_connect_scan_milliseconds", "gauge",
+        "Duration of the last connect with a full scan (0 if never used)", wifiConnectScanTime);
+    metrics_print_value(*response, "switch_uptime_seconds", "counter",
+        "Time since boot", millis() / 1000);
+    request->send(response);
+}
 
-bool connectWifi_WAP2_Personal() {
-    /*
-    //ESP32 As access point
-      WiFi.mode(WIFI_AP); //Access Point mode
-      WiFi.softAP(ssid, password);
-    */
-    WiFi.mode(WIFI_STA);
-    //Serial.print("MAC address >> ");
-    //Serial.println(WiFi.macAddress());
-    WiFi.begin(ssid, password);
-    // Make Sure Wifi is connected
-    float timeout = 0.0;
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(500);
-        Serial.println("Connecting to WiFi...");
-        timeout += 0.5;
-        if (timeout > 30){ // timeout is set to 30 seconds
-            return false;
+// Memory budget (admin only): stack use of every task and internal heap fragmentation
+// peak is the most stack a task used since boot, suggested the size to configure for it
+// in task_topology.h; "low" marks tasks with less than TASK_STACK_LOW bytes to spare
+void handleDebugMemory(AsyncWebServerRequest *request) {
+    if (!request->authenticate("admin", adminPassword)) {
+        return request->requestAuthentication();
+    }
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"tasks\":[");
+    for (int id = 0; id < TASK_COUNT; id++) {
+        const TaskSpec &spec = taskTopology[id];
+        // read once, task_exit() clears it
+        TaskHandle_t handle = __atomic_load_n(&taskHandles[id], __ATOMIC_RELAXED);
+        if (handle == NULL) {
+            response->printf("%s{\"name\":\"%s\",\"started\":false}", id ? "," : "", spec.name);
+            continue;
         }
+        // ESP-IDF reports the high-water mark in bytes
+        uint32_t headroom = uxTaskGetStackHighWaterMark(handle);
+        uint32_t peak = spec.stackBytes - headroom;
+        response->printf("%s{\"name\":\"%s\",\"core\":%d,\"priority\":%u,\"stack\":%u,\"peak\":%u,"
+                         "\"headroom\":%u,\"suggested\":%u,\"low\":%s}",
+            id ? "," : "", spec.name, (int)spec.core, (unsigned)spec.priority, spec.stackBytes, peak,
+            headroom, task_suggested_stack(peak), headroom < TASK_STACK_LOW ? "true" : "false");
+    }
+    response->print("],\"system_tasks\":[");
+    bool first = true;
+    for (size_t i = 0; i < sizeof(taskSystemNames) / sizeof(taskSystemNames[0]); i++) {
+        TaskHandle_t handle = xTaskGetHandle(taskSystemNames[i]);
+        if (handle == NULL) continue;
+        response->printf("%s{\"name\":\"%s\",\"headroom\":%u}", first ? "" : ",",
+            taskSystemNames[i], (unsigned)uxTaskGetStackHighWaterMark(handle));
+        first = false;
     }
-    Serial.println("Connected to the WiFi network");
-    Serial.println("IP address: ");
-    Serial.println(WiFi.localIP());
+    multi_heap_info_t heap;
+    heap_caps_get_info(&heap, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    // share of free memory that is not usable as one block
+    uint32_t fragmentation = heap.total_free_bytes ? 100 - heap.largest_free_block * 100 / heap.total_free_bytes : 0;
+    response->printf("],\"heap\":{\"free\":%u,\"min_free\":%u,\"largest_free_block\":%u,"
+                     "\"free_blocks\":%u,\"fragmentation_percent\":%u}}",
+        heap.total_free_bytes, heap.minimum_free_bytes, heap.largest_free_block,
+        heap.free_blocks, fragmentation);
+    request->send(response);
+}
 
-    delay(500);
+#ifdef TRACE_ENABLED
+// Recorded events as Chrome trace JSON (admin only), see trace.h
+// streamed in chunks, recording pauses until the response is out
+void handleDebugTrace(AsyncWebServerRequest *request) {
+    if (!request->authenticate("admin", adminPassword)) {
+        return request->requestAuthentication();
+    }
+    if (!trace_dump_begin()) {
+        request->send_P(409, "text/plain", "TRACE DUMP RUNNING");
+        return;
+    }
+    // resume recording if the client goes away before the end
+    request->onDisconnect(trace_dump_end);
+    request->send(request->beginChunkedResponse("application/json",
+        [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return trace_dump_fill((char *)buffer, maxLen);
+        }));
+}
+#endif
 
-    return true;
+// Last log lines (admin only), "<ms> <line>" oldest first
+void handleLog(AsyncWebServerRequest *request) {
+    if (!request->authenticate("admin", adminPassword)) {
+        return request->requestAuthentication();
+    }
+    AsyncResponseStream *response = request->beginResponseStream("text/plain");
+    log_print_history(*response);
+    request->send(response);
 }
 
-bool connectWifi_WAP2_Enterprise() {
-    // Set NULL WiFi mode for hostname change
-    WiFi.mode(WIFI_MODE_NULL);
-    // Set host name
-    WiFi.disconnect(true);
-    delay(1000);
-    //WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE, INADDR_NONE);
-    WiFi.setHostname(domainName); // have to do this everytime since new host name won't be remembered
-    // Set ESP32 to sation mode
-    WiFi.mode(WIFI_MODE_STA);
-    // Change mac address if needed
-    //esp_wifi_set_mac(WIFI_IF_STA, &newMACAddress[0]);
-    // Configure enterprise network
-    esp_wifi_sta_wpa2_ent_set_identity((uint8_t *)EAP_IDENTITY, strlen(EAP_IDENTITY));
-    esp_wifi_sta_wpa2_ent_set_username((uint8_t *)EAP_IDENTITY, strlen(EAP_IDENTITY));
-    esp_wifi_sta_wpa2_ent_set_password((uint8_t *)EAP_PASSWORD, strlen(EAP_PASSWORD));
-    esp_wifi_sta_wpa2_ent_enable();
-    // Start connection
-    WiFi.begin(WAP2_SSID);
-    // Make Sure Wifi is connected
-    float timeout = 0.0;
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(500);
-        Serial.println("Connecting to WiFi...");
-        timeout += 0.5;
-        if (timeout > 30){ // timeout is set to 30 seconds
-            return false;
+// WebSocket control channel
+// commands are single text frames "<id> <cmd> [arg] [key=<idempotency key>] [rtt_us=<us>]":
+//   p - press (engage until released), r - release, c <ms> - click, on relay channel 0
+//   rtt_us - round trip of the client's previous command, see control_observe_round_trip()
+// commands go through the same admission as /control/activate, /deactivate and
+// /click (buckets by the client's IP, keys shared with those routes)
+// every command is acknowledged with "<id> ok", "<id> busy", "<id> limited" or "<id> err"
+void handleWebSocketEvent(AsyncWebSocket *socket, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
+    if (type != WS_EVT_DATA) {
+        return;
+    }
+    TRACE_SCOPE("ws command");
+    AwsFrameInfo *info = (AwsFrameInfo *)arg;
+    if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT || len >= WS_COMMAND_MAX_LENGTH) {
+        LOG_ERROR("handleWebSocketEvent: unsupported frame");
+        client->text("0 err");
+        return;
+    }
+
+    char command[WS_COMMAND_MAX_LENGTH];
+    memcpy(command, data, len);
+    command[len] = '\0';
+
+    unsigned long id = 0;
+    char op = 0;
+    int consumed = 0;
+    int fields = sscanf(command, "%lu %c%n", &id, &op, &consumed);
+    // HTTP route of the same command
+    const char *path = NULL;
+    if (fields == 2 && op == 'p') path = "/control/activate";
+    if (fields == 2 && op == 'r') path = "/control/deactivate";
+    if (fields == 2 && op == 'c') path = "/control/click";
+    if (path == NULL) {
+        client->printf("%lu err", id);
+        return;
+    }
+    // optional arg (-1 if missing, -2 if malformed) and key
+    long value = -1;
+    const char *key = "";
+    char *save = NULL;
+    for (char *token = strtok_r(command + consumed, " ", &save); token != NULL; token = strtok_r(NULL, " ", &save)) {
+        if (strncmp(token, "key=", 4) == 0) {
+            key = token + 4;
+        } else if (strncmp(token, "rtt_us=", 7) == 0) {
+            control_observe_round_trip(metricsControlRoundTripWs, strtol(token + 7, NULL, 10));
+        } else if (value == -1) {
+            char *end;
+            value = strtol(token, &end, 10);
+            if (*end != '\0' || value < 0) value = -2;
+        } else {
+            value = -2;
         }
     }
-    Serial.println("Connected to the WiFi network");
-    Serial.println("IP address: ");
-    Serial.println(WiFi.localIP());
-    delay(500);
-    Serial.print("Host Name >> ");
-    Serial.println(WiFi.getHostname());
 
-    return true;
-}
+    uint32_t keyHash = admission_key_hash(client->remoteIP(), path, key);
+    int status;
+    const char *body;
+    if (!control_admit_command(client->remoteIP(), keyHash, status, body)) {
+        status = 200;
+        body = "OK";
+        if (op == 'p') {
+            relay_hold(RELAY_CHANNEL(0));
+        } else if (op == 'r') {
+            relay_release(RELAY_CHANNEL(0));
+        } else if (value == -1) {
+            status = 400;
+            body = "MISSING INTERVAL";
+        } else if (value == -2 || value > RELAY_PULSE_MAX_MS) {
+            status = 400;
+            body = "INVALID INTERVAL";
+        } else if (relay_pulse(RELAY_CHANNEL(0), value) == RELAY_PULSE_BUSY) {
+            status = 409;
+            body = "BUSY";
+        }
+        control_record(keyHash, status, body);
+    }
 
-// Function that pushes a led message to the queue
-// return false if queue full
-// ledmessage.useprevcolor set to false
-bool LED_Message_queue_send(int pattern, int red, int green, int blue, bool replay) {
-    struct LEDMessage msg;
-    msg.pattern = pattern;
-    msg.colors[0] = red;
-    msg.colors[1] = green;
-    msg.colors[2] = blue;
-    msg.useprevcolor = false;
-    msg.allowreplay = replay;
-
-    if (xQueueSend(xLedQueue,( void * ) &msg,( TickType_t ) 0 ) == pdTRUE){
-        // xQueueSend returns pdTRUE upon success
-        return true;
-    }else{
-        // xQueueSend returns errQUEUE_FULL if the queue is full
-        return false;
-    }   
+    const char *result = "err";
+    if (status == 200) result = "ok";
+    if (status == 409) result = "busy";
+    if (status == 429) result = "limited";
+    client->printf("%lu %s", id, result);
 }
 
-// Function that pushes a led message to the queue
-// return false if queue full
-// ledmessage.useprevcolor set to true
-bool LED_Message_queue_send(int pattern, bool replay) {
-    struct LEDMessage msg;
-    msg.pattern = pattern;
-    msg.useprevcolor = true;
-    msg.allowreplay = replay;
-
-    if (xQueueSend(xLedQueue,( void * ) &msg,( TickType_t ) 0 ) == pdTRUE){
-        // xQueueSend returns pdTRUE upon success
-        return true;
-    }else{
-        // xQueueSend returns errQUEUE_FULL if the queue is full
-        return false;
-    }  
+// esp_timer callback, runs in the esp_timer task every HOUSEKEEPING_INTERVAL
+void housekeeping_callback(void * arg) {
+    metrics_increment(metricsHousekeepingWakeups);
+    // drop WebSocket clients that went away
+    if (buildWebSocket) websocket().cleanupClients();
+    // apply saved settings once the response has gone out
+    if (restartAt != 0 && (long)(millis() - restartAt) >= 0) {
+        ESP.restart();
+    }
+    // rollback of an unconfirmed image, restart after an update
+    if (buildOta) ota_housekeeping();
 }
 
+
 /*
  * =======================================================
  * Setup Function
@@ -244,78 +575,95 @@ void setup() {
     // Initialize Serial Communication
     Serial.begin(115200);
     Serial.println("\n"); // This is to format output so it does not start on the same line with the gibberish code
+    // Start the log drain first, everything below logs through it
+    if (!log_init()) {
+        Serial.println("[ERROR] >>> log drain failed to start");
+    }
+    // Count the boot if this image is on trial after an update
+    if (buildOta) ota_init();
 
     // Create LED Message Queue
-    xLedQueue = xQueueCreate(10, sizeof(LEDMessage));
     // Check if Queue was created successfully
-    if (xLedQueue == NULL) {
-        Serial.print("[ERROR] >>> xLedQueue failed to create");
+    if (!led_queue_init()) {
+        LOG_ERROR("LED queue failed to create");
     }
 
-    // Create LED ring task
-    xTaskCreate(
-        LED_ring_task,  // Task Function.
-        "LED_Ring",     // String name of the Task.
-        10000,          // Stack Size in words.
-        NULL,           // Parameter passed as input.
-        1,              // Task Priority.
-        NULL);          // Task Handle.
+    // Uploaded LED patterns, read before the LED task uses them
+    if (buildLedUploads && !led_patterns_init()) {
+        LOG_ERROR("LED pattern lock failed to create");
+    }
+
+    // Create LED ring task (core, priority and stack in task_topology.h)
+    if (!task_create(TASK_LED_RING, LED_ring_task)) {
+        LOG_ERROR("LED task failed to start");
+    }
 
     // Device start up animation
-    LED_Message_queue_send(LED_CIRCLE_IN, 100, 60, 0, false);
+    LED_Message_queue_send(LED_CIRCLE_IN, 100, 60, 0, false, LED_PRIORITY_ACTUATION);
     
     //Serial.println("Main loop will now start sleep");
     //for(;;){}
     
-    // Software Relay Pin Setup
-    pinMode(SOFT_RELAY_PIN, OUTPUT);
-    digitalWrite(SOFT_RELAY_PIN, LOW);
+    // Software Relay Pin and pulse timer Setup
+    if (!relay_init()) {
+        LOG_ERROR("relay pulse timer failed to create");
+    }
+    // Hardware timer for /control/sequence
+    if (buildSequence && !sequence_init()) {
+        LOG_ERROR("relay sequencer failed to start");
+    }
 
-    
-    // Loading animation
-    LED_Message_queue_send(LED_LOADING, 100, 80, 0, true);
-    // Connect to Wifi
-    bool connectionSuccess;
-    if (UseWAPEnterprise) {
-        connectionSuccess = connectWifi_WAP2_Enterprise();
-    }else{
-        connectionSuccess = connectWifi_WAP2_Personal();
-    }
-
-    if (connectionSuccess){
-        // Setup Local DNS - domain name
-        if ( MDNS.begin(domainName) ) {
-            Serial.println("mDNS responder started");
-        } else {
-            Serial.println("Error setting up mDNS responder!");
-        }
-    
-        MDNS.addService("http", "tcp", 80);
-    
-        // Setup Web server callbacks:
-        server.on("/", HTTP_GET, handleRoot);
-        server.on("/control/click", handleClick);
-        server.on("/control/activate", handleActivation);
-        server.on("/control/deactivate", handleDeactivation);
-    
-        // Begin Server
-        server.begin();
-        Serial.println("HTTP server started \nOn Domain:\n" + String(domainName) + ".local");
-    
-        // setup complete animation
-        LED_Message_queue_send(LED_LOAD_IN, 0, 80, 0, false);
-        LED_Message_queue_send(LED_LOAD_OUT, 0, 80, 0, false);
-        // Turn on normal status indicator
-        LED_Message_queue_send(LED_PERSIST_STATUS_2, 100, 20, 0, false);
-    }else{
-        // connection unsuccessful, 
-        Serial.println("[ERROR] >> Failed to establish wireless connection");
-        // Display error animation
-        LED_Message_queue_send(LED_FADEIN, 80, 0, 0, false);
-        LED_Message_queue_send(LED_BREATHE, 80, 0, 0, true);
+
+    // Wi-Fi station setup, the connection itself is made by the supervisor task
+    wifi_init();
+
+    // Binary UDP control channel, answers on any interface once it is up
+    if (buildUdpControl && !udp_control_init()) {
+        LOG_ERROR("UDP control disabled, set udpControlKey");
     }
 
+    // Setup Web server callbacks (optional ones per build_profile.h):
+    if (buildControlPage) server.on("/", HTTP_GET, handleRoot);
+    server.on("/control/click", handleClick);
+    if (buildSequence) server.on("/control/sequence", handleSequence);
+    server.on("/control/activate", handleActivation);
+    server.on("/control/deactivate", handleDeactivation);
+    server.addHandler(&controlChannelHandler);
+    if (buildLedUploads) server.on("/led/pattern", HTTP_GET | HTTP_POST | HTTP_DELETE, handleLedPattern, NULL, handleLedPatternBody);
+    if (buildMetrics) server.on("/metrics", HTTP_GET, handleMetrics);
+    server.on("/config/wifi", HTTP_GET | HTTP_POST, handleWifiConfig);
+    server.on("/log", HTTP_GET, handleLog);
+    server.on("/debug/memory", HTTP_GET, handleDebugMemory);
+    if (buildOta) server.on("/update", HTTP_GET | HTTP_POST, handleUpdate, NULL, handleUpdateBody);
+#ifdef TRACE_ENABLED
+    server.on("/debug/trace", HTTP_GET, handleDebugTrace);
+#endif
+    if (buildWebSocket) {
+        websocket().onEvent(handleWebSocketEvent);
+        server.addHandler(&websocket());
+    }
+
+    // Begin Server, it answers as soon as any interface comes up
+    server.begin();
+    LOG_INFO("HTTP server started \nOn Domain:\n%s.local", wifiSettings.hostname);
+
+    // Periodic upkeep, replaces polling in loop()
+    esp_timer_create_args_t timerArgs;
+    timerArgs.callback = housekeeping_callback;
+    timerArgs.arg = NULL;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "housekeeping";
+    if (esp_timer_create(&timerArgs, &housekeepingTimer) != ESP_OK ||
+        esp_timer_start_periodic(housekeepingTimer, HOUSEKEEPING_INTERVAL * 1000) != ESP_OK) {
+        LOG_ERROR("housekeeping timer failed to start");
+    }
 
+    // Loading animation
+    LED_Message_queue_send(LED_LOADING, 100, 80, 0, true);
+    // Connect to Wifi in the background
+    if (!task_create(TASK_WIFI_SUPERVISOR, wifi_supervisor_task)) {
+        LOG_ERROR("Wi-Fi supervisor failed to start");
+    }
 }
 
 
@@ -323,8 +671,9 @@ void setup() {
  * =======================================================
  * Loop Function
  * =======================================================
+ * Everything runs in its own task or timer, the Arduino loop task is
+ * deleted on its first pass so it never wakes the CPU again.
  */
 void loop() {
-    // nothing for server in the loop
-    vTaskDelay(1 / portTICK_PERIOD_MS); // Delay 1 millisecond
+    vTaskDelete(NULL);
 }
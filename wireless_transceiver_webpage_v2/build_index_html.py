@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+# ==================================================================
+# Build step that turns index.html into the firmware's index_html.h
+# ==================================================================
+# - Minifies the page (indentation, blank lines and full-line comments)
+# - Gzips it so the server can send it with Content-Encoding: gzip
+# - Writes it as a PROGMEM byte array with a content hash used as ETag
+#
+# Run after every change to index.html:
+#   python3 build_index_html.py
+# The output is reproducible (fixed gzip mtime), so an unchanged page
+# keeps its ETag and browsers keep getting 304 responses.
+
+import gzip
+import hashlib
+import os
+import re
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SOURCE = os.path.join(HERE, "index.html")
+OUTPUT = os.path.join(HERE, "..", "wireless_transceiver_v2", "index_html.h")
+
+
+def minify(html):
+    # HTML comments
+    html = re.sub(r"<!--.*?-->", "", html, flags=re.S)
+    lines = []
+    for line in html.splitlines():
+        line = line.strip()
+        # blank lines and full-line script comments
+        # (newlines are kept, so trailing // comments stay harmless)
+        if not line or line.startswith("//"):
+            continue
+        lines.append(line)
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    with open(SOURCE, encoding="utf-8") as f:
+        html = f.read()
+    page = minify(html).encode("utf-8")
+    packed = gzip.compress(page, compresslevel=9, mtime=0)
+    etag = hashlib.sha256(packed).hexdigest()[:16]
+
+    out = []
+    out.append("// Generated by wireless_transceiver_webpage_v2/build_index_html.py, do not edit.")
+    out.append("// Source: wireless_transceiver_webpage_v2/index.html")
+    out.append("// %d bytes of html, %d bytes gzipped" % (len(html.encode("utf-8")), len(packed)))
+    out.append("// PROGMEM: Store data in flash (program) memory instead of SRAM")
+    out.append("")
+    out.append('#define INDEX_HTML_ETAG "\\"%s\\""' % etag)
+    out.append("")
+    out.append("const size_t INDEX_HTML_GZ_LEN = %d;" % len(packed))
+    out.append("const uint8_t INDEX_HTML_GZ[] PROGMEM = {")
+    for i in range(0, len(packed), 16):
+        out.append("    " + " ".join("0x%02x," % b for b in packed[i:i + 16]))
+    out.append("};")
+    out.append("")
+
+    with open(OUTPUT, "w", encoding="utf-8", newline="\n") as f:
+        f.write("\n".join(out))
+    print("%s: %d -> %d bytes, ETag %s" % (os.path.relpath(OUTPUT, HERE), len(html), len(packed), etag))
+
+
+if __name__ == "__main__":
+    main()